@@ -0,0 +1,147 @@
+#include "Arena.h"
+
+#include <cstdlib>
+#include <new>
+
+namespace
+{
+
+const size_t firstChunkSize = 64 * 1024;
+
+qint64 heapAllocationCount = 0;// Constant-initialized, malloc is called before any constructor runs
+
+}
+
+#if defined(COUNT_HEAP_ALLOCATIONS) && defined(__GLIBC__)
+
+// The program's malloc replaces the library's one for every caller, Qt and libstdc++ included, and passes the call on.
+// Only in the "qmake CONFIG+=count_heap" build: the atomic add on every allocation makes the threads contend
+extern "C"
+{
+
+void *__libc_malloc(size_t size);
+void *__libc_calloc(size_t count, size_t size);
+void *__libc_realloc(void *p, size_t size);
+
+void *malloc(size_t size) __THROW
+{
+    __sync_fetch_and_add(&heapAllocationCount, 1);
+    return __libc_malloc(size);
+}
+
+void *calloc(size_t count, size_t size) __THROW
+{
+    __sync_fetch_and_add(&heapAllocationCount, 1);
+    return __libc_calloc(count, size);
+}
+
+void *realloc(void *p, size_t size) __THROW
+{
+    __sync_fetch_and_add(&heapAllocationCount, 1);
+    return __libc_realloc(p, size);
+}
+
+}
+
+qint64 heapAllocations()
+{
+    return __sync_fetch_and_add(&heapAllocationCount, 0);
+}
+
+#else
+
+qint64 heapAllocations()
+{
+    return -1;
+}
+
+#endif
+
+Arena::Arena():
+    current(-1), used(0), enabled(true),
+    allocationCount(0), systemAllocationCount(0)
+{
+}
+
+Arena::~Arena()
+{
+    for (size_t i = 0; i < chunks.size(); i++)
+        std::free(chunks[i].data);
+}
+
+Arena &Arena::forThisThread()
+{
+    static thread_local Arena arena;
+    return arena;
+}
+
+void *Arena::allocate(size_t size, size_t align)
+{
+    allocationCount++;
+    if (!enabled)
+    {
+        systemAllocationCount++;
+        void *p = std::malloc(size);
+        if (!p)
+            throw std::bad_alloc();
+        return p;
+    }
+
+    if (current >= 0)
+    {
+        size_t start = (used + align - 1) & ~(align - 1);
+        if (start + size <= chunks[current].size)
+        {
+            used = start + size;
+            return chunks[current].data + start;
+        }
+    }
+
+    // The current chunk is full: the next one is reused if it's big enough, otherwise the rest are replaced
+    // by a single chunk twice as big, so the arena settles on one allocation per peak.
+    if (current + 1 >= int(chunks.size()) || chunks[current + 1].size < size)
+    {
+        size_t newSize = chunks.empty() ? firstChunkSize : chunks.back().size * 2;
+        while (newSize < size)
+            newSize *= 2;
+        for (size_t i = current + 1; i < chunks.size(); i++)
+            std::free(chunks[i].data);
+        chunks.resize(current + 1);
+
+        Chunk c;
+        c.data = static_cast<char *>(std::malloc(newSize));// malloc aligns for any standard type
+        if (!c.data)
+            throw std::bad_alloc();
+        c.size = newSize;
+        chunks.push_back(c);
+        systemAllocationCount++;
+    }
+    current++;
+    used = size;
+    return chunks[current].data;
+}
+
+void Arena::deallocate(void *p)
+{
+    if (!enabled)
+        std::free(p);
+}
+
+Arena::Mark Arena::mark() const
+{
+    Mark m;
+    m.chunk = current;
+    m.used = used;
+    return m;
+}
+
+void Arena::rewind(const Mark &m)
+{
+    current = m.chunk;
+    used = m.used;
+}
+
+void Arena::setEnabled(bool e)
+{
+    enabled = e;
+}
@@ -0,0 +1,99 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <QtGlobal>
+
+#include <cstddef>
+#include <vector>
+
+// A bump allocator for the temporaries of one tick or one planning job. Allocating is moving a pointer,
+// freeing is a no-op, and everything is released at once by rewinding to a mark. The memory is kept for the next
+// tick, so after the first few ticks the temporaries cost no malloc/free at all.
+// Every thread has its own arena, the engines running in parallel never share one.
+class Arena
+{
+public:
+    Arena();
+    ~Arena();
+
+    static Arena &forThisThread();
+
+    void *allocate(size_t size, size_t align);
+    void deallocate(void *p);// Does nothing, unless the arena is disabled
+
+    struct Mark
+    {
+        int chunk;
+        size_t used;
+    };
+    Mark mark() const;
+    void rewind(const Mark &m);// Everything allocated after the mark is released
+
+    // When disabled, every allocation goes to malloc, so the same code can be measured with and without the arena.
+    // Only switch it while nothing allocated from the arena is alive.
+    void setEnabled(bool);
+
+    qint64 allocations() const { return allocationCount; }// Served by the arena, or by malloc if it's disabled
+    qint64 systemAllocations() const { return systemAllocationCount; }// The malloc calls: the chunks, or everything if disabled
+
+private:
+    Arena(const Arena &);
+    Arena &operator=(const Arena &);
+
+    struct Chunk
+    {
+        char *data;
+        size_t size;
+    };
+    std::vector<Chunk> chunks;
+    int current;
+    size_t used;// In the current chunk
+    bool enabled;
+
+    qint64 allocationCount, systemAllocationCount;
+};
+
+// The malloc, calloc and realloc calls of the whole process so far, the Qt containers' ones too. Counted by wrapping
+// the glibc allocator in the "qmake CONFIG+=count_heap" build only, -1 in the normal one and without glibc.
+// For the allocation benchmark(see Benchmark.h).
+qint64 heapAllocations();
+
+// Releases everything allocated from the arena during the scope. Scopes nest like the stack, so a container
+// created outside the scope mustn't grow inside it, its new buffer would be released with the scope.
+class ArenaScope
+{
+public:
+    explicit ArenaScope(Arena &arena_ = Arena::forThisThread()): arena(arena_), start(arena_.mark()) {}
+    ~ArenaScope() { arena.rewind(start); }
+
+private:
+    ArenaScope(const ArenaScope &);
+    ArenaScope &operator=(const ArenaScope &);
+
+    Arena &arena;
+    Arena::Mark start;
+};
+
+// For the standard containers, the Qt ones don't take allocators. By default it uses the arena of the current thread.
+template <class T>
+class ArenaAllocator
+{
+public:
+    typedef T value_type;
+
+    ArenaAllocator(): arena(&Arena::forThisThread()) {}
+    explicit ArenaAllocator(Arena &arena_): arena(&arena_) {}
+    template <class U> ArenaAllocator(const ArenaAllocator<U> &a): arena(a.arena) {}
+
+    T *allocate(size_t n) { return static_cast<T *>(arena->allocate(n * sizeof(T), alignof(T))); }
+    void deallocate(T *p, size_t) { arena->deallocate(p); }
+
+    template <class U> bool operator==(const ArenaAllocator<U> &a) const { return arena == a.arena; }
+    template <class U> bool operator!=(const ArenaAllocator<U> &a) const { return arena != a.arena; }
+
+    Arena *arena;
+};
+
+template <class T> using ArenaVector = std::vector<T, ArenaAllocator<T> >;
+
+#endif //ARENA_H
@@ -0,0 +1,221 @@
+#include <QtGui>
+#include <QtConcurrentMap>
+
+#include <algorithm>
+
+#include "BatchRunner.h"
+#include "ExplorationEngine.h"
+#include "Geometry.h"
+#include "MapCompiler.h"
+#include "World.h"
+#include "tools.h"
+
+namespace
+{
+
+const int fieldWidth = 900, fieldHeight = 600;// The same as the main window uses
+const int maxPoses = 4;
+
+struct BatchJob
+{
+    int mapIndex;
+    const QVector<QVector<QPointF> > *map;
+    quint64 seed;
+    int pose;
+    qreal targetCoverage;
+    int maxTicks;
+    qreal robotRadius;
+    const QByteArray *snapshot;// The run is forked from it if it's not empty, the pose is ignored then
+};
+
+struct BatchResult
+{
+    int mapIndex;
+    int ticks;
+    bool reached;
+    bool complete;// Stopped below the target coverage with nothing reachable left
+};
+
+void startPose(int pose, QPointF *pos, qreal *angle)// The corners of the field, looking inside. Pose 0 is the usual start.
+{
+    switch (pose)
+    {
+    case 0: *pos = QPointF(1, 1); *angle = -PI() / 4; break;
+    case 1: *pos = QPointF(fieldWidth - 1, 1); *angle = -3 * PI() / 4; break;
+    case 2: *pos = QPointF(fieldWidth - 1, fieldHeight - 1); *angle = 3 * PI() / 4; break;
+    default: *pos = QPointF(1, fieldHeight - 1); *angle = PI() / 4; break;
+    }
+}
+
+template <class Policies>
+BatchResult runJob(const BatchJob &job)
+{
+    QPointF pos;
+    qreal angle;
+    startPose(job.pose, &pos, &angle);
+    BasicExplorationEngine<Policies> engine(fieldWidth, fieldHeight, *job.map, job.seed, pos, angle);
+    if (!job.snapshot->isEmpty())
+    {
+        engine.restoreSnapshot(*job.snapshot);// With the checkpoint's walls and robot radius
+        engine.setSeed(job.seed);
+    }
+    else
+    {
+        engine.setRobotRadius(job.robotRadius);// The grown walls are computed once for all the runs on a map
+    }
+    while (engine.coverage() < job.targetCoverage && engine.getTickCount() < job.maxTicks && !engine.isComplete())
+        engine.tick();
+
+    BatchResult result;
+    result.mapIndex = job.mapIndex;
+    result.ticks = engine.getTickCount();
+    result.reached = engine.coverage() >= job.targetCoverage;
+    result.complete = !result.reached && engine.isComplete();
+    return result;
+}
+
+QStringList defaultMaps()
+{
+    QDir dir("map-examples");
+    QStringList names = dir.entryList(QStringList() << "*.map", QDir::Files, QDir::Name);
+    QStringList files;
+    for (int i = 0; i < names.size(); i++)
+        files << dir.filePath(names[i]);
+    return files;
+}
+
+qreal percentile(const QVector<int> &sorted, qreal p)
+{
+    return sorted[qMin(sorted.size() - 1, int(p * sorted.size()))];
+}
+
+}
+
+int runBatch(const QStringList &args)
+{
+    int seeds = 8, poses = 1, maxTicks = 20000;
+    qreal targetCoverage = 0.95, robotRadius = 0.0;
+    QStringList files;
+    QString checkpoint;
+    bool nextBestView = false, lidar = false, occupancy = false;
+    for (int i = 0; i < args.size(); i++)
+    {
+        if (args[i] == "--seeds" && i + 1 < args.size())
+            seeds = qMax(1, args[++i].toInt());
+        else if (args[i] == "--poses" && i + 1 < args.size())
+            poses = qBound(1, args[++i].toInt(), maxPoses);
+        else if (args[i] == "--coverage" && i + 1 < args.size())
+            targetCoverage = qBound(0.0, args[++i].toDouble() / 100, 1.0);
+        else if (args[i] == "--max-ticks" && i + 1 < args.size())
+            maxTicks = qMax(1, args[++i].toInt());
+        else if (args[i] == "--radius" && i + 1 < args.size())
+            robotRadius = qMax(0.0, args[++i].toDouble());
+        else if (args[i] == "--checkpoint" && i + 1 < args.size())
+            checkpoint = args[++i];
+        else if (args[i] == "--next-best-view")
+            nextBestView = true;
+        else if (args[i] == "--lidar")
+            lidar = true;
+        else if (args[i] == "--occupancy")
+            occupancy = true;
+        else
+            files << args[i];
+    }
+    if (files.isEmpty())
+        files = defaultMaps();
+
+    QTextStream out(stdout);
+    if (files.isEmpty())
+    {
+        out << "No maps to run the batch on" << endl;
+        return 1;
+    }
+
+    QVector<QVector<QVector<QPointF> > > maps;
+    for (int f = 0; f < files.size(); f++)
+    {
+        maps.append(MapCompiler().compile(getMapFromFile(files[f])));// As the UI runs them, so the checkpoints match
+        World world(fieldWidth, fieldHeight, maps.back());// Fills the PrecomputeCache once, the runs only read it
+        world.setRobotRadius(robotRadius);
+    }
+
+    QByteArray snapshot;
+    if (!checkpoint.isEmpty())
+    {
+        QFile file(checkpoint);
+        if (file.open(QIODevice::ReadOnly))
+            snapshot = file.readAll();
+        for (int f = 0; f < maps.size(); f++)
+        {
+            ExplorationEngine engine(fieldWidth, fieldHeight, maps[f]);
+            if (!engine.restoreSnapshot(snapshot))
+            {
+                out << checkpoint << " isn't a checkpoint of " << files[f] << endl;
+                return 1;
+            }
+        }
+        poses = 1;
+    }
+
+    QList<BatchJob> jobs;// maps isn't changed any more, so the pointers stay valid
+    for (int f = 0; f < maps.size(); f++)
+    {
+        for (int s = 0; s < seeds; s++)
+        {
+            for (int p = 0; p < poses; p++)
+            {
+                BatchJob job = {f, &maps[f], quint64(s + 1), p, targetCoverage, maxTicks, robotRadius, &snapshot};
+                jobs.append(job);
+            }
+        }
+    }
+
+    out << QString("%1 runs on %2 threads, target coverage %3%, at most %4 ticks, %5 targets")
+           .arg(jobs.size()).arg(QThread::idealThreadCount())
+           .arg(targetCoverage * 100).arg(maxTicks)
+           .arg(occupancy ? "occupancy, potential" : lidar ? "lidar, potential" : nextBestView ? "next best view" : "potential") << endl;
+    BatchResult (*run)(const BatchJob &) = nextBestView ? &runJob<NextBestViewPolicies> : &runJob<DefaultPolicies>;
+    if (lidar)
+        run = &runJob<LidarPolicies>;
+    if (occupancy)
+        run = &runJob<OccupancyPolicies>;
+    QElapsedTimer timer;
+    timer.start();
+    QList<BatchResult> results = QtConcurrent::blockingMapped<QList<BatchResult> >(jobs, run);
+    qreal seconds = timer.elapsed() / 1000.0;
+
+    for (int f = 0; f < files.size(); f++)
+    {
+        QVector<int> ticks;
+        int runs = 0, complete = 0;
+        for (int i = 0; i < results.size(); i++)
+        {
+            if (results[i].mapIndex != f)
+                continue;
+            runs++;
+            if (results[i].complete)
+                complete++;
+            if (results[i].reached)
+                ticks.append(results[i].ticks);
+        }
+        out << files[f] << endl;
+        if (complete > 0)
+            out << QString("    %1/%2 runs explored everything reachable below the coverage").arg(complete).arg(runs) << endl;
+        if (ticks.isEmpty())
+        {
+            out << QString("    0/%1 runs reached the coverage").arg(runs) << endl;
+            continue;
+        }
+        std::sort(ticks.begin(), ticks.end());
+        qreal mean = 0.0;
+        for (int i = 0; i < ticks.size(); i++)
+            mean += ticks[i];
+        mean /= ticks.size();
+        out << QString("    %1/%2 runs reached the coverage, ticks: mean %3, min %4, median %5, p90 %6, max %7")
+               .arg(ticks.size()).arg(runs)
+               .arg(mean, 0, 'f', 1)
+               .arg(ticks.front()).arg(percentile(ticks, 0.5)).arg(percentile(ticks, 0.9)).arg(ticks.back()) << endl;
+    }
+    out << QString("Done in %1 s").arg(seconds, 0, 'f', 1) << endl;
+    return 0;
+}
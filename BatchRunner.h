@@ -0,0 +1,15 @@
+#ifndef BATCHRUNNER_H
+#define BATCHRUNNER_H
+
+#include <QtGui>
+
+// Runs headless explorations for every map x seed x start pose on all the cores and prints, per map, how many ticks
+// it took to reach the target coverage. Every run has its own engine and random generator, so the numbers don't depend
+// on the number of threads or the order the runs are scheduled in.
+// Started by "./mapexploration --batch [--seeds N] [--poses N] [--coverage P] [--max-ticks N] [--radius R] [--checkpoint file] [--next-best-view] [--lidar] [--occupancy] [map files]",
+// the maps from map-examples/ are used by default. With a checkpoint all the runs continue it, each with its own seed,
+// its walls and robot radius(--radius is ignored).
+// --next-best-view runs NextBestViewPolicies instead of the default ones, --lidar runs LidarPolicies and --occupancy OccupancyPolicies, --occupancy wins over --lidar and both over --next-best-view. A run stops early when nothing reachable is left to explore.
+int runBatch(const QStringList &args);
+
+#endif //BATCHRUNNER_H
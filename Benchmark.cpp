@@ -0,0 +1,337 @@
+#include <QtGui>
+
+#include "Benchmark.h"
+#include "World.h"
+#include "VisibilityGraphPlanner.h"
+#include "ThetaStarPlanner.h"
+#include "HierarchicalPlanner.h"
+#include "VoronoiPlanner.h"
+#include "tools.h"
+#include "Geometry.h"
+#include "Random.h"
+#include "Arena.h"
+#include "ExplorationEngine.h"
+#include "RangeSensor.h"
+
+namespace
+{
+
+const int fieldWidth = 900, fieldHeight = 600;// The same as the main window uses
+const int queriesPerMap = 50;
+const int allocationTicks = 300;
+const int engineTicks = 2000;
+
+qreal pathLength(const QVector<QPointF> &path)
+{
+    qreal len = 0.0;
+    for (int i = 0; i < path.size() - 1; i++)
+        len += distance(path[i], path[i + 1]);
+    return len;
+}
+
+// The field of view test as it was before Sector, kept as the baseline for the geometry benchmark
+bool fitsWithAngles(const QPointF &p, const QPointF &centre, qreal radius, qreal dirAngle, qreal spanAngle)
+{
+    dirAngle = fmod(dirAngle, PI() * 2);
+    qreal st = fmod(dirAngle - spanAngle / 2, PI() * 2);
+    if (st < 0)
+        st += 2 * PI();
+    qreal fn = fmod(dirAngle + spanAngle / 2, PI() * 2);
+    if (fn < 0)
+        fn += 2 * PI();
+    if (st > fn)
+        fn += 2 * PI();
+    qreal angle = degr2rad(QLineF(centre, p).angle());
+    if (angle < st)
+        angle += 2 * PI();
+    return (distance(p, centre) < radius && st <= angle && angle <= fn);
+}
+
+const int geometryIterations = 1000000;
+const int scanBeams = 16384;// A full circle per scan, geometryIterations beams in all
+
+void printTiming(QTextStream &out, const QString &name, qint64 nsecs, int hits)
+{
+    out << QString("    %1: %2 ns per call (%3 hits)")
+           .arg(name, -28)
+           .arg(qreal(nsecs) / geometryIterations, 0, 'f', 1)
+           .arg(hits) << endl;
+}
+
+QStringList defaultMaps()
+{
+    QDir dir("map-examples");
+    QStringList names = dir.entryList(QStringList() << "*.map", QDir::Files, QDir::Name);
+    QStringList files;
+    for (int i = 0; i < names.size(); i++)
+        files << dir.filePath(names[i]);
+    return files;
+}
+
+}
+
+int runPlannerBenchmark(const QStringList &mapFiles)
+{
+    QStringList files = mapFiles.isEmpty() ? defaultMaps() : mapFiles;
+    QTextStream out(stdout);
+    if (files.isEmpty())
+    {
+        out << "No maps to run the benchmark on" << endl;
+        return 1;
+    }
+
+    for (int f = 0; f < files.size(); f++)
+    {
+        World world(fieldWidth, fieldHeight, getMapFromFile(files[f]));
+        for (int i = 0; i < world.isDiscovered.size(); i++)
+            world.isDiscovered[i].fill(true);
+        world.syncDiscoveryTree();
+        world.updateVirtualWalls();
+
+        QVector<Planner *> planners;
+        planners.append(new VisibilityGraphPlanner(world));
+        planners.append(new VisibilityGraphPlanner(world, false));
+        planners.append(new ThetaStarPlanner(world));
+        planners.append(new HierarchicalPlanner(world));
+        planners.append(new VoronoiPlanner(world));
+
+        Random random(f + 1);// Every planner gets the same queries
+        QVector<QPair<QPointF, QPointF> > queries;
+        for (int i = 0; i < queriesPerMap; i++)
+        {
+            QPointF a(random.bounded(world.isDiscovered.size()), random.bounded(world.isDiscovered[0].size()));
+            QPointF b(random.bounded(world.isDiscovered.size()), random.bounded(world.isDiscovered[0].size()));
+            queries.append(qMakePair(world.cellSize * a, world.cellSize * b));
+        }
+
+        QVector<QVector<qreal> > lengths(planners.size(), QVector<qreal>(queries.size(), 0.0));
+        out << files[f] << endl;
+        for (int p = 0; p < planners.size(); p++)
+        {
+            QElapsedTimer timer;
+            timer.start();
+            for (int i = 0; i < queries.size(); i++)
+                lengths[p][i] = pathLength(planners[p]->getPath(queries[i].first, queries[i].second));
+            qreal ms = timer.nsecsElapsed() / 1e6 / queries.size();
+
+            int found = 0;
+            qreal ratio = 0.0;// Compared to the first planner, on the queries both of them solved
+            int compared = 0;
+            for (int i = 0; i < queries.size(); i++)
+            {
+                if (lengths[p][i] > 0.0)
+                    found++;
+                if (lengths[p][i] > 0.0 && lengths[0][i] > 0.0)
+                {
+                    ratio += lengths[p][i] / lengths[0][i];
+                    compared++;
+                }
+            }
+            out << QString("    %1: %2 ms per query, %3/%4 paths found, length ratio %5; last query: %6")
+                   .arg(planners[p]->name(), -24)
+                   .arg(ms, 0, 'f', 3)
+                   .arg(found).arg(queries.size())
+                   .arg(compared > 0 ? ratio / compared : 0.0, 0, 'f', 3)
+                   .arg(planners[p]->lastQueryStats()) << endl;
+        }
+        qDeleteAll(planners);
+    }
+    return 0;
+}
+
+int runGeometryBenchmark()
+{
+    QTextStream out(stdout);
+    Random random(1);
+    QVector<QPointF> points(1024);
+    for (int i = 0; i < points.size(); i++)
+        points[i] = QPointF(random.bounded(fieldWidth), random.bounded(fieldHeight));
+    QPointF centre(fieldWidth / 2, fieldHeight / 2);
+    const qreal radius = 200.0, dirAngle = degr2rad(-45.0), spanAngle = degr2rad(60.0);
+
+    out << "Field of view test" << endl;
+    QElapsedTimer timer;
+    int hits = 0;
+    timer.start();
+    for (int i = 0; i < geometryIterations; i++)
+        hits += fitsWithAngles(points[i & 1023], centre, radius, dirAngle, spanAngle);
+    printTiming(out, "QLineF::angle + fmod", timer.nsecsElapsed(), hits);
+
+    hits = 0;
+    timer.start();
+    Sector fov(centre, radius, dirAngle, spanAngle);
+    for (int i = 0; i < geometryIterations; i++)
+        hits += fov.contains(points[i & 1023]);
+    printTiming(out, "Sector::contains", timer.nsecsElapsed(), hits);
+
+    out << "Segment intersection" << endl;
+    QPointF trash;
+    hits = 0;
+    timer.start();
+    for (int i = 0; i < geometryIterations; i++)
+    {
+        QLineF l1(points[i & 1023], points[(i + 1) & 1023]), l2(points[(i + 2) & 1023], points[(i + 3) & 1023]);
+        hits += l1.intersect(l2, &trash) == QLineF::BoundedIntersection;
+    }
+    printTiming(out, "QLineF::intersect", timer.nsecsElapsed(), hits);
+
+    hits = 0;
+    timer.start();
+    for (int i = 0; i < geometryIterations; i++)
+    {
+        Segment s1(points[i & 1023], points[(i + 1) & 1023]), s2(points[(i + 2) & 1023], points[(i + 3) & 1023]);
+        hits += s1.intersects(s2);
+    }
+    printTiming(out, "Segment::intersects", timer.nsecsElapsed(), hits);
+
+    for (int squares = 16; squares <= 64; squares *= 4)
+    {
+        QVector<QVector<QPointF> > map;
+        for (int i = 0; i < squares; i++)
+        {
+            QPointF corner(random.bounded(fieldWidth - 40) + 20, random.bounded(fieldHeight - 40) + 20);
+            qreal side = random.bounded(12) + 4;
+            map.append(QVector<QPointF>() << corner << corner + QPointF(side, 0) << corner + QPointF(side, side)
+                                          << corner + QPointF(0, side) << corner);
+        }
+        World world(fieldWidth, fieldHeight, map);
+        QVector<Segment> walls;
+        for (int i = 0; i < world.map.size(); i++)
+        {
+            for (int j = 0; j < world.map[i].size() - 1; j++)
+                walls.append(Segment(world.map[i][j], world.map[i][j + 1]));
+        }
+        QVector<QPointF> ends(points.size());
+        for (int i = 0; i < points.size(); i++)
+            ends[i] = (Vec2(points[i]) + Vec2::fromAngle(random.bounded(360) * PI() / 180) * 100).toPointF();
+
+        out << QString("Wall on a 100 px path, %1 walls").arg(walls.size()) << endl;
+        hits = 0;
+        timer.start();
+        for (int i = 0; i < geometryIterations; i++)
+        {
+            Segment line(points[i & 1023], ends[i & 1023]);
+            for (int k = 0; k < walls.size(); k++)
+            {
+                if (walls[k].intersects(line))
+                {
+                    hits++;
+                    break;
+                }
+            }
+        }
+        printTiming(out, "all the walls", timer.nsecsElapsed(), hits);
+
+        hits = 0;
+        timer.start();
+        for (int i = 0; i < geometryIterations; i++)
+            hits += world.wallOnPath(points[i & 1023], ends[i & 1023]);
+        printTiming(out, "DistanceField::hit", timer.nsecsElapsed(), hits);
+
+        hits = 0;
+        timer.start();
+        for (int i = 0; i < geometryIterations; i++)
+            hits += world.sightSets.hit(points[i & 1023], ends[i & 1023]);
+        printTiming(out, QString("PotentiallyVisibleSets::hit, %1 walls per tile").arg(world.sightSets.averageSetSize(), 0, 'f', 1),
+                    timer.nsecsElapsed(), hits);
+
+        RangeSensor lidar(scanBeams, 2 * PI(), 200.0);
+        RangeScan scan;
+        int scans = geometryIterations / scanBeams;
+        hits = 0;
+        timer.start();
+        for (int i = 0; i < scans; i++)
+        {
+            lidar.scan(world.sightSets, points[i & 1023], 0.0, &scan);
+            for (int b = 0; b < scan.beams(); b++)
+                hits += scan.isHit(b);
+        }
+        qint64 nsecs = timer.nsecsElapsed();
+        out << QString("    %1: %2 ns per beam, %3 ms per scan (%4 hits)")
+               .arg(QString("RangeSensor, %1 beams").arg(scanBeams), -28)
+               .arg(qreal(nsecs) / (scans * scanBeams), 0, 'f', 1)
+               .arg(nsecs / 1e6 / scans, 0, 'f', 3)
+               .arg(hits) << endl;
+    }
+    return 0;
+}
+
+int runAllocationBenchmark(const QStringList &mapFiles)
+{
+    QStringList files = mapFiles.isEmpty() ? defaultMaps() : mapFiles;
+    QTextStream out(stdout);
+    if (files.isEmpty())
+    {
+        out << "No maps to run the benchmark on" << endl;
+        return 1;
+    }
+
+    Arena &arena = Arena::forThisThread();
+    for (int f = 0; f < files.size(); f++)
+    {
+        QVector<QVector<QPointF> > map = getMapFromFile(files[f]);
+        out << files[f] << endl;
+        for (int pass = 0; pass < 2; pass++)
+        {
+            arena.setEnabled(pass == 1);
+            ExplorationEngine engine(fieldWidth, fieldHeight, map);// The same seed, so both passes make the same moves
+            qint64 allocations = arena.allocations(), heap = heapAllocations();
+            QElapsedTimer timer;
+            timer.start();
+            for (int i = 0; i < allocationTicks; i++)
+                engine.tick();
+            qreal ms = timer.nsecsElapsed() / 1e6 / allocationTicks;
+            heap = heapAllocations() - heap;// Everything the ticks took from the heap, the arena's chunks and the Qt containers too
+            out << QString("    %1: %2 arena allocations per tick, %3 heap allocations per tick, %4 ms per tick")
+                   .arg(pass == 0 ? "without the arena" : "with the arena", -18)
+                   .arg(qreal(arena.allocations() - allocations) / allocationTicks, 0, 'f', 1)
+                   .arg(heapAllocations() < 0 ? QString("unknown") : QString::number(qreal(heap) / allocationTicks, 'f', 1))
+                   .arg(ms, 0, 'f', 3) << endl;
+        }
+    }
+    arena.setEnabled(true);
+    return 0;
+}
+
+namespace
+{
+
+template <class Policies>
+void benchEngine(const char *name, const QVector<QVector<QPointF> > &map, QTextStream &out)
+{
+    BasicExplorationEngine<Policies> engine(fieldWidth, fieldHeight, map);
+    QElapsedTimer timer;
+    timer.start();
+    for (int i = 0; i < engineTicks; i++)
+        engine.tick();
+    qreal ms = timer.nsecsElapsed() / 1e6 / engineTicks;
+    out << QString("    %1: %2 ms per tick, coverage %3%")
+           .arg(name, -8)
+           .arg(ms, 0, 'f', 3)
+           .arg(engine.coverage() * 100, 0, 'f', 1) << endl;
+}
+
+}
+
+int runEngineBenchmark(const QStringList &mapFiles)
+{
+    QStringList files = mapFiles.isEmpty() ? defaultMaps() : mapFiles;
+    QTextStream out(stdout);
+    if (files.isEmpty())
+    {
+        out << "No maps to run the benchmark on" << endl;
+        return 1;
+    }
+
+    for (int f = 0; f < files.size(); f++)
+    {
+        QVector<QVector<QPointF> > map = getMapFromFile(files[f]);
+        out << files[f] << endl;
+        benchEngine<DefaultPolicies>("default", map, out);
+        benchEngine<LeanPolicies>("lean", map, out);
+        benchEngine<NextBestViewPolicies>("nbv", map, out);
+        benchEngine<LidarPolicies>("lidar", map, out);
+        benchEngine<OccupancyPolicies>("occupancy", map, out);
+    }
+    return 0;
+}
@@ -0,0 +1,24 @@
+#ifndef BENCHMARK_H
+#define BENCHMARK_H
+
+#include <QtGui>
+
+// Runs the same random queries on every planner for each map and prints the average latency and path length.
+// The maps are fully discovered, so the planners are compared on the static walls only.
+// Started by "./mapexploration --bench-planners [map files]", the maps from map-examples/ are used by default.
+int runPlannerBenchmark(const QStringList &mapFiles);
+
+// Times the geometry predicates of the hot paths against the QLineF based code they replaced,
+// and the wall tests against the distance field on the maps of random squares.
+// Started by "./mapexploration --bench-geometry".
+int runGeometryBenchmark();
+
+// Runs the exploration on every map with and without the per-thread arena and prints the allocations per tick:
+// the ones asked from the arena and all the heap ones(see heapAllocations(), counted in the count_heap build only). Started by "./mapexploration --bench-alloc [map files]".
+int runAllocationBenchmark(const QStringList &mapFiles);
+
+// Runs the exploration with the default engine configuration and with the experimental ones(see EnginePolicies.h)
+// on every map and prints the time per tick and the coverage. Started by "./mapexploration --bench-engines [map files]".
+int runEngineBenchmark(const QStringList &mapFiles);
+
+#endif //BENCHMARK_H
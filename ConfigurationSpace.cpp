@@ -0,0 +1,121 @@
+#include <QtGui>
+
+#include <algorithm>
+
+#include "ConfigurationSpace.h"
+#include "Geometry.h"
+
+namespace
+{
+
+struct CacheEntry
+{
+    QVector<QVector<QPointF> > map;
+    qreal radius;
+    QVector<QVector<QPointF> > obstacles;
+};
+
+QMutex cacheMutex;
+QList<CacheEntry> cache;// The most recently used first
+
+bool isBefore(const QPointF &a, const QPointF &b)
+{
+    return a.x() < b.x() || (a.x() == b.x() && a.y() < b.y());
+}
+
+// Andrew's monotone chain, counter-clockwise in the usual axes(clockwise on the screen), closed
+QVector<QPointF> convexHull(QVector<QPointF> points)
+{
+    std::sort(points.begin(), points.end(), isBefore);
+    QVector<QPointF> hull(2 * points.size());
+    int k = 0;
+    for (int i = 0; i < points.size(); i++)
+    {
+        while (k >= 2 && Vec2(hull[k - 1] - hull[k - 2]).cross(points[i] - hull[k - 2]) <= 0)
+            k--;
+        hull[k++] = points[i];
+    }
+    for (int i = points.size() - 2, lower = k + 1; i >= 0; i--)
+    {
+        while (k >= lower && Vec2(hull[k - 1] - hull[k - 2]).cross(points[i] - hull[k - 2]) <= 0)
+            k--;
+        hull[k++] = points[i];
+    }
+    hull.resize(k);
+    return hull;
+}
+
+}
+
+QVector<QVector<QPointF> > ConfigurationSpace::inflate(const QVector<QVector<QPointF> > &map, qreal radius)
+{
+    {
+        QMutexLocker locker(&cacheMutex);
+        for (int i = 0; i < cache.size(); i++)
+        {
+            if (cache[i].radius == radius && cache[i].map == map)
+            {
+                cache.move(i, 0);
+                return cache[0].obstacles;
+            }
+        }
+    }
+
+    CacheEntry entry;// Computed unlocked, two threads may do the same work once, but never wait for each other
+    entry.map = map;
+    entry.radius = radius;
+    entry.obstacles = compute(map, radius);
+
+    QMutexLocker locker(&cacheMutex);
+    cache.prepend(entry);
+    while (cache.size() > cacheSize)
+        cache.removeLast();
+    return entry.obstacles;
+}
+
+QVector<QVector<QPointF> > ConfigurationSpace::compute(const QVector<QVector<QPointF> > &map, qreal radius)
+{
+    QVector<QPointF> octagon;
+    qreal r = radius / qCos(PI() / 8);// The octagon's sides touch the circle
+    for (int k = 0; k < 8; k++)
+        octagon.append(r * QPointF(qCos(PI() / 8 + k * PI() / 4), qSin(PI() / 8 + k * PI() / 4)));
+
+    QPainterPath hulls;
+    hulls.setFillRule(Qt::WindingFill);// All the hulls go the same way, so the winding fill is their union
+    for (int i = 0; i < map.size(); i++)
+    {
+        for (int j = 0; j < qMax(1, map[i].size() - 1) && !map[i].isEmpty(); j++)// A lone point makes one octagon, a removed wall(see World::removeWall) nothing
+        {
+            QVector<QPointF> corners;
+            for (int k = 0; k < octagon.size(); k++)
+            {
+                corners.append(map[i][j] + octagon[k]);
+                if (j + 1 < map[i].size())
+                    corners.append(map[i][j + 1] + octagon[k]);
+            }
+            hulls.addPolygon(QPolygonF(convexHull(corners)));
+            hulls.closeSubpath();
+        }
+    }
+
+    QList<QPolygonF> outlines = hulls.simplified().toSubpathPolygons();
+    QVector<QVector<QPointF> > obstacles;
+    for (int i = 0; i < outlines.size(); i++)
+    {
+        QVector<QPointF> outline;
+        for (int j = 0; j < outlines[i].size(); j++)
+        {
+            if (outline.isEmpty() || outline.back() != outlines[i][j])
+                outline.append(outlines[i][j]);
+        }
+        if (outline.size() < 3)
+            continue;
+        if (outline.front() != outline.back())
+            outline.append(outline.front());
+        obstacles.append(outline);
+    }
+#ifdef DEBUG
+    qDebug() << "Configuration space for radius" << radius << ":" << obstacles.size() << "outlines" << endl;
+#endif
+    return obstacles;
+}
@@ -0,0 +1,25 @@
+#ifndef CONFIGURATIONSPACE_H
+#define CONFIGURATIONSPACE_H
+
+#include <QtGui>
+
+// The map as the robot's center sees it: each wall grows into the points closer than the robot's radius to it(the Minkowski sum
+// with a disc), so a path for a point that avoids the grown walls keeps the whole robot off the real ones.
+// The disc is replaced by the octagon around it, so the result contains the exact sum and the axis-aligned walls stay axis-aligned.
+// Each segment becomes the convex hull of two octagons, and the overlapping hulls are merged into the outlines of their union.
+// The outlines are closed and don't cross, but a part enclosed by them isn't necessarily blocked(a room surrounded by walls is
+// a hole of the union), the exact inside is where the real walls are closer than the radius(see World::clearance).
+class ConfigurationSpace
+{
+public:
+    // The merged outlines for the map walls(the field edges included), computed once per map and radius and shared after that,
+    // so the map reloads and switching the radius back and forth are free. Safe to call from many threads.
+    static QVector<QVector<QPointF> > inflate(const QVector<QVector<QPointF> > &map, qreal radius);
+
+private:
+    static QVector<QVector<QPointF> > compute(const QVector<QVector<QPointF> > &map, qreal radius);
+
+    static const int cacheSize = 8;// Maps and radii remembered, the oldest one is forgotten first
+};
+
+#endif //CONFIGURATIONSPACE_H
@@ -0,0 +1,114 @@
+#include <QtGui>
+
+#include "DiscoveryTree.h"
+
+DiscoveryTree::DiscoveryTree():
+    cellsx(0), cellsy(0), top(0), grid(NULL), size(1)
+{
+}
+
+void DiscoveryTree::build(const QVector<QVector<bool> > &grid_)
+{
+    grid = &grid_;
+    cellsx = grid_.size();
+    cellsy = grid_[0].size();
+    size = 1;
+    top = 0;
+    while (size < qMax(cellsx, cellsy))
+    {
+        size *= 2;
+        top++;
+    }
+
+    counts.resize(top + 1);
+    for (int level = 1; level <= top; level++)
+    {
+        int dim = size >> level;
+        counts[level].fill(0, dim * dim);
+    }
+    if (top > 0)
+    {
+        for (int i = 0; i < cellsx; i++)
+        {
+            for (int j = 0; j < cellsy; j++)
+                counts[1][(i >> 1) * (size >> 1) + (j >> 1)] += grid_[i][j];
+        }
+    }
+    for (int level = 2; level <= top; level++)
+    {
+        int dim = size >> level;
+        const QVector<int> &below = counts[level - 1];
+        for (int x = 0; x < dim; x++)
+        {
+            for (int y = 0; y < dim; y++)
+            {
+                counts[level][x * dim + y] = below[(2 * x) * 2 * dim + 2 * y] + below[(2 * x) * 2 * dim + 2 * y + 1] +
+                                             below[(2 * x + 1) * 2 * dim + 2 * y] + below[(2 * x + 1) * 2 * dim + 2 * y + 1];
+            }
+        }
+    }
+}
+
+void DiscoveryTree::set(int i, int j, bool discovered)
+{
+    int delta = discovered ? 1 : -1;
+    for (int level = 1; level <= top; level++)
+        counts[level][(i >> level) * (size >> level) + (j >> level)] += delta;
+}
+
+QRect DiscoveryTree::nodeCells(int level, int x, int y) const
+{
+    int x0 = x << level, y0 = y << level;
+    int x1 = qMin((x + 1) << level, cellsx), y1 = qMin((y + 1) << level, cellsy);
+    if (x0 >= x1 || y0 >= y1)
+        return QRect();
+    return QRect(x0, y0, x1 - x0, y1 - y0);
+}
+
+void DiscoveryTree::collectLeaves(int level, int x, int y, const QRect &area, ArenaVector<Leaf> *leaves) const
+{
+    QRect cells = nodeCells(level, x, y);
+    if (cells.isEmpty() || !cells.intersects(area))
+        return;
+    int count = countAt(level, x, y);
+    if (count == 0 || count == cells.width() * cells.height())// Uniform, a single cell always is
+    {
+        Leaf leaf;
+        leaf.cells = cells;
+        leaf.discovered = count != 0;
+        leaves->push_back(leaf);
+        return;
+    }
+    collectLeaves(level - 1, 2 * x, 2 * y, area, leaves);
+    collectLeaves(level - 1, 2 * x, 2 * y + 1, area, leaves);
+    collectLeaves(level - 1, 2 * x + 1, 2 * y, area, leaves);
+    collectLeaves(level - 1, 2 * x + 1, 2 * y + 1, area, leaves);
+}
+
+void DiscoveryTree::getLeaves(const QRect &area, ArenaVector<Leaf> *leaves) const
+{
+    leaves->clear();
+    collectLeaves(top, 0, 0, area, leaves);
+}
+
+int DiscoveryTree::countIn(int level, int x, int y, const QRect &area) const
+{
+    QRect cells = nodeCells(level, x, y);
+    if (cells.isEmpty() || !cells.intersects(area))
+        return 0;
+    int count = countAt(level, x, y);
+    if (count == 0 || area.contains(cells))
+        return count;
+    if (count == cells.width() * cells.height())
+    {
+        QRect common = cells.intersected(area);
+        return common.width() * common.height();
+    }
+    return countIn(level - 1, 2 * x, 2 * y, area) + countIn(level - 1, 2 * x, 2 * y + 1, area) +
+           countIn(level - 1, 2 * x + 1, 2 * y, area) + countIn(level - 1, 2 * x + 1, 2 * y + 1, area);
+}
+
+int DiscoveryTree::discoveredIn(const QRect &area) const
+{
+    return countIn(top, 0, 0, area);
+}
@@ -0,0 +1,43 @@
+#ifndef DISCOVERYTREE_H
+#define DISCOVERYTREE_H
+
+#include <QtGui>
+
+#include "Arena.h"
+
+// A region quadtree over the discovery grid. A node whose cells are all discovered or all unknown is a leaf,
+// so the big uniform zones are single leaves when the grid is walked.
+// It's stored as a pyramid of the discovered counts: level 0 is the grid itself, each next level has the sums of 2x2 nodes
+// of the previous one. Changing a cell is O(log), the leaves are found by descending from the root.
+// The pyramid is complete, the uniform nodes aren't collapsed in memory: it costs a third of an int per cell on top of the grid.
+class DiscoveryTree
+{
+public:
+    DiscoveryTree();
+
+    void build(const QVector<QVector<bool> > &grid);// The grid is read as level 0 afterwards, it must outlive the tree
+    void set(int i, int j, bool discovered);// After the grid's cell has changed to discovered(or back), only for the real changes
+
+    struct Leaf
+    {
+        QRect cells;// Clipped to the grid
+        bool discovered;
+    };
+    void getLeaves(const QRect &area, ArenaVector<Leaf> *leaves) const;// The leaves intersecting the area, in no particular order
+
+    int discoveredIn(const QRect &area) const;// Counts the discovered cells of the area
+
+private:
+    QRect nodeCells(int level, int x, int y) const;// Clipped to the grid, empty for the nodes outside it
+    int countAt(int level, int x, int y) const { return level == 0 ? (*grid)[x][y] : counts[level][x * (size >> level) + y]; }
+    void collectLeaves(int level, int x, int y, const QRect &area, ArenaVector<Leaf> *leaves) const;
+    int countIn(int level, int x, int y, const QRect &area) const;
+
+    int cellsx, cellsy;
+    int top;// The root's level
+    const QVector<QVector<bool> > *grid;
+    QVector<QVector<int> > counts;// By level from 1, the node (x, y) is at x * (size >> level) + y. Level 0 is left empty.
+    int size;// The side of the root in cells, a power of two
+};
+
+#endif //DISCOVERYTREE_H
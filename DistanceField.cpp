@@ -0,0 +1,429 @@
+#include <QtGui>
+
+#include <algorithm>
+#include <limits>
+
+#include "DistanceField.h"
+#include "SquareWalker.h"
+#include "tools.h"
+
+namespace
+{
+
+const qreal farAway = 1e20;// The squared distance for the samples without walls, finite to keep the envelope arithmetic sane
+const int minTracedSegments = 64;// With fewer walls testing all of them is faster than tracing the field
+
+Vec2 closestPoint(const Segment &s, const Vec2 &p)
+{
+    Vec2 d = s.b - s.a;
+    qreal len = d.lengthSquared();
+    if (len == 0)
+        return s.a;
+    qreal t = qBound(qreal(0.0), (p - s.a).dot(d) / len, qreal(1.0));
+    return s.a + d * t;
+}
+
+// The lower envelope of the parabolas (q - v)^2 + f[v] for q in [0, f.size()), in linear time.
+// dist[q] gets the minimum and arg[q] the v it's reached at. v and z are the buffers for the envelope.
+void transform1D(const QVector<qreal> &f, QVector<qreal> *dist, QVector<int> *arg, QVector<int> &v, QVector<qreal> &z)
+{
+    int n = f.size();
+    int k = 0;// The envelope's last parabola
+    v[0] = 0;
+    z[0] = -std::numeric_limits<qreal>::max();
+    z[1] = std::numeric_limits<qreal>::max();
+    for (int q = 1; q < n; q++)
+    {
+        qreal s;
+        forever
+        {
+            s = ((f[q] + q * q) - (f[v[k]] + v[k] * v[k])) / (2 * q - 2 * v[k]);// Where parabola q overtakes v[k]
+            if (s > z[k])
+                break;
+            k--;
+        }
+        k++;
+        v[k] = q;
+        z[k] = s;
+        z[k + 1] = std::numeric_limits<qreal>::max();
+    }
+    k = 0;
+    for (int q = 0; q < n; q++)
+    {
+        while (z[k + 1] < q)
+            k++;
+        (*dist)[q] = (q - v[k]) * (q - v[k]) + f[v[k]];
+        (*arg)[q] = v[k];
+    }
+}
+
+}
+
+DistanceField::DistanceField():
+    width(0), height(0), resolution(1.0), solid(true), samplesx(0), samplesy(0)
+{
+}
+
+void DistanceField::setWalls(const QVector<QVector<QPointF> > &walls, int width_, int height_, qreal resolution_, bool enclosedAreSolid)
+{
+    width = width_;
+    height = height_;
+    resolution = resolution_;
+    solid = enclosedAreSolid;
+    samplesx = qCeil(width / resolution);
+    samplesy = qCeil(height / resolution);
+    segments = segmentsOf(walls);
+}
+
+void DistanceField::build(const QVector<QVector<QPointF> > &walls, int width_, int height_, qreal resolution_, bool enclosedAreSolid)
+{
+    setWalls(walls, width_, height_, resolution_, enclosedAreSolid);
+    int count = samplesx * samplesy;
+    QVector<int> seedSegment = rasterize();
+
+    // The distance transform, columns first. It's separable: the nearest seed of (i, j) is the nearest one among
+    // the nearest seeds of the columns' samples in row j.
+    int longest = qMax(samplesx, samplesy);
+    QVector<int> v(longest);
+    QVector<qreal> z(longest + 1);
+    QVector<qreal> columnDist(count);
+    QVector<int> columnArg(count);
+    QVector<qreal> f(samplesy), dist(samplesy);
+    QVector<int> arg(samplesy);
+    for (int i = 0; i < samplesx; i++)
+    {
+        for (int j = 0; j < samplesy; j++)
+            f[j] = seedSegment[i * samplesy + j] >= 0 ? 0.0 : farAway;
+        transform1D(f, &dist, &arg, v, z);
+        for (int j = 0; j < samplesy; j++)
+        {
+            columnDist[i * samplesy + j] = dist[j];
+            columnArg[i * samplesy + j] = arg[j];
+        }
+    }
+    f.resize(samplesx);
+    dist.resize(samplesx);
+    arg.resize(samplesx);
+    nearest.resize(count);
+    clear.resize(count);
+    qreal halfDiagonal = resolution / std::sqrt(2.0);
+    for (int j = 0; j < samplesy; j++)
+    {
+        for (int i = 0; i < samplesx; i++)
+            f[i] = columnDist[i * samplesy + j];
+        transform1D(f, &dist, &arg, v, z);
+        for (int i = 0; i < samplesx; i++)
+        {
+            int column = arg[i];
+            nearest[i * samplesy + j] = dist[i] < farAway ? seedSegment[column * samplesy + columnArg[column * samplesy + j]] : -1;
+            // Every wall point is within halfDiagonal from the center of a seed, and the points of the square
+            // are within halfDiagonal from its center
+            clear[i * samplesy + j] = dist[i] < farAway ? std::sqrt(dist[i]) * resolution - 2 * halfDiagonal : farAway;
+        }
+    }
+    markInside(walls);
+}
+
+void DistanceField::update(const QVector<QVector<QPointF> > &walls)
+{
+    QVector<Segment> before = segments;
+    segments = segmentsOf(walls);
+    QVector<int> match = matchSegments(before, segments);
+    rasterize();
+
+    // The samples keep their nearest walls if those are still there. The rest is fixed by a brushfire: the samples which lost
+    // their walls and the new walls' samples pass their nearest wall to the neighbours it's closer to than their own one.
+    // It only spreads as far as the new walls are the nearest and the lost samples go, so a small edit costs a small part of the field.
+    int count = samplesx * samplesy;
+    QVector<bool> changed(count, false), queued(count, false);
+    QVector<int> queue;
+    for (int s = 0; s < count; s++)
+    {
+        if (nearest[s] >= 0)
+            nearest[s] = match[nearest[s]];
+        changed[s] = nearest[s] < 0;
+    }
+    for (int s = 0; s < count; s++)
+    {
+        if (!changed[s])
+            continue;
+        int i = s / samplesy, j = s % samplesy;
+        for (int ni = qMax(i - 1, 0); ni <= qMin(i + 1, samplesx - 1); ni++)
+        {
+            for (int nj = qMax(j - 1, 0); nj <= qMin(j + 1, samplesy - 1); nj++)
+            {
+                int n = ni * samplesy + nj;
+                if (nearest[n] >= 0 && !queued[n])
+                {
+                    queued[n] = true;
+                    queue.append(n);
+                }
+            }
+        }
+    }
+    QVector<bool> isNew(segments.size(), true);
+    for (int k = 0; k < match.size(); k++)
+    {
+        if (match[k] >= 0)
+            isNew[match[k]] = false;
+    }
+    for (int k = 0; k < segments.size(); k++)
+    {
+        if (!isNew[k])
+            continue;
+        Vec2 a = segments[k].a / resolution, b = segments[k].b / resolution;
+        SquareWalker w(a.x, a.y, b.x, b.y);
+        do
+        {
+            if (w.x() >= 0 && w.x() < samplesx && w.y() >= 0 && w.y() < samplesy)
+                offer(w.x() * samplesy + w.y(), k, &changed, &queued, &queue);
+        } while (w.next());
+    }
+    for (int head = 0; head < queue.size(); head++)
+    {
+        int s = queue[head];
+        queued[s] = false;
+        int i = s / samplesy, j = s % samplesy;
+        for (int ni = qMax(i - 1, 0); ni <= qMin(i + 1, samplesx - 1); ni++)
+        {
+            for (int nj = qMax(j - 1, 0); nj <= qMin(j + 1, samplesy - 1); nj++)
+                offer(ni * samplesy + nj, nearest[s], &changed, &queued, &queue);
+        }
+    }
+
+    // Measured from the centre, the second halfDiagonal covers a wall the brushfire could miss by a bit, like the seeds do in build(...)
+    qreal halfDiagonal = resolution / std::sqrt(2.0);
+    for (int s = 0; s < count; s++)
+    {
+        if (changed[s])
+            clear[s] = nearest[s] >= 0 ? sampleDistance(s, nearest[s]) - 2 * halfDiagonal : farAway;
+    }
+    markInside(walls);
+}
+
+void DistanceField::store(PrecomputeCache::Writer *out, const QByteArray &name) const
+{
+    out->add(name + ".clear", clear);
+    out->add(name + ".nearest", nearest);
+    out->add(name + ".inside", inside);
+    out->add(name + ".nearbyOffsets", nearbyOffsets);
+    out->add(name + ".nearbySegments", nearbySegments);
+}
+
+bool DistanceField::restore(const PrecomputeCache::Reader &in, const QByteArray &name, const QVector<QVector<QPointF> > &walls, int width_, int height_,
+                            qreal resolution_, bool enclosedAreSolid)
+{
+    setWalls(walls, width_, height_, resolution_, enclosedAreSolid);
+    int count = samplesx * samplesy;
+    if (!in.read(name + ".clear", &clear) || !in.read(name + ".nearest", &nearest) || !in.read(name + ".inside", &inside) ||
+        !in.read(name + ".nearbyOffsets", &nearbyOffsets) || !in.read(name + ".nearbySegments", &nearbySegments))
+    {
+        return false;
+    }
+    if (clear.size() != count || nearest.size() != count || inside.size() != count || nearbyOffsets.size() != count + 1 ||
+        nearbyOffsets[0] != 0 || nearbyOffsets[count] != nearbySegments.size())
+    {
+        return false;
+    }
+    for (int s = 0; s < count; s++)// The numbers are used as indices, a broken file mustn't crash the queries
+    {
+        if (nearest[s] >= segments.size() || nearbyOffsets[s] > nearbyOffsets[s + 1])
+            return false;
+    }
+    for (int n = 0; n < nearbySegments.size(); n++)
+    {
+        if (nearbySegments[n] < 0 || nearbySegments[n] >= segments.size())
+            return false;
+    }
+    return true;
+}
+
+QVector<int> DistanceField::rasterize()
+{
+    // A sample keeps the first segment going through it
+    int count = samplesx * samplesy;
+    QVector<int> seedSegment(count, -1);
+    QVector<QPair<int, int> > nearby;// (sample, segment), every segment once per sample
+    QVector<int> lastNearby(count, -1);
+    for (int k = 0; k < segments.size(); k++)
+    {
+        Vec2 a = segments[k].a / resolution, b = segments[k].b / resolution;
+        SquareWalker w(a.x, a.y, b.x, b.y);
+        do
+        {
+            if (w.x() < 0 || w.x() >= samplesx || w.y() < 0 || w.y() >= samplesy)
+                continue;
+            if (seedSegment[w.x() * samplesy + w.y()] < 0)
+                seedSegment[w.x() * samplesy + w.y()] = k;
+            for (int i = qMax(w.x() - 1, 0); i <= qMin(w.x() + 1, samplesx - 1); i++)
+            {
+                for (int j = qMax(w.y() - 1, 0); j <= qMin(w.y() + 1, samplesy - 1); j++)
+                {
+                    if (lastNearby[i * samplesy + j] != k)
+                    {
+                        lastNearby[i * samplesy + j] = k;
+                        nearby.append(qMakePair(i * samplesy + j, k));
+                    }
+                }
+            }
+        } while (w.next());
+    }
+
+    nearbyOffsets.fill(0, count + 1);// Counting sort by the sample
+    for (int i = 0; i < nearby.size(); i++)
+        nearbyOffsets[nearby[i].first + 1]++;
+    for (int i = 1; i <= count; i++)
+        nearbyOffsets[i] += nearbyOffsets[i - 1];
+    nearbySegments.resize(nearby.size());
+    QVector<int> fill = nearbyOffsets;
+    for (int i = 0; i < nearby.size(); i++)
+        nearbySegments[fill[nearby[i].first]++] = nearby[i].second;
+    return seedSegment;
+}
+
+void DistanceField::offer(int s, int k, QVector<bool> *changed, QVector<bool> *queued, QVector<int> *queue)
+{
+    if (nearest[s] >= 0 && sampleDistance(s, k) >= sampleDistance(s, nearest[s]))
+        return;
+    nearest[s] = k;
+    (*changed)[s] = true;
+    if (!(*queued)[s])
+    {
+        (*queued)[s] = true;
+        queue->append(s);
+    }
+}
+
+qreal DistanceField::sampleDistance(int s, int k) const
+{
+    Vec2 centre((s / samplesy + 0.5) * resolution, (s % samplesy + 0.5) * resolution);
+    return (centre - closestPoint(segments[k], centre)).length();
+}
+
+void DistanceField::markInside(const QVector<QVector<QPointF> > &walls)
+{
+    // The sign, by the even-odd rule on each row of the sample centers
+    inside.fill(false, samplesx * samplesy);
+    for (int p = 0; p < walls.size() && solid; p++)
+    {
+        const QVector<QPointF> &poly = walls[p];
+        if (poly.size() < 4 || poly.front() != poly.back())
+            continue;
+        qreal minx = poly[0].x(), maxx = minx, miny = poly[0].y(), maxy = miny;
+        for (int i = 1; i < poly.size(); i++)
+        {
+            minx = qMin(minx, poly[i].x());
+            maxx = qMax(maxx, poly[i].x());
+            miny = qMin(miny, poly[i].y());
+            maxy = qMax(maxy, poly[i].y());
+        }
+        if (minx <= 0 && miny <= 0 && maxx >= width - 1 && maxy >= height - 1)
+            continue;// The field border, everything is inside it
+
+        QVector<qreal> xs;
+        for (int j = qMax(0, qFloor(miny / resolution)); j < qMin(samplesy, qCeil(maxy / resolution) + 1); j++)
+        {
+            qreal y = (j + 0.5) * resolution;
+            xs.clear();
+            for (int i = 0; i < poly.size() - 1; i++)
+            {
+                const QPointF &a = poly[i], &b = poly[i + 1];
+                if ((a.y() <= y) != (b.y() <= y))
+                    xs.append(a.x() + (y - a.y()) * (b.x() - a.x()) / (b.y() - a.y()));
+            }
+            std::sort(xs.begin(), xs.end());
+            for (int k = 0; k + 1 < xs.size(); k += 2)
+            {
+                int from = qMax(0, qCeil(xs[k] / resolution - 0.5));
+                int to = qMin(samplesx - 1, qCeil(xs[k + 1] / resolution - 0.5) - 1);
+                for (int i = from; i <= to; i++)
+                    inside[i * samplesy + j] = true;
+            }
+        }
+    }
+}
+
+int DistanceField::sampleAt(const QPointF &p) const
+{
+    int i = qBound(0, qFloor(p.x() / resolution), samplesx - 1);
+    int j = qBound(0, qFloor(p.y() / resolution), samplesy - 1);
+    return i * samplesy + j;
+}
+
+qreal DistanceField::distance(const QPointF &p) const
+{
+    int s = sampleAt(p);
+    if (nearest[s] < 0)
+        return std::numeric_limits<qreal>::max();
+    qreal d = (Vec2(p) - closestPoint(segments[nearest[s]], p)).length();
+    return inside[s] ? -d : d;
+}
+
+Vec2 DistanceField::gradient(const QPointF &p) const
+{
+    int s = sampleAt(p);
+    if (nearest[s] < 0)
+        return Vec2();
+    Vec2 away = (Vec2(p) - closestPoint(segments[nearest[s]], p)).normalized();
+    return inside[s] ? -away : away;
+}
+
+bool DistanceField::hit(const QPointF &a, const QPointF &b, Segment *wall) const
+{
+    Segment line(a, b);
+    if (segments.size() < minTracedSegments)
+    {
+        for (int k = 0; k < segments.size(); k++)
+        {
+            if (segments[k].intersects(line))
+            {
+                if (wall)
+                    *wall = segments[k];
+                return true;
+            }
+        }
+        return false;
+    }
+
+    Vec2 dir = line.b - line.a;
+    qreal len = dir.length();
+    dir = dir.normalized();
+    int tested[16];// The last walls tested, the neighbouring samples mostly share them
+    int testedCount = 0;
+    qreal t = 0.0;
+    forever
+    {
+        qreal s = qMin(t, len);
+        Vec2 p = line.a + dir * s;
+        int sample = sampleAt(p.toPointF());
+        if (clear[sample] > resolution)
+        {
+            if (s + clear[sample] >= len)
+                return false;
+            t = s + clear[sample];
+            continue;
+        }
+
+        // Close to a wall. The points are checked every half a sample, so every sample the segment crosses
+        // is a neighbour of a checked one, and the walls through it are in the checked one's list.
+        for (int n = nearbyOffsets[sample]; n < nearbyOffsets[sample + 1]; n++)
+        {
+            int k = nearbySegments[n];
+            bool done = false;
+            for (int j = 0; j < qMin(testedCount, 16) && !done; j++)
+                done = tested[j] == k;
+            if (done)
+                continue;
+            tested[testedCount++ % 16] = k;
+            if (segments[k].intersects(line))
+            {
+                if (wall)
+                    *wall = segments[k];
+                return true;
+            }
+        }
+        if (s >= len)
+            return false;
+        t = s + resolution / 2;
+    }
+}
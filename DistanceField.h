@@ -0,0 +1,60 @@
+#ifndef DISTANCEFIELD_H
+#define DISTANCEFIELD_H
+
+#include <QtGui>
+
+#include "Geometry.h"
+#include "PrecomputeCache.h"
+
+// The distance to the nearest map wall, precomputed once for a grid of samples finer than World::cellSize.
+// The walls are rasterized into the samples they cross, and the linear time Euclidean distance transform
+// (Felzenszwalb & Huttenlocher) finds the nearest rasterized sample for every sample, so each sample knows its nearest wall.
+// A query measures the exact distance to the wall of the sample it's in, that's O(1) and overestimates the real distance
+// by errorBound() at most. hit(...) only needs a lower bound, each sample keeps one for its whole square.
+// The distance is signed: it's negative inside the enclosed polylines, except the one around the whole field(its border).
+class DistanceField
+{
+public:
+    DistanceField();
+
+    // If enclosedAreSolid is false, the distance isn't signed. For the walls whose enclosed parts may be free, like the merged outlines of ConfigurationSpace.
+    void build(const QVector<QVector<QPointF> > &walls, int width_, int height_, qreal resolution_, bool enclosedAreSolid = true);
+    // Follows the edited walls: only the samples whose nearest wall is gone or which are closer to a new wall are recomputed,
+    // by a brushfire from their neighbours. It may settle on another wall than build(...) would, up to a couple of samples off,
+    // but stays within errorBound() of the exact distance; "--self-check" compares the two after random edits of the example maps.
+    void update(const QVector<QVector<QPointF> > &walls);
+    // The samples saved under name, restore(...) takes the same arguments as build(...) and returns false if the saved field doesn't fit them
+    void store(PrecomputeCache::Writer *out, const QByteArray &name) const;
+    bool restore(const PrecomputeCache::Reader &in, const QByteArray &name, const QVector<QVector<QPointF> > &walls, int width_, int height_,
+                 qreal resolution_, bool enclosedAreSolid = true);
+
+    qreal distance(const QPointF &p) const;
+    Vec2 gradient(const QPointF &p) const;// The unit vector the distance grows along, (0, 0) exactly on a wall
+    qreal errorBound() const { return 2.0 * std::sqrt(2.0) * resolution; }
+
+    // Exact, like World::wallOnPath, but only the walls near the segment are tested: the free space is skipped by the
+    // distance, and near the walls the samples keep lists of the walls around them. Small maps are just scanned.
+    // Returns the wall that was hit.
+    bool hit(const QPointF &a, const QPointF &b, Segment *wall = NULL) const;
+
+private:
+    void setWalls(const QVector<QVector<QPointF> > &walls, int width_, int height_, qreal resolution_, bool enclosedAreSolid);
+    int sampleAt(const QPointF &p) const;// The sample whose square contains p, the nearest one for the points outside
+    QVector<int> rasterize();// Fills the nearby lists, returns the first segment through each sample(-1 for none)
+    void markInside(const QVector<QVector<QPointF> > &walls);
+    void offer(int s, int k, QVector<bool> *changed, QVector<bool> *queued, QVector<int> *queue);// For update's brushfire
+    qreal sampleDistance(int s, int k) const;// From the sample's centre to the segment
+
+    int width, height;
+    qreal resolution;
+    bool solid;// See enclosedAreSolid
+    int samplesx, samplesy;
+    QVector<Segment> segments;
+    // By sample(i * samplesy + j)
+    QVector<float> clear;// No wall is closer than that to any point of the sample's square
+    QVector<int> nearest;// The nearest segment, -1 if there are no walls at all
+    QVector<bool> inside;// Inside the enclosed walls
+    QVector<int> nearbyOffsets, nearbySegments;// The segments going through the sample or its 8 neighbours, nearbyOffsets has one more item to mark the end
+};
+
+#endif //DISTANCEFIELD_H
@@ -0,0 +1,29 @@
+#include <QtGui>
+
+#include "EnginePolicies.h"
+#include "VisibilityGraphPlanner.h"
+#include "ThetaStarPlanner.h"
+#include "HierarchicalPlanner.h"
+#include "VoronoiPlanner.h"
+
+AllPlanners::AllPlanners(const World &world):
+    currentPlanner(0)
+{
+    planners.append(new VisibilityGraphPlanner(world));
+    planners.append(new ThetaStarPlanner(world));
+    planners.append(new HierarchicalPlanner(world));
+    planners.append(new VoronoiPlanner(world));
+}
+
+AllPlanners::~AllPlanners()
+{
+    qDeleteAll(planners);
+}
+
+bool AllPlanners::select(int index)
+{
+    if (index < 0 || index >= planners.size() || index == currentPlanner)
+        return false;
+    currentPlanner = index;
+    return true;
+}
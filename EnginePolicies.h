@@ -0,0 +1,164 @@
+#ifndef ENGINEPOLICIES_H
+#define ENGINEPOLICIES_H
+
+#include <QtGui>
+
+#include "World.h"
+#include "Planner.h"
+#include "ThetaStarPlanner.h"
+#include "Geometry.h"
+#include "tools.h"
+
+// The behaviour knobs and strategies of BasicExplorationEngine. The engine is a template over a set of policies,
+// so every configuration gets its own code with the constants folded in and no virtual calls in the hot loops.
+// A policy set is EnginePolicies<Sensor, Targets, Planners, Grid>, see DefaultPolicies below for the one the program runs.
+// A new set has to be instantiated at the end of ExplorationEngine.cpp.
+
+// Sensor: what the bot sees. A circle sector of Range pixels and AngleDegrees around the bot's direction.
+template <int Range, int AngleDegrees>
+struct ConeSensor
+{
+    static constexpr qreal range() { return Range; }
+    static constexpr qreal angle() { return degr2rad(AngleDegrees); }
+    static Sector area(const QPointF &pos, qreal dirAngle) { return Sector(pos, range(), dirAngle, angle()); }
+    static constexpr int beams() { return 0; }// Every node in the sector is tested with its own sight line
+    static constexpr bool occupancy() { return false; }
+};
+
+// Sensor: a simulated lidar over the same sector, Beams beams a tick(see RangeSensor). The nodes are discovered from the
+// measured ranges instead of a sight line each, the sector is still what the next best view simulates.
+template <int Range, int AngleDegrees, int Beams>
+struct LidarSensor: ConeSensor<Range, AngleDegrees>
+{
+    static constexpr int beams() { return Beams; }
+};
+
+// Sensor: the lidar building the log-odds occupancy grid(see OccupancyGrid). A node is discovered once the grid is sure
+// it's free or occupied, so the virtual walls and the targets work on the grid's thresholded view.
+template <int Range, int AngleDegrees, int Beams>
+struct MappingLidarSensor: LidarSensor<Range, AngleDegrees, Beams>
+{
+    static constexpr bool occupancy() { return true; }
+};
+
+// Targets: the potential heuristic the next target is chosen by.
+// An undiscovered cell within KernelRadius cells adds UnknownWeight / distance to the potential, the visits subtract from it.
+// Each visit affects the cells within AffectionRadius(in the Manhattan metric). Of the cells with at least TolerancePercent
+// of the best potential, the one with the shortest path wins. At the target the bot turns around for a random time.
+template <int KernelRadius, int UnknownWeight, int TolerancePercent, int AffectionRadius>
+struct PotentialTargets
+{
+    static constexpr int kernelRadius() { return KernelRadius; }
+    static constexpr qreal unknownWeight() { return UnknownWeight; }
+    static constexpr qreal tolerance() { return TolerancePercent / 100.0; }
+    static constexpr int affectionRadius() { return AffectionRadius; }
+    static constexpr int viewCandidates() { return 0; }// No next-best-view evaluation
+    static constexpr int viewHeadings() { return 0; }
+};
+
+// Targets: the next best view. The Candidates cells with the highest potential are the candidates, the sensor is simulated
+// from each of them(in parallel) and the undiscovered cells it would see are counted for Headings directions around.
+// The view with the most cells per tick(of the path, and of the turn to the heading at its end) wins, and at the target
+// the bot turns straight to its heading. If no view sees anything new, the target is chosen like PotentialTargets does.
+template <int KernelRadius, int UnknownWeight, int TolerancePercent, int AffectionRadius, int Candidates, int Headings>
+struct NextBestViewTargets: PotentialTargets<KernelRadius, UnknownWeight, TolerancePercent, AffectionRadius>
+{
+    static constexpr int viewCandidates() { return Candidates; }
+    static constexpr int viewHeadings() { return Headings; }
+};
+
+// Planners: all of them, switched at runtime through the Planner interface. The UI needs this one.
+class AllPlanners
+{
+public:
+    AllPlanners(const World &world);
+    ~AllPlanners();
+
+    int count() const { return planners.size(); }
+    QString name(int index) const { return planners[index]->name(); }
+    int index() const { return currentPlanner; }
+    bool select(int index);// Returns false if the index is wrong or already selected
+    const Planner *current() const { return planners[currentPlanner]; }
+    QVector<QPointF> getPath(const QPointF &a, const QPointF &b) const { return planners[currentPlanner]->getPath(a, b); }
+
+private:
+    AllPlanners(const AllPlanners &);
+    AllPlanners &operator=(const AllPlanners &);
+
+    QVector<Planner *> planners;// They share the world
+    int currentPlanner;
+};
+
+// Planners: just one, called directly.
+template <class PlannerType>
+class SinglePlanner
+{
+public:
+    SinglePlanner(const World &world): planner(world) {}
+
+    int count() const { return 1; }
+    QString name(int) const { return planner.PlannerType::name(); }
+    int index() const { return 0; }
+    bool select(int) { return false; }
+    const Planner *current() const { return &planner; }
+    QVector<QPointF> getPath(const QPointF &a, const QPointF &b) const { return planner.PlannerType::getPath(a, b); }// Qualified, so it isn't a virtual call
+
+private:
+    PlannerType planner;
+};
+
+// A cellsx x cellsy grid in one block, indexed as grid[i][j] like the nested vectors.
+template <class T>
+class FlatArray
+{
+public:
+    FlatArray(): cellsx(0), cellsy(0) {}
+    FlatArray(int cellsx_, int cellsy_, const T &value): cellsx(cellsx_), cellsy(cellsy_), data(cellsx_ * cellsy_, value) {}
+
+    int size() const { return cellsx; }
+    T *operator[](int i) { return data.data() + i * cellsy; }
+    const T *operator[](int i) const { return data.constData() + i * cellsy; }
+
+private:
+    int cellsx, cellsy;
+    QVector<T> data;
+};
+
+// Grid: the cell size and how the engine's per-cell data(the potential and the visits) is stored.
+// Of<T> is the grid type, make(...) creates one filled with value.
+template <int CellSize>
+struct NestedGrid
+{
+    static constexpr qreal cellSize() { return CellSize; }
+    template <class T> using Of = QVector<QVector<T> >;
+    template <class T> static Of<T> make(int cellsx, int cellsy, const T &value) { return Of<T>(cellsx, QVector<T>(cellsy, value)); }
+};
+
+template <int CellSize>
+struct FlatGrid
+{
+    static constexpr qreal cellSize() { return CellSize; }
+    template <class T> using Of = FlatArray<T>;
+    template <class T> static Of<T> make(int cellsx, int cellsy, const T &value) { return Of<T>(cellsx, cellsy, value); }
+};
+
+template <class Sensor_, class Targets_, class Planners_, class Grid_>
+struct EnginePolicies
+{
+    typedef Sensor_ Sensor;
+    typedef Targets_ Targets;
+    typedef Planners_ Planners;
+    typedef Grid_ Grid;
+};
+
+typedef EnginePolicies<ConeSensor<200, 60>, PotentialTargets<5, 10, 95, 3>, AllPlanners, NestedGrid<8> > DefaultPolicies;
+// The same behaviour with Theta* only and the flat grids, for comparing against the default(see --bench-engines)
+typedef EnginePolicies<ConeSensor<200, 60>, PotentialTargets<5, 10, 95, 3>, SinglePlanner<ThetaStarPlanner>, FlatGrid<8> > LeanPolicies;
+// The default one choosing the next best view instead of the best potential(see --batch --next-best-view)
+typedef EnginePolicies<ConeSensor<200, 60>, NextBestViewTargets<5, 10, 95, 3, 12, 16>, AllPlanners, NestedGrid<8> > NextBestViewPolicies;
+// The default one seeing through the lidar, 2048 beams are closer than a pixel apart at the range(see --batch --lidar)
+typedef EnginePolicies<LidarSensor<200, 60, 2048>, PotentialTargets<5, 10, 95, 3>, AllPlanners, NestedGrid<8> > LidarPolicies;
+// The lidar mapping the occupancy on the grid of half the default cell size(see --batch --occupancy)
+typedef EnginePolicies<MappingLidarSensor<200, 60, 2048>, PotentialTargets<5, 10, 95, 3>, AllPlanners, NestedGrid<4> > OccupancyPolicies;
+
+#endif //ENGINEPOLICIES_H
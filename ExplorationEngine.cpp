@@ -0,0 +1,998 @@
+#include <QtGui>
+#include <QtConcurrentMap>
+
+#include <queue>
+#include <cmath>
+#include <algorithm>
+
+#include "ExplorationEngine.h"
+#include "tools.h"
+#include "Geometry.h"
+#include "TraceRecorder.h"
+#include "TraceFormat.h"
+#include "SnapshotFormat.h"
+
+template <class Policies>
+BasicExplorationEngine<Policies>::BasicExplorationEngine(int width_, int height_, const QVector<QVector<QPointF> > &map_, quint64 seed,
+                                                         const QPointF &startPos, qreal startAngle):
+    moveSpeed(10.0), rotSpeed(0.1),
+    curPos(startPos), curAngle(startAngle),
+    control(AIControl),
+    state(NoState),
+    world(width_, height_, map_, Grid::cellSize()),
+    cellsx(world.isDiscovered.size()), cellsy(world.isDiscovered[0].size()),
+    lidar(Sensor::beams(), Sensor::angle(), Sensor::range()),
+    planners(world),
+    targetPos(curPos),
+    viewAngle(-1.0),
+    random(seed),
+    tickCount(0),
+    recorder(NULL),
+    pathEvents(0)
+{
+    discoveredCount = 0;
+    discoverAround(curPos);// The cells around the start are known from the beginning
+
+    visits = Grid::make(cellsx, cellsy, 0);
+    potential = Grid::make(cellsx, cellsy, qreal(0.0));
+}
+
+template <class Policies>
+void BasicExplorationEngine<Policies>::discoverAround(const QPointF &p)
+{
+    int sx = qBound(0, int(p.x() / world.cellSize), cellsx - 2);
+    int sy = qBound(0, int(p.y() / world.cellSize), cellsy - 2);
+    for (int i = sx; i <= sx + 1; i++)
+    {
+        for (int j = sy; j <= sy + 1; j++)
+        {
+            if (world.isDiscovered[i][j])
+                continue;
+            world.setDiscovered(i, j);
+            discoveredCount++;
+            if (recorder != NULL)// Also called after the push-out from the walls, outside exploreMap
+                newCells.append(QPoint(i, j));
+        }
+    }
+}
+
+template <class Policies>
+bool BasicExplorationEngine<Policies>::exploreMap()
+{
+    if (Sensor::occupancy())
+        return exploreByOccupancy();
+    bool discovered = false;
+
+    qreal stx = curPos.x() - Sensor::range(), fnx = curPos.x() + Sensor::range();
+    qreal sty = curPos.y() - Sensor::range(), fny = curPos.y() + Sensor::range();
+    int stxp = qMax(0.0, stx / world.cellSize), fnxp = qMin(qreal(cellsx - 1), fnx / world.cellSize);
+    int styp = qMax(0.0, sty / world.cellSize), fnyp = qMin(qreal(cellsy - 1), fny / world.cellSize);
+    Sector fov = Sensor::area(curPos, curAngle);
+    if (Sensor::beams() > 0)
+        lidar.scan(world.sightSets, curPos, curAngle, &scan);
+    ArenaVector<DiscoveryTree::Leaf> leaves;
+    world.discoveryTree.getLeaves(QRect(stxp, styp, fnxp - stxp + 1, fnyp - styp + 1), &leaves);
+    for (int k = 0; k < int(leaves.size()); k++)
+    {
+        if (leaves[k].discovered)
+            continue;// Nothing new there
+        const QRect &r = leaves[k].cells;
+        for (int i = qMax(r.left(), stxp); i <= qMin(r.right(), fnxp); i++)
+        {
+            for (int j = qMax(r.top(), styp); j <= qMin(r.bottom(), fnyp); j++)
+            {
+                if (sees(fov, world.cellSize * QPointF(i, j)))
+                {
+                    world.setDiscovered(i, j);
+                    discoveredCount++;
+                    discovered = true;
+                    if (recorder != NULL)
+                        newCells.append(QPoint(i, j));
+                }
+            }
+        }
+    }
+    world.updateVirtualWalls();
+    return discovered;
+}
+
+template <class Policies>
+bool BasicExplorationEngine<Policies>::exploreByOccupancy()
+{
+    lidar.scan(world.sightSets, curPos, curAngle, &scan);
+    world.occupancy.observe(scan, world.cellSize, &observation);
+    world.occupancy.integrate(observation);
+    bool discovered = false;
+    const QRect &r = observation.nodes;
+    for (int i = r.left(); i <= r.right(); i++)
+    {
+        for (int j = r.top(); j <= r.bottom(); j++)
+        {
+            if (world.isDiscovered[i][j] || !world.occupancy.isKnown(i, j))
+                continue;
+            world.setDiscovered(i, j);
+            discoveredCount++;
+            discovered = true;
+            if (recorder != NULL)
+                newCells.append(QPoint(i, j));
+        }
+    }
+    world.updateVirtualWalls();
+    return discovered;
+}
+
+template <class Policies>
+bool BasicExplorationEngine<Policies>::sees(const Sector &fov, const QPointF &p) const
+{
+    if (Sensor::beams() > 0)
+        return scan.covers(p);
+    return fov.contains(p) && !wallOnPathTo(p);
+}
+
+template <class Policies>
+void BasicExplorationEngine<Policies>::handleKeys()
+{
+    bool needsDiscover = false;
+    if (pressedKeys[Qt::Key_Left])
+    {
+        curAngle += rotSpeed;
+        needsDiscover = true;
+    }
+    if (pressedKeys[Qt::Key_Right])
+    {
+        curAngle -= rotSpeed;
+        needsDiscover = true;
+    }
+    if (pressedKeys[Qt::Key_Up])
+    {
+        makeManualMove();
+        needsDiscover = true;
+    }
+    if (needsDiscover)
+    {
+        exploreMap();
+    }
+}
+
+template <class Policies>
+bool BasicExplorationEngine<Policies>::makeManualMove()
+{
+    Vec2 step = Vec2::fromAngle(curAngle) * moveSpeed;
+    Segment wall;
+    if (world.obstacleField().hit(curPos, (Vec2(curPos) + step).toPointF(), &wall))
+    {
+        Vec2 dir = wall.b - wall.a;
+        bool wallIsCCW = step.cross(dir) <= 0;// counter-clockwise on the screen, the y axis points down
+        if (wallIsCCW ^ (step.dot(dir) > 0))
+            curAngle -= rotSpeed;
+        else
+            curAngle += rotSpeed;
+        return false;
+    }
+    curPos += step.toPointF();
+    return true;
+}
+
+template <class Policies>
+bool BasicExplorationEngine<Policies>::wallOnPathTo(const QPointF &b) const
+{
+    return world.wallInSight(curPos, b);
+}
+
+template <class Policies>
+void BasicExplorationEngine<Policies>::updatePotential()
+{
+    const int radius = Targets::kernelRadius();
+    ArenaVector<DiscoveryTree::Leaf> leaves;
+    world.discoveryTree.getLeaves(QRect(0, 0, cellsx, cellsy), &leaves);
+    for (int k = 0; k < int(leaves.size()); k++)
+    {
+        const QRect &r = leaves[k].cells;
+        if (!leaves[k].discovered)
+        {
+            for (int i = r.left(); i <= r.right(); i++)
+                for (int j = r.top(); j <= r.bottom(); j++)
+                    potential[i][j] = -1000000.0;
+            continue;
+        }
+
+        // The cells see radius cells around(one less to the right and down), if it's all discovered only the visits matter
+        QRect around = QRect(r.left() - radius, r.top() - radius, r.width() + 2 * radius - 1, r.height() + 2 * radius - 1)
+                       .intersected(QRect(0, 0, cellsx, cellsy));
+        bool isInner = world.discoveryTree.discoveredIn(around) == around.width() * around.height();
+        for (int i = r.left(); i <= r.right(); i++)
+        {
+            for (int j = r.top(); j <= r.bottom(); j++)
+            {
+                if (!isInner)
+                    updateCellPotential(i, j);
+                else if (i > 0 && i < cellsx - 1 && j > 0 && j < cellsy - 1)
+                    potential[i][j] = -visits[i][j];
+            }
+        }
+    }
+}
+
+template <class Policies>
+void BasicExplorationEngine<Policies>::updateCellPotential(int i, int j)
+{
+    int prob = 100;//%
+    const int radius = Targets::kernelRadius();
+    if (!isPotentialComputed(i, j))
+        return;
+    potential[i][j] = 0.0;
+    for (int q = qMax(i - radius, 0); q < qMin(cellsx, i + radius); q++)
+    {
+        for (int w = qMax(j - radius, 0); w < qMin(cellsy, j + radius); w++)
+        {
+            if (i == q && j == w)
+                continue;
+            if (!world.isDiscovered[q][w])
+            {
+                if (random.bounded(100) >= prob)
+                    continue;
+                potential[i][j] += Targets::unknownWeight() / qSqrt((q - i) * (q - i) + (w - j) * (w - j) + 0.0);
+            }
+        }
+    }
+    potential[i][j] -= visits[i][j];
+}
+
+template <class Policies>
+bool BasicExplorationEngine<Policies>::isPotentialComputed(int i, int j) const
+{
+    return world.isDiscovered[i][j] &&
+           i > 0 && i < cellsx - 1 &&
+           j > 0 && j < cellsy - 1 &&
+           world.isDiscovered[i - 1][j] && world.isDiscovered[i + 1][j] &&
+           world.isDiscovered[i][j - 1] && world.isDiscovered[i][j + 1];
+}
+
+template <class Policies>
+QPointF BasicExplorationEngine<Policies>::getAITarget() const
+{
+    int reach = world.freeSpaceAt(curPos);// The cells in the other components are skipped before any path search
+    int mi = -1, mj = -1;
+    for (int i = 0; i < cellsx; i++)
+    {
+        for (int j = 0; j < cellsy; j++)
+        {
+            if (world.isDiscovered[i][j] && isReachable(i, j, reach) && (mi == -1 || mj == -1 || potential[i][j] > potential[mi][mj]))
+            {
+                mi = i;
+                mj = j;
+            }
+        }
+    }
+    int ci = mi, cj = mj;
+    qreal maxpath = 0.0;
+    QVector<QPointF> mp = planners.getPath(curPos, world.cellSize * QPointF(mi, mj));
+    for (int i = 0; i < mp.size() - 1; i++)
+        maxpath += distance(mp[i], mp[i + 1]);
+
+    for (int i = 0; i < cellsx; i++)
+    {
+        for (int j = 0; j < cellsy; j++)
+        {
+            if (world.isDiscovered[i][j] && isReachable(i, j, reach))
+            {
+                if (potential[i][j] >= Targets::tolerance() * potential[mi][mj] &&
+                    distance(curPos, world.cellSize * QPointF(i, j)) > 1.0)//epsilon
+                {
+                    qreal curpath = 0.0;
+                    QVector<QPointF> cp = planners.getPath(curPos, world.cellSize * QPointF(i, j));
+                    for (int e = 0; e < cp.size() - 1; e++)
+                        curpath += distance(cp[e], cp[e + 1]);
+                    if (!cp.isEmpty() && curpath < maxpath)// An empty path isn't a short one
+                    {
+                        ci = i;
+                        cj = j;
+                        maxpath = curpath;
+                    }
+                }
+            }
+        }
+    }
+    return world.cellSize * QPointF(ci, cj);
+}
+
+namespace
+{
+
+struct ViewJob
+{
+    const World *world;
+    QPointF pos;
+    qreal range;
+};
+
+// The undiscovered nodes the sensor would see from the job's position, looking in any direction. Only reads the world.
+QVector<Vec2> unknownInSight(const ViewJob &job)
+{
+    ArenaScope scope;// On the worker thread's arena
+    const World &world = *job.world;
+    int cellsx = world.isDiscovered.size(), cellsy = world.isDiscovered[0].size();
+    int stxp = qMax(0.0, (job.pos.x() - job.range) / world.cellSize), fnxp = qMin(qreal(cellsx - 1), (job.pos.x() + job.range) / world.cellSize);
+    int styp = qMax(0.0, (job.pos.y() - job.range) / world.cellSize), fnyp = qMin(qreal(cellsy - 1), (job.pos.y() + job.range) / world.cellSize);
+    ArenaVector<DiscoveryTree::Leaf> leaves;
+    world.discoveryTree.getLeaves(QRect(stxp, styp, fnxp - stxp + 1, fnyp - styp + 1), &leaves);
+    QVector<Vec2> cells;
+    for (int k = 0; k < int(leaves.size()); k++)
+    {
+        if (leaves[k].discovered)
+            continue;
+        const QRect &r = leaves[k].cells;
+        for (int i = qMax(r.left(), stxp); i <= qMin(r.right(), fnxp); i++)
+        {
+            for (int j = qMax(r.top(), styp); j <= qMin(r.bottom(), fnyp); j++)
+            {
+                Vec2 p(world.cellSize * i, world.cellSize * j);
+                if ((p - job.pos).lengthSquared() < job.range * job.range && !world.wallInSight(job.pos, p.toPointF()))
+                    cells.append(p);
+            }
+        }
+    }
+    return cells;
+}
+
+struct ViewCandidate
+{
+    qreal potential;
+    int i, j;
+};
+
+bool isBetterCandidate(const ViewCandidate &a, const ViewCandidate &b)// Higher potential first, then in the order of the grid scan
+{
+    if (a.potential != b.potential)
+        return a.potential > b.potential;
+    return a.i < b.i || (a.i == b.i && a.j < b.j);
+}
+
+qreal turnBetween(qreal a, qreal b)// The smaller angle between two directions
+{
+    qreal d = std::fmod(qAbs(a - b), 2 * PI());
+    return d > PI() ? 2 * PI() - d : d;
+}
+
+}
+
+template <class Policies>
+QPointF BasicExplorationEngine<Policies>::getBestView(qreal *heading) const
+{
+    int reach = world.freeSpaceAt(curPos);
+    QVector<ViewCandidate> candidates;
+    for (int i = 0; i < cellsx; i++)
+    {
+        for (int j = 0; j < cellsy; j++)
+        {
+            if (isPotentialComputed(i, j) && world.isFreeNode(i, j) && isReachable(i, j, reach) &&
+                distance(curPos, world.cellSize * QPointF(i, j)) > 1.0)
+            {
+                ViewCandidate c = {potential[i][j], i, j};
+                candidates.append(c);
+            }
+        }
+    }
+    int count = qMin(candidates.size(), Targets::viewCandidates());
+    std::partial_sort(candidates.begin(), candidates.begin() + count, candidates.end(), isBetterCandidate);
+
+    // The paths first, the planners aren't thread-safe. Then the views are simulated in parallel, they only read the world.
+    QList<ViewJob> jobs;
+    QVector<qreal> pathTicks, arrivalAngles;
+    for (int c = 0; c < count; c++)
+    {
+        ViewJob job = {&world, world.cellSize * QPointF(candidates[c].i, candidates[c].j), Sensor::range()};
+        QVector<QPointF> p = planners.getPath(curPos, job.pos);
+        if (p.isEmpty())
+            continue;
+        qreal length = 0.0;
+        for (int e = 0; e < p.size() - 1; e++)
+            length += distance(p[e], p[e + 1]);
+        jobs.append(job);
+        pathTicks.append(length / moveSpeed);
+        arrivalAngles.append(p.size() >= 2 ? (Vec2(p.back()) - p[p.size() - 2]).angle() : curAngle);
+    }
+    QList<QVector<Vec2> > seen = QtConcurrent::blockingMapped<QList<QVector<Vec2> > >(jobs, unknownInSight);
+
+    qreal bestScore = 0.0;
+    QPointF bestPos;
+    *heading = -1.0;
+    for (int v = 0; v < jobs.size(); v++)
+    {
+        for (int h = 0; h < Targets::viewHeadings(); h++)
+        {
+            qreal angle = 2 * PI() * h / Targets::viewHeadings();
+            Sector fov = Sensor::area(jobs[v].pos, angle);
+            int gain = 0;
+            for (int k = 0; k < seen[v].size(); k++)
+                gain += fov.contains(seen[v][k]);
+            qreal ticks = pathTicks[v] + turnBetween(arrivalAngles[v], angle) / rotSpeed + 1;
+            if (gain / ticks > bestScore)
+            {
+                bestScore = gain / ticks;
+                bestPos = jobs[v].pos;
+                *heading = angle;
+            }
+        }
+    }
+    if (*heading < 0)
+        return getAITarget();
+    return bestPos;
+}
+
+template <class Policies>
+bool BasicExplorationEngine<Policies>::isReachable(int i, int j, int reach) const
+{
+    return reach == -1 || world.freeSpace.label(i, j) == reach;
+}
+
+template <class Policies>
+bool BasicExplorationEngine<Policies>::hasFrontier() const
+{
+    int minNodes = qCeil(world.minPocketArea / (world.cellSize * world.cellSize));// The pockets too small for the virtual walls aren't worth a trip either
+    return world.freeSpace.hasFrontier(world.freeSpaceAt(curPos), minNodes);
+}
+
+template <class Policies>
+void BasicExplorationEngine<Policies>::makeAIMove()
+{
+    if (state == CompleteState)
+        return;
+    exploreMap();
+#ifdef DEBUG
+    /*qDebug() << state << endl;
+    if (state == FollowPathState)
+    {
+        qDebug() << path << endl;
+    }
+    qDebug() << " -------" << endl;*/
+#endif
+    if (state == FollowPathState)
+    {
+        if (path.size() == 0) // We haven't found a path(or it is incorrect)
+        {
+            addVisitsCount(targetPos);// We lower target point's potential, and its probality to be chosen again
+            state = NoState;// Another chance
+        }
+        else
+        {
+            addVisitsCount(curPos);
+            if (path.size() <= 1)
+            {
+                if (viewAngle >= 0)
+                    state = FaceViewState;
+                else if (random.bounded(2) == 0)
+                    state = PointExploreStateCW;
+                else
+                    state = PointExploreStateCCW;
+                return;
+            }
+            QPointF a = path[0];
+            QPointF b = path[1];
+            bool came = makeMoveByLine(a, b);
+            if (came) // we have passed a, so we can remove it from the path
+            {
+                path.pop_front();
+                pathEvents |= TraceFormat::PathAdvanced;
+            }
+        }
+    }
+    else if (state == NoState)
+    {
+        if (!hasFrontier())
+        {
+            state = CompleteState;
+            return;
+        }
+        updatePotential();
+        if (Targets::viewCandidates() > 0)
+            targetPos = getBestView(&viewAngle);
+        else
+            targetPos = getAITarget();
+        path = planners.getPath(curPos, targetPos);
+        pathEvents |= TraceFormat::NewPath;
+        state = FollowPathState;
+    }
+    else if (state == PointExploreStateCW || state == PointExploreStateCCW)
+    {
+        int stopProbality = 90;// The parameter to control rotation time.
+        if (random.bounded(100) > stopProbality)
+        {
+            state = NoState;
+        }
+        else
+        {
+            if (state == PointExploreStateCW)
+                curAngle -= rotSpeed;
+            else
+                curAngle += rotSpeed;
+        }
+    }
+    else if (state == FaceViewState)
+    {
+        if (turnTowards(viewAngle))
+            state = NoState;
+    }
+}
+
+namespace
+{
+
+bool isOnSegment(QPointF p, QPointF a, QPointF b) //returns true if p belongs to segment [a, b]
+{
+    //segment = [t * a + (1 - t) * b | 0 <= t <= 1]
+    qreal eps = 0.001;
+    if (qAbs(a.x() - b.x()) < eps) // to exclude division by zero
+    {
+        qSwap(a.rx(), a.ry());
+        qSwap(b.rx(), b.ry());
+        qSwap(p.rx(), p.ry());
+    }
+    qreal t = (p.x() - b.x()) / (a.x() - b.x());
+    if (t >= 0 && t <= 1)
+    {
+        if (qAbs(t * a.y() + (1 - t) * b.y() - p.y()) < 0.01)
+            return true;
+    }
+    return false;
+}
+
+}
+
+template <class Policies>
+bool BasicExplorationEngine<Policies>::makeMoveByLine(const QPointF &a, const QPointF &b)
+{
+    if (turnTowards((Vec2(b) - a).angle()))
+    {
+        QPointF newPos = curPos + (Vec2::fromAngle(curAngle) * moveSpeed).toPointF();
+        if (isOnSegment(newPos, a, b))
+            curPos = newPos;
+        else
+        {
+            curPos = b;
+            return true;
+        }
+    }
+    return false;
+}
+
+template <class Policies>
+bool BasicExplorationEngine<Policies>::turnTowards(qreal angle)
+{
+    while (curAngle + 2 * PI() < 0)
+        curAngle += 2 * PI();
+    while (curAngle - 2 * PI() >= 0)
+        curAngle -= 2 * PI();
+
+    if (curAngle == angle)
+        return true;
+
+    bool ccw;//counter-clockwise
+    if (angle > curAngle)
+    {
+        if (curAngle + PI() > angle)
+            ccw = true;
+        else
+            ccw = false;
+    }
+    else
+    {
+        if (angle + PI() > curAngle)
+            ccw = false;
+        else
+            ccw = true;
+    }
+    if (ccw)
+    {
+        if (angle < curAngle)
+            angle += 2 * PI();
+        if (curAngle + rotSpeed >= angle)
+            curAngle = angle;
+        else
+            curAngle += rotSpeed;
+    }
+    else
+    {
+        if (curAngle < angle)
+            curAngle += 2 * PI();
+        if (curAngle - rotSpeed <= angle)
+            curAngle = angle;
+        else
+            curAngle -= rotSpeed;
+    }
+    return false;
+}
+
+template <class Policies>
+void BasicExplorationEngine<Policies>::addVisitsCount(const QPointF &p, qreal value)
+{
+    const int affectionRadius = Targets::affectionRadius();
+    int cx = p.x() / world.cellSize, cy = p.y() / world.cellSize;
+    for (int q = -affectionRadius; q <= affectionRadius; q++)
+    {
+        if (cx + q < 0 || cx + q >= cellsx)
+            continue;
+        for (int w = -affectionRadius; w <= affectionRadius; w++)
+        {
+            if (cy + w < 0 || cy + w >= cellsy)
+                continue;
+            visits[cx + q][cy + w] += value / (abs(q) + abs(w) + 1.0);
+        }
+    }
+    visits[cx][cy] += value;
+}
+
+template <class Policies>
+QStringList BasicExplorationEngine<Policies>::plannerNames() const
+{
+    QStringList names;
+    for (int i = 0; i < planners.count(); i++)
+        names << planners.name(i);
+    return names;
+}
+
+template <class Policies>
+void BasicExplorationEngine<Policies>::setPlanner(int index)
+{
+    if (!planners.select(index))
+        return;
+    state = NoState;// The path was found by another planner
+}
+
+template <class Policies>
+void BasicExplorationEngine<Policies>::setRobotRadius(qreal radius)
+{
+    if (radius == world.robotRadius)
+        return;
+    world.setRobotRadius(radius);
+    QPointF pos = world.pushedOut(curPos);
+    if (pos != curPos)
+    {
+        ArenaScope scope;// exploreMap's temporaries, it's not in a tick
+        curPos = pos;
+        discoverAround(curPos);// As at the start, the bot knows where it stands
+        exploreMap();
+    }
+    state = NoState;// The path may go through the grown walls
+}
+
+template <class Policies>
+void BasicExplorationEngine<Policies>::toggleManualControl()
+{
+    state = NoState;
+    if (control == ManualContol)
+        control = AIControl;
+    else
+        control = ManualContol;
+}
+
+template <class Policies>
+void BasicExplorationEngine<Policies>::commitWalls()
+{
+    if (!world.hasEditedWalls())
+        return;
+    world.commitWalls();
+    if (recorder != NULL)
+        recorder->recordWalls(world, tickCount);
+    QPointF pos = world.pushedOut(curPos);
+    if (pos != curPos)// A wall was put over the bot
+    {
+        curPos = pos;
+        discoverAround(curPos);
+        state = NoState;
+    }
+    if (state == CompleteState || (state == FollowPathState && isPathBlocked()))
+        state = NoState;// Only the plan the edit broke is made again
+}
+
+template <class Policies>
+bool BasicExplorationEngine<Policies>::isPathBlocked() const
+{
+    QPointF from = curPos;// It's between path[0] and path[1]
+    for (int i = 1; i < path.size(); i++)
+    {
+        if (world.wallOnPath(from, path[i]))
+            return true;
+        from = path[i];
+    }
+    return false;
+}
+
+template <class Policies>
+void BasicExplorationEngine<Policies>::tick()
+{
+    commitWalls();
+    ArenaScope scope;// The temporaries of the whole tick
+    pathEvents = 0;
+    if (control == ManualContol)
+        handleKeys();
+    else
+        makeAIMove();
+    tickCount++;
+    if (recorder != NULL)
+    {
+        recorder->record(*this, newCells, pathEvents);
+        newCells.clear();
+    }
+}
+
+template <class Policies>
+void BasicExplorationEngine<Policies>::setRecorder(TraceRecorder *recorder_)
+{
+    recorder = recorder_;
+    newCells.clear();
+}
+
+template <class Policies>
+void BasicExplorationEngine<Policies>::setKeyPressed(int key, bool pressed)
+{
+    pressedKeys[key] = pressed;
+}
+
+template <class Policies>
+qreal BasicExplorationEngine<Policies>::coverage() const
+{
+    return qreal(discoveredCount) / (cellsx * cellsy);
+}
+
+template <class Policies>
+QByteArray BasicExplorationEngine<Policies>::saveSnapshot() const
+{
+    using namespace TraceFormat;
+    QByteArray out(SnapshotFormat::magic, sizeof(SnapshotFormat::magic));
+    writeByte(&out, SnapshotFormat::version);
+    writeInt16(&out, world.width);
+    writeInt16(&out, world.height);
+    writeVarint(&out, cellsx);
+    writeVarint(&out, cellsy);
+    writeUint64(&out, mapHash(world.initialMap));
+    writeReal(&out, world.robotRadius);
+    QVector<QVector<QPointF> > walls = world.map.mid(0, world.map.size() - 1);
+    writeByte(&out, walls != world.initialMap);
+    if (walls != world.initialMap)
+    {
+        writeVarint(&out, walls.size());
+        for (int i = 0; i < walls.size(); i++)
+        {
+            writeVarint(&out, walls[i].size());
+            for (int k = 0; k < walls[i].size(); k++)
+            {
+                writeReal(&out, walls[i][k].x());
+                writeReal(&out, walls[i][k].y());
+            }
+        }
+    }
+
+    writeVarint(&out, tickCount);
+    writeByte(&out, control);
+    writeByte(&out, state);
+    writeByte(&out, planners.index());
+    writeReal(&out, curPos.x());
+    writeReal(&out, curPos.y());
+    writeReal(&out, curAngle);
+    writeReal(&out, targetPos.x());
+    writeReal(&out, targetPos.y());
+    writeReal(&out, viewAngle);
+    writeVarint(&out, path.size());
+    for (int i = 0; i < path.size(); i++)
+    {
+        writeReal(&out, path[i].x());
+        writeReal(&out, path[i].y());
+    }
+    for (int i = 0; i < 4; i++)
+        writeUint64(&out, random.state(i));
+
+    bool value = false;
+    int run = 0;
+    for (int i = 0; i < cellsx; i++)
+    {
+        for (int j = 0; j < cellsy; j++)
+        {
+            if (world.isDiscovered[i][j] != value)
+            {
+                writeVarint(&out, run);
+                value = !value;
+                run = 0;
+            }
+            run++;
+        }
+    }
+    writeVarint(&out, run);
+
+    int total = cellsx * cellsy;
+    for (int k = 0; k < total; )
+    {
+        int zeros = 0;
+        while (k + zeros < total && visits[(k + zeros) / cellsy][(k + zeros) % cellsy] == 0)
+            zeros++;
+        k += zeros;
+        int values = 0;
+        while (k + values < total && visits[(k + values) / cellsy][(k + values) % cellsy] != 0)
+            values++;
+        writeVarint(&out, zeros);
+        writeVarint(&out, values);
+        for (int v = k; v < k + values; v++)
+            writeVarint(&out, visits[v / cellsy][v % cellsy]);
+        k += values;
+    }
+
+    qreal unknownPotential = 0.0;
+    for (int k = 0; k < total; k++)
+    {
+        if (!world.isDiscovered[k / cellsy][k % cellsy])
+        {
+            unknownPotential = potential[k / cellsy][k % cellsy];
+            break;
+        }
+    }
+    writeReal(&out, unknownPotential);
+    for (int i = 0; i < cellsx; i++)
+    {
+        for (int j = 0; j < cellsy; j++)
+        {
+            if (world.isDiscovered[i][j] && !isPotentialComputed(i, j))
+                writeReal(&out, potential[i][j]);
+        }
+    }
+    return out;
+}
+
+template <class Policies>
+bool BasicExplorationEngine<Policies>::restoreSnapshot(const QByteArray &snapshot)
+{
+    if (snapshot.size() < int(sizeof(SnapshotFormat::magic)) ||
+        memcmp(snapshot.constData(), SnapshotFormat::magic, sizeof(SnapshotFormat::magic)) != 0)
+    {
+        return false;
+    }
+    TraceFormat::Reader r(snapshot.constData() + sizeof(SnapshotFormat::magic), snapshot.constData() + snapshot.size());
+    if (r.byte() != SnapshotFormat::version)
+        return false;
+    if (r.int16() != world.width || r.int16() != world.height ||
+        int(r.varint()) != cellsx || int(r.varint()) != cellsy ||
+        r.uint64() != mapHash(world.initialMap) || !r.ok())
+    {
+        return false;
+    }
+
+    // Everything is read aside first, so a broken snapshot leaves the engine as it was
+    qreal newRadius = r.real();
+    QVector<QVector<QPointF> > newWalls = world.initialMap;
+    if (r.byte() != 0)
+    {
+        int count = r.varint();
+        if (!r.ok() || count > snapshot.size())
+            return false;
+        newWalls.resize(count);
+        for (int i = 0; i < count; i++)
+        {
+            int points = r.varint();
+            if (!r.ok() || points > snapshot.size())
+                return false;
+            newWalls[i].resize(points);
+            for (int k = 0; k < points; k++)
+            {
+                qreal x = r.real(), y = r.real();
+                newWalls[i][k] = QPointF(x, y);
+            }
+        }
+    }
+    if (!r.ok() || !(newRadius >= 0))
+        return false;
+    int newTick = r.varint();
+    int newControl = r.byte(), newState = r.byte(), newPlanner = r.byte();
+    qreal x = r.real(), y = r.real();
+    QPointF newPos(x, y);
+    qreal newAngle = r.real();
+    x = r.real();
+    y = r.real();
+    QPointF newTarget(x, y);
+    qreal newViewAngle = r.real();
+    int pathSize = r.varint();
+    if (!r.ok() || newControl > AIControl || newState > CompleteState || newPlanner >= planners.count() ||
+        pathSize > snapshot.size())
+    {
+        return false;
+    }
+    QVector<QPointF> newPath(pathSize);
+    for (int i = 0; i < pathSize; i++)
+    {
+        x = r.real();
+        y = r.real();
+        newPath[i] = QPointF(x, y);
+    }
+    quint64 randomState[4];
+    for (int i = 0; i < 4; i++)
+        randomState[i] = r.uint64();
+
+    int total = cellsx * cellsy;
+    QVector<QVector<bool> > grid(cellsx, QVector<bool>(cellsy, false));
+    int newDiscovered = 0;
+    bool value = false;
+    for (int k = 0; k < total && r.ok(); value = !value)
+    {
+        int run = r.varint();
+        if (run > total - k)
+            return false;
+        for (int end = k + run; k < end; k++)
+        {
+            grid[k / cellsy][k % cellsy] = value;
+            newDiscovered += value;
+        }
+    }
+
+    VisitsGrid newVisits = Grid::make(cellsx, cellsy, 0);
+    for (int k = 0; k < total && r.ok(); )
+    {
+        int zeros = r.varint(), values = r.varint();
+        if (zeros > total - k || values > total - k - zeros)
+            return false;
+        k += zeros;
+        for (int end = k + values; k < end; k++)
+            newVisits[k / cellsy][k % cellsy] = r.varint();
+    }
+
+    PotentialGrid newPotential = Grid::make(cellsx, cellsy, r.real());
+    if (!r.ok())
+        return false;
+
+    // The kept potentials depend on the new grid, isPotentialComputed reads it from the world
+    QVector<QVector<bool> > oldGrid = world.isDiscovered;
+    world.isDiscovered = grid;
+    for (int i = 0; i < cellsx; i++)
+    {
+        for (int j = 0; j < cellsy; j++)
+        {
+            if (!grid[i][j])
+                continue;
+            if (isPotentialComputed(i, j))
+                newPotential[i][j] = -newVisits[i][j];// Only for the picture, it's recomputed before the AI needs it
+            else
+                newPotential[i][j] = r.real();
+        }
+    }
+    if (!r.ok() || !r.atEnd())
+    {
+        world.isDiscovered = oldGrid;
+        return false;
+    }
+
+    if (newWalls != world.map.mid(0, world.map.size() - 1))
+    {
+        world.setWalls(newWalls);
+        world.commitWalls();
+    }
+    if (newRadius != world.robotRadius)
+        world.setRobotRadius(newRadius);
+    world.syncDiscoveryTree();
+    world.occupancy.resize(cellsx, cellsy);// It isn't in the snapshots, the evidence is collected again
+    world.updateVirtualWalls();
+    discoveredCount = newDiscovered;
+    visits = newVisits;
+    potential = newPotential;
+    tickCount = newTick;
+    control = Control(newControl);
+    state = ExplorationState(newState);
+    planners.select(newPlanner);
+    curPos = newPos;
+    curAngle = newAngle;
+    targetPos = newTarget;
+    viewAngle = newViewAngle;
+    path = newPath;
+    for (int i = 0; i < 4; i++)
+        random.setState(i, randomState[i]);
+    newCells.clear();
+    return true;
+}
+
+template <class Policies>
+void BasicExplorationEngine<Policies>::setSeed(quint64 seed)
+{
+    random.setSeed(seed);
+}
+
+template class BasicExplorationEngine<DefaultPolicies>;
+template class BasicExplorationEngine<LeanPolicies>;
+template class BasicExplorationEngine<NextBestViewPolicies>;
+template class BasicExplorationEngine<LidarPolicies>;
+template class BasicExplorationEngine<OccupancyPolicies>;
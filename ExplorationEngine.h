@@ -0,0 +1,160 @@
+#ifndef EXPLORATIONENGINE_H
+#define EXPLORATIONENGINE_H
+
+#include <QtGui>
+
+#include "World.h"
+#include "Planner.h"
+#include "Random.h"
+#include "Geometry.h"
+#include "EnginePolicies.h"
+#include "RangeSensor.h"
+
+class TraceRecorder;
+
+// The simulation itself: the bot, its AI and the world it explores. Knows nothing about the rendering,
+// so it can be stepped as fast as needed. Each tick is a fixed simulation step.
+// The knobs and strategies come from Policies(see EnginePolicies.h), ExplorationEngine is the configuration the program runs.
+template <class Policies>
+class BasicExplorationEngine
+{
+public:
+    typedef typename Policies::Sensor Sensor;
+    typedef typename Policies::Targets Targets;
+    typedef typename Policies::Grid Grid;
+    typedef typename Grid::template Of<qreal> PotentialGrid;
+    typedef typename Grid::template Of<int> VisitsGrid;
+
+    // The same seed and start pose give the same run, independently of other engines
+    BasicExplorationEngine(int width_, int height_, const QVector<QVector<QPointF> > &map_, quint64 seed = 10,
+                           const QPointF &startPos = QPointF(1, 1), qreal startAngle = -PI() / 4);
+
+    void tick();// Makes one move, either the AI's or the manual one
+    int getTickCount() const { return tickCount; }
+    qreal coverage() const;// The discovered part of the field, from 0 to 1
+    // Nothing reachable is left to discover, the AI stands still and the ticks cost nothing. Checked when the AI looks for
+    // a new target, so it's noticed a tick after the last target was reached. Changing the control, the planner or the radius starts it again.
+    bool isComplete() const { return state == CompleteState; }
+
+    // A compact snapshot of the run(see SnapshotFormat.h) to continue it later or to fork several runs from it.
+    // Restoring only works on an engine for the same map, otherwise(or if the snapshot is broken) it returns false and changes nothing.
+    // The walls edited since the start and the robot radius are restored too.
+    QByteArray saveSnapshot() const;
+    bool restoreSnapshot(const QByteArray &snapshot);
+    void setSeed(quint64 seed);// Restarts the random generator, the forks of a snapshot go different ways with different seeds
+
+    void setRecorder(TraceRecorder *);// Each tick is passed to the recorder, NULL stops it. The recorder isn't owned.
+
+    void setKeyPressed(int key, bool pressed);
+    void toggleManualControl();
+    QStringList plannerNames() const;
+    void setPlanner(int);
+    void setRobotRadius(qreal);// See World::setRobotRadius, the bot is moved out of the grown walls if it's inside
+    qreal getRobotRadius() const { return world.robotRadius; }
+
+    // The map edits, see World::addWall. They take effect at the next tick or commitWalls(). The bot keeps its path
+    // unless a changed wall crosses it. A trace being recorded gets the new walls too.
+    int addWall(const QVector<QPointF> &points) { return world.addWall(points); }
+    bool removeWall(int index) { return world.removeWall(index); }
+    bool moveWall(int index, const QPointF &offset) { return world.moveWall(index, offset); }
+    void setWalls(const QVector<QVector<QPointF> > &walls) { world.setWalls(walls); }
+    void commitWalls();
+
+    const World &getWorld() const { return world; }
+    const Planner *getPlanner() const { return planners.current(); }
+    int getPlannerIndex() const { return planners.index(); }
+    QPointF getPos() const { return curPos; }
+    qreal getAngle() const { return curAngle; }
+    qreal getFovDist() const { return Sensor::range(); }
+    qreal getFovAngle() const { return Sensor::angle(); }
+    const RangeScan &getScan() const { return scan; }// The lidar's last scan, empty for the cone sensors(see LidarSensor)
+    const QVector<QPointF> &getPath() const { return path; }
+    QPointF getTargetPos() const { return targetPos; }
+    int getState() const { return state; }
+    const PotentialGrid &getPotential() const { return potential; }
+
+private:
+    void makeAIMove();// Follows the path in the "path" variable
+    bool makeManualMove();// Tries to move and returns true if could. If couldn't, tries to rotate.
+
+    void handleKeys();
+
+    bool makeMoveByLine(const QPointF &a, const QPointF &b);// helper method for makeAIMove. Rotates while curAngle isn't equal to
+                                                            // Line(a, b).angle, then follows this line.
+    bool turnTowards(qreal angle);// Rotates by rotSpeed at most, returns true if the bot already faces angle(in [0, 2 * PI))
+    QPointF getAITarget() const;// Finds the point with the hightest potential.
+    QPointF getBestView(qreal *heading) const;// See NextBestViewTargets, heading is -1 if no view sees anything new
+    bool isPathBlocked() const;// An obstacle crosses the rest of the path
+    bool hasFrontier() const;// Some reachable discovered node borders an undiscovered pocket(see FreeSpaceLabels::bordersUnknown)
+    bool isReachable(int i, int j, int reach) const;// The node is in the free space component reach(see World::freeSpaceAt), -1 lets everything through
+
+    void discoverAround(const QPointF &p);// The 4 nodes around p
+    bool exploreMap();// Updates the "isExplored" variable. Returns true if finds a new point
+    bool exploreByOccupancy();// exploreMap for the sensors with occupancy(): the scan goes into World::occupancy, the nodes it's sure about are discovered
+    bool sees(const Sector &fov, const QPointF &p) const;// The node at p is seen this tick, by the sector or by the scan
+
+    void updatePotential();// Works on the leaves of World::discoveryTree, only the cells with unknown ones nearby need the full update
+    void updateCellPotential(int i, int j);
+    bool isPotentialComputed(int i, int j) const;// updateCellPotential only computes the discovered cells with 4 discovered neighbours
+
+    bool wallOnPathTo(const QPointF &a) const;// Returns true if there's a real wall on the line from curPoint to a, for the sensor
+    void addVisitsCount(const QPointF &p, qreal value = 20.0);//Adds visits count to the point and its neighbours(within Targets::affectionRadius()).
+
+
+    qreal moveSpeed, rotSpeed;// rotSpeed is in radians
+    QPointF curPos;
+    qreal curAngle;
+
+    enum Control
+    {
+        ManualContol,
+        AIControl
+    };
+    Control control;
+
+    enum ExplorationState
+    {
+        NoState,
+        FollowPathState,
+        PointExploreStateCW,// starts rotating and tries to stop with the given probality each moment(I consider it as a dirty hack, but don't see another sufficient method to handle it)
+        PointExploreStateCCW, //the same, but counter-clockwise
+        FaceViewState,// Turns to viewAngle at the next best view target
+        CompleteState// See isComplete
+    };
+    ExplorationState state;
+
+    PotentialGrid potential;// The potential heuristic is formed by the nearby located undiscovered point(they increase it) and by the nearby located points' visits(they decrease it).
+    VisitsGrid visits;// Not exactly the visits count, but comparatively to other points, it's the time the bot was close to the point.
+    World world;// The map and the discovered zone
+    int cellsx, cellsy;// The size of the grids
+    RangeSensor lidar;// Only scans for the sensors with beams
+    RangeScan scan;
+    OccupancyGrid::Observation observation;// Kept for its buffer
+    typename Policies::Planners planners;
+    QVector<QPointF> path;// Contains the path to targetPos
+
+    QPointF targetPos;// Program will follow the path to this point
+    qreal viewAngle;// The heading to face at targetPos, -1 to look around randomly
+
+    Random random;// All the AI's randomness goes through it
+
+    QHash<int, bool> pressedKeys;// This map contains the states of the keys, to support key combinations(e.g. to rotate and move simultaneously)
+
+    int tickCount;
+    int discoveredCount;// Number of the discovered grid nodes, to get the coverage fast
+
+    TraceRecorder *recorder;
+    QVector<QPoint> newCells;// Discovered during the current tick, only collected while recording
+    int pathEvents;// TraceFormat::DeltaFlags of the current tick
+};
+
+// The configurations are instantiated once in ExplorationEngine.cpp
+extern template class BasicExplorationEngine<DefaultPolicies>;
+extern template class BasicExplorationEngine<LeanPolicies>;
+extern template class BasicExplorationEngine<NextBestViewPolicies>;
+extern template class BasicExplorationEngine<LidarPolicies>;
+extern template class BasicExplorationEngine<OccupancyPolicies>;
+
+typedef BasicExplorationEngine<DefaultPolicies> ExplorationEngine;
+
+#endif //EXPLORATIONENGINE_H
@@ -0,0 +1,225 @@
+#include <QtGui>
+
+#include "FrameCapture.h"
+
+FrameCapture::FrameCapture():
+    y4m(false),
+    policy(BlockWhenFull),
+    capacity(16),
+    nextIndex(0),
+    written(0), skipped(0),
+    stopping(false),
+    nextToWrite(0)
+{
+}
+
+FrameCapture::~FrameCapture()
+{
+    stop();
+}
+
+bool FrameCapture::start(const QString &fileName, const QSize &frameSize, int fpsNum, int fpsDen, Policy policy_, int capacity_)
+{
+    stop();
+    size = frameSize;
+    policy = policy_;
+    capacity = qMax(capacity_, 1);
+    y4m = fileName.endsWith(".y4m", Qt::CaseInsensitive);
+    if (y4m)
+    {
+        file.setFileName(fileName);
+        if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate))
+            return false;
+        QByteArray header = QString("YUV4MPEG2 W%1 H%2 F%3:%4 Ip A1:1 C420jpeg\n")
+                            .arg(size.width()).arg(size.height()).arg(fpsNum).arg(fpsDen).toAscii();
+        if (file.write(header) != header.size())
+        {
+            file.close();
+            return false;
+        }
+    }
+    else
+    {
+        QFileInfo info(fileName);
+        pngPrefix = info.dir().filePath(info.completeBaseName());
+    }
+
+    queue.clear();
+    converted.clear();
+    nextIndex = 0;
+    nextToWrite = 0;
+    written = 0;
+    skipped = 0;
+    stopping = false;
+    failure.clear();
+    int threads = qMax(1, QThread::idealThreadCount() - 1);// One core is left for the simulation
+    for (int i = 0; i < threads; i++)
+    {
+        workers.append(new Worker(this));
+        workers.back()->start();
+    }
+    return true;
+}
+
+void FrameCapture::stop()
+{
+    if (!isActive())
+        return;
+    mutex.lock();
+    stopping = true;
+    notEmpty.wakeAll();
+    mutex.unlock();
+    for (int i = 0; i < workers.size(); i++)
+        workers[i]->wait();
+    qDeleteAll(workers);
+    workers.clear();
+    if (y4m)
+    {
+        if (!file.flush() && failure.isEmpty())// The buffered tail
+            failure = file.errorString();
+        file.close();
+    }
+}
+
+bool FrameCapture::push(const QImage &frame)
+{
+    QMutexLocker locker(&mutex);
+    if (!failure.isEmpty())
+        return false;
+    if (queue.size() >= capacity)
+    {
+        if (policy == SkipWhenFull)
+        {
+            skipped++;
+            return false;
+        }
+        while (queue.size() >= capacity && failure.isEmpty())
+            notFull.wait(&mutex);
+        if (!failure.isEmpty())
+            return false;
+    }
+    queue.enqueue(qMakePair(nextIndex++, frame));// QImage is shared, nothing is copied until the caller draws on it again
+    notEmpty.wakeOne();
+    return true;
+}
+
+int FrameCapture::framesWritten() const
+{
+    QMutexLocker locker(&mutex);
+    return written;
+}
+
+int FrameCapture::framesSkipped() const
+{
+    QMutexLocker locker(&mutex);
+    return skipped;
+}
+
+QString FrameCapture::error() const
+{
+    QMutexLocker locker(&mutex);
+    return failure;
+}
+
+void FrameCapture::fail(const QString &reason)
+{
+    QMutexLocker locker(&mutex);
+    if (failure.isEmpty())
+        failure = reason;
+    queue.clear();
+    notFull.wakeAll();// The pushers waiting for room give up
+}
+
+void FrameCapture::work()
+{
+    while (true)
+    {
+        mutex.lock();
+        while (queue.isEmpty() && !stopping)
+            notEmpty.wait(&mutex);
+        if (queue.isEmpty() && stopping)
+        {
+            mutex.unlock();
+            break;
+        }
+        QPair<int, QImage> frame = queue.dequeue();
+        notFull.wakeOne();
+        mutex.unlock();
+
+        QImage image = frame.second;
+        if (image.size() != size)
+            image = image.scaled(size);
+        if (y4m)
+        {
+            writeInOrder(frame.first, toY4MFrame(image));// Counts it when it's its turn
+            continue;
+        }
+        QString name = QString("%1_%2.png").arg(pngPrefix).arg(frame.first, 6, 10, QChar('0'));
+        if (!image.save(name, "PNG"))
+        {
+            fail("Couldn't write " + name);
+            continue;
+        }
+        mutex.lock();
+        written++;
+        mutex.unlock();
+    }
+}
+
+QByteArray FrameCapture::toY4MFrame(const QImage &frame) const
+{
+    QImage image = frame.convertToFormat(QImage::Format_RGB32);
+    int w = size.width(), h = size.height();
+    int cw = (w + 1) / 2, ch = (h + 1) / 2;
+    QByteArray out("FRAME\n");
+    int header = out.size();
+    out.resize(header + w * h + 2 * cw * ch);
+    uchar *y = reinterpret_cast<uchar *>(out.data()) + header;
+    uchar *u = y + w * h, *v = u + cw * ch;
+
+    // Fixed point with 16 fractional bits
+    for (int j = 0; j < h; j++)
+    {
+        const QRgb *line = reinterpret_cast<const QRgb *>(image.constScanLine(j));
+        for (int i = 0; i < w; i++)
+            y[j * w + i] = (19595 * qRed(line[i]) + 38470 * qGreen(line[i]) + 7471 * qBlue(line[i]) + 32768) >> 16;
+    }
+    for (int j = 0; j < ch; j++)
+    {
+        const QRgb *line0 = reinterpret_cast<const QRgb *>(image.constScanLine(2 * j));
+        const QRgb *line1 = reinterpret_cast<const QRgb *>(image.constScanLine(qMin(2 * j + 1, h - 1)));
+        for (int i = 0; i < cw; i++)
+        {
+            int i1 = qMin(2 * i + 1, w - 1);
+            int r = qRed(line0[2 * i]) + qRed(line0[i1]) + qRed(line1[2 * i]) + qRed(line1[i1]);
+            int g = qGreen(line0[2 * i]) + qGreen(line0[i1]) + qGreen(line1[2 * i]) + qGreen(line1[i1]);
+            int b = qBlue(line0[2 * i]) + qBlue(line0[i1]) + qBlue(line1[2 * i]) + qBlue(line1[i1]);
+            // The sums of 4 pixels, hence 18 bits. 128 << 18 moves the chroma to the middle.
+            u[j * cw + i] = qBound(0, (-11059 * r - 21709 * g + 32768 * b + (128 << 18) + (1 << 17)) >> 18, 255);
+            v[j * cw + i] = qBound(0, (32768 * r - 27439 * g - 5329 * b + (128 << 18) + (1 << 17)) >> 18, 255);
+        }
+    }
+    return out;
+}
+
+void FrameCapture::writeInOrder(int index, const QByteArray &data)
+{
+    QMutexLocker locker(&writeMutex);
+    if (!error().isEmpty())
+        return;// The frames after a failed one would leave a gap in the stream
+    converted.insert(index, data);
+    while (converted.contains(nextToWrite))
+    {
+        QByteArray frame = converted.take(nextToWrite);
+        nextToWrite++;
+        if (file.write(frame) != frame.size())
+        {
+            converted.clear();
+            fail(file.errorString());
+            return;
+        }
+        mutex.lock();
+        written++;
+        mutex.unlock();
+    }
+}
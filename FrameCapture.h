@@ -0,0 +1,70 @@
+#ifndef FRAMECAPTURE_H
+#define FRAMECAPTURE_H
+
+#include <QtGui>
+
+// Writes the rendered frames out as a video: a raw Y4M stream or a sequence of PNGs.
+// The frames wait in a bounded queue, a pool of encoder threads takes them from there, so the simulation only waits
+// for the encoders if the queue is full and the policy says so. The Y4M frames are converted in parallel and written in order.
+class FrameCapture
+{
+public:
+    enum Policy
+    {
+        BlockWhenFull,// Back-pressure: push() waits for the encoders, no frame is lost
+        SkipWhenFull// push() drops the frame, the caller never waits
+    };
+
+    FrameCapture();
+    ~FrameCapture();// Stops and writes out everything queued
+
+    // A fileName ending with .y4m gets the stream, otherwise the frames go to fileName_000000.png, fileName_000001.png...(without the extension).
+    // The frame rate is fpsNum / fpsDen, only the Y4M header has it.
+    bool start(const QString &fileName, const QSize &frameSize, int fpsNum, int fpsDen, Policy policy_, int capacity_ = 16);
+    void stop();
+    bool isActive() const { return !workers.isEmpty(); }
+
+    bool push(const QImage &frame);// Returns false if the frame was skipped or the capture has failed
+    int framesWritten() const;// Counted once they are in the file
+    int framesSkipped() const;
+    QString error() const;// Why a frame couldn't be written, empty if all of them were. The capture takes no more frames then.
+
+private:
+    class Worker: public QThread
+    {
+    public:
+        Worker(FrameCapture *capture_): capture(capture_) {}
+
+    private:
+        void run() { capture->work(); }
+
+        FrameCapture *capture;
+    };
+
+    void work();// The workers' loop
+    QByteArray toY4MFrame(const QImage &frame) const;// Full range BT.601 4:2:0, as C420jpeg means
+    void writeInOrder(int index, const QByteArray &data);
+    void fail(const QString &reason);// Drops the queued frames, the first reason is kept
+
+    bool y4m;
+    QString pngPrefix;
+    QFile file;
+    QSize size;
+    Policy policy;
+    int capacity;
+    QList<Worker *> workers;
+
+    mutable QMutex mutex;// For the queue and the counters
+    QWaitCondition notEmpty, notFull;
+    QQueue<QPair<int, QImage> > queue;// Frames with their numbers
+    int nextIndex;
+    int written, skipped;
+    bool stopping;
+    QString failure;
+
+    QMutex writeMutex;// For the Y4M file
+    QMap<int, QByteArray> converted;// The frames converted ahead of their turn
+    int nextToWrite;
+};
+
+#endif //FRAMECAPTURE_H
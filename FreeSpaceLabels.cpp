@@ -0,0 +1,212 @@
+#include <QtGui>
+
+#include <algorithm>
+
+#include "FreeSpaceLabels.h"
+#include "DistanceField.h"
+#include "Arena.h"
+
+namespace
+{
+
+// All 8 neighbours, a direction and its opposite are 4 apart
+const int dirCount = 8;
+const int dirx[] = {1, 1, 0, -1, -1, -1, 0, 1};
+const int diry[] = {0, 1, 1, 1, 0, -1, -1, -1};
+
+}
+
+FreeSpaceLabels::FreeSpaceLabels():
+    cellsx(0), cellsy(0)
+{
+}
+
+void FreeSpaceLabels::build(const QVector<QVector<bool> > &grid, const DistanceField &walls, qreal cellSize)
+{
+    cellsx = grid.size();
+    cellsy = grid[0].size();
+    links = QVector<quint8>(cellsx * cellsy, 0);
+    link(walls, cellSize, QRect(0, 0, cellsx, cellsy));
+    relabel(grid);
+}
+
+void FreeSpaceLabels::store(PrecomputeCache::Writer *out, const QByteArray &name) const
+{
+    out->add(name + ".links", links);
+}
+
+bool FreeSpaceLabels::restore(const PrecomputeCache::Reader &in, const QByteArray &name, const QVector<QVector<bool> > &grid)
+{
+    QVector<quint8> saved;
+    if (!in.read(name + ".links", &saved) || saved.size() != grid.size() * grid[0].size())
+        return false;
+    cellsx = grid.size();
+    cellsy = grid[0].size();
+    links = saved;
+    relabel(grid);
+    return true;
+}
+
+void FreeSpaceLabels::rebuild(const QVector<QVector<bool> > &grid, const DistanceField &walls, qreal cellSize, const QRect &nodes)
+{
+    link(walls, cellSize, nodes);
+    relabel(grid);
+}
+
+void FreeSpaceLabels::link(const DistanceField &walls, qreal cellSize, const QRect &nodes)
+{
+    QRect around = nodes.adjusted(-1, -1, 1, 1) & QRect(0, 0, cellsx, cellsy);// The links from the outside come in too
+    for (int i = around.left(); i <= around.right(); i++)
+    {
+        for (int j = around.top(); j <= around.bottom(); j++)
+        {
+            // No wall is as close as the diagonal neighbour, the distance may be overestimated by errorBound()
+            bool open = walls.distance(cellSize * QPointF(i, j)) - walls.errorBound() > 1.5 * cellSize;
+            for (int d = 0; d < dirCount / 2; d++)// The other half is set from the neighbours' side
+            {
+                int ni = i + dirx[d], nj = j + diry[d];
+                if (ni < 0 || ni >= cellsx || nj < 0 || nj >= cellsy)
+                    continue;
+                if (!nodes.contains(i, j) && !nodes.contains(ni, nj))
+                    continue;
+                links[i * cellsy + j] &= ~(1 << d);
+                links[ni * cellsy + nj] &= ~(1 << (d + dirCount / 2));
+                if (open || !walls.hit(cellSize * QPointF(i, j), cellSize * QPointF(ni, nj)))
+                {
+                    links[i * cellsy + j] |= 1 << d;
+                    links[ni * cellsy + nj] |= 1 << (d + dirCount / 2);
+                }
+            }
+        }
+    }
+}
+
+void FreeSpaceLabels::relabel(const QVector<QVector<bool> > &grid)
+{
+    parent = QVector<int>(cellsx * cellsy, -1);
+    rank = QVector<int>(cellsx * cellsy, 0);
+    frontier.clear();
+    frontierIndex = QVector<int>(cellsx * cellsy, -1);
+    for (int i = 0; i < cellsx; i++)
+    {
+        for (int j = 0; j < cellsy; j++)
+        {
+            if (grid[i][j])
+                add(i, j);
+        }
+    }
+}
+
+void FreeSpaceLabels::add(int i, int j)
+{
+    int k = i * cellsy + j;
+    if (parent[k] != -1)
+        return;
+    parent[k] = k;
+    for (int d = 0; d < dirCount; d++)
+    {
+        if (!(links[k] & (1 << d)))
+            continue;
+        int ni = i + dirx[d], nj = j + diry[d];
+        if (parent[ni * cellsy + nj] != -1)
+        {
+            unite(k, ni * cellsy + nj);
+            updateFrontier(ni * cellsy + nj);// It may have lost its last unknown neighbour
+        }
+    }
+    updateFrontier(k);
+}
+
+void FreeSpaceLabels::updateFrontier(int k)
+{
+    bool borders = false;
+    for (int d = 0; d < dirCount && !borders; d++)
+        borders = (links[k] & (1 << d)) && parent[k + dirx[d] * cellsy + diry[d]] == -1;
+    if (borders && frontierIndex[k] == -1)
+    {
+        frontierIndex[k] = frontier.size();
+        frontier.append(k);
+    }
+    else if (!borders && frontierIndex[k] != -1)
+    {
+        int last = frontier.last();
+        frontier[frontierIndex[k]] = last;
+        frontierIndex[last] = frontierIndex[k];
+        frontier.resize(frontier.size() - 1);
+        frontierIndex[k] = -1;
+    }
+}
+
+int FreeSpaceLabels::label(int i, int j) const
+{
+    int k = i * cellsy + j;
+    return parent[k] == -1 ? -1 : find(k);
+}
+
+bool FreeSpaceLabels::bordersUnknown(int i, int j, int minNodes) const
+{
+    int k = i * cellsy + j;
+    if (parent[k] == -1)
+        return false;
+    ArenaScope scope;// The calls one after another reuse the same memory
+    ArenaVector<int> pocket;// Hardly more than minNodes of them are collected, a linear search is enough
+    for (int d = 0; d < dirCount; d++)
+    {
+        if ((links[k] & (1 << d)) && parent[k + dirx[d] * cellsy + diry[d]] == -1)
+            pocket.push_back(k + dirx[d] * cellsy + diry[d]);
+    }
+    for (int n = 0; n < int(pocket.size()) && int(pocket.size()) < minNodes; n++)
+    {
+        int cur = pocket[n];
+        for (int d = 0; d < dirCount; d++)
+        {
+            int next = cur + dirx[d] * cellsy + diry[d];
+            if ((links[cur] & (1 << d)) && parent[next] == -1 && std::find(pocket.begin(), pocket.end(), next) == pocket.end())
+                pocket.push_back(next);
+        }
+    }
+    return int(pocket.size()) >= minNodes;
+}
+
+bool FreeSpaceLabels::hasFrontier(int reach, int minNodes) const
+{
+    for (int n = 0; n < frontier.size(); n++)
+    {
+        int k = frontier[n];
+        if ((reach == -1 || find(k) == reach) && bordersUnknown(k / cellsy, k % cellsy, minNodes))
+            return true;
+    }
+    return false;
+}
+
+int FreeSpaceLabels::find(int k) const
+{
+    while (parent[k] != k)
+        k = parent[k];
+    return k;
+}
+
+void FreeSpaceLabels::unite(int a, int b)
+{
+    // The paths are compressed here, so label(...) doesn't write and the trees stay flat
+    int ra = find(a), rb = find(b);
+    for (int k = a; k != ra; )
+    {
+        int next = parent[k];
+        parent[k] = ra;
+        k = next;
+    }
+    for (int k = b; k != rb; )
+    {
+        int next = parent[k];
+        parent[k] = rb;
+        k = next;
+    }
+    if (ra == rb)
+        return;
+    if (rank[ra] < rank[rb])
+        qSwap(ra, rb);
+    parent[rb] = ra;
+    if (rank[ra] == rank[rb])
+        rank[ra]++;
+}
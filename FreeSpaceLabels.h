@@ -0,0 +1,50 @@
+#ifndef FREESPACELABELS_H
+#define FREESPACELABELS_H
+
+#include <QtGui>
+
+#include "PrecomputeCache.h"
+
+class DistanceField;
+
+// The connected components of the discovered grid nodes. Two neighbouring nodes(diagonals too) are connected
+// if both are discovered and no map wall crosses the segment between them, those links are found once in build(...).
+// The undiscovered pockets too small for the virtual walls are joined in too(see World::updateVirtualWalls), the planners
+// go through them. The components are a union-find grown as the nodes are added, so the exploration pays O(1) per new node
+// and the targets in another component are rejected without a path search. The frontier(the added nodes linked
+// to an unknown one) is kept up to date the same way, so it's never looked for over the whole grid.
+class FreeSpaceLabels
+{
+public:
+    FreeSpaceLabels();
+
+    void build(const QVector<QVector<bool> > &grid, const DistanceField &walls, qreal cellSize);
+    void relabel(const QVector<QVector<bool> > &grid);// After the grid was written directly, the links stay
+    void rebuild(const QVector<QVector<bool> > &grid, const DistanceField &walls, qreal cellSize, const QRect &nodes);// After the walls through the nodes changed
+    void add(int i, int j);// The node (i, j) was discovered or is in a pocket the planners go through
+    void store(PrecomputeCache::Writer *out, const QByteArray &name) const;// The links, the components are made again from the grid
+    bool restore(const PrecomputeCache::Reader &in, const QByteArray &name, const QVector<QVector<bool> > &grid);
+
+    // The same number for the nodes of one component, -1 for the unknown ones. Only reads, so it's safe from many threads.
+    int label(int i, int j) const;
+    // A discovered node from which at least minNodes unknown ones can be reached through the unknown nodes only,
+    // the exploration can go on from it. The smaller pockets are slivers along the walls the sensor hardly ever sees.
+    bool bordersUnknown(int i, int j, int minNodes) const;
+    // Some frontier node of the component reach(any for -1) borders a pocket of minNodes at least, see bordersUnknown(...)
+    bool hasFrontier(int reach, int minNodes) const;
+
+private:
+    void link(const DistanceField &walls, qreal cellSize, const QRect &nodes);// The links with an end in nodes
+    int find(int k) const;
+    void unite(int a, int b);
+    void updateFrontier(int k);// Adds the node to the frontier or drops it from there
+
+    int cellsx, cellsy;
+    QVector<quint8> links;// By node(i * cellsy + j), a bit for each clear direction, see directions in the .cpp
+    QVector<int> parent;// -1 for the unknown nodes
+    QVector<int> rank;
+    QVector<int> frontier;// The nodes, in no particular order
+    QVector<int> frontierIndex;// By node, its place in frontier, -1 if it's not there
+};
+
+#endif //FREESPACELABELS_H
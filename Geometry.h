@@ -0,0 +1,113 @@
+#ifndef GEOMETRY_H
+#define GEOMETRY_H
+
+#include <QtGlobal>
+#include <QPointF>
+#include <cmath>
+
+// Small header-only geometry for the hot paths. Everything is inline, the predicates use dot and cross products only,
+// no angles and no trigonometry. Angles, where still needed, follow the screen convention of QLineF:
+// counter-clockwise with the y axis pointing down, but in radians.
+
+constexpr qreal PI() { return 3.14159265358979323846; }
+
+struct Vec2
+{
+    qreal x, y;
+
+    constexpr Vec2(): x(0.0), y(0.0) {}
+    constexpr Vec2(qreal x_, qreal y_): x(x_), y(y_) {}
+    Vec2(const QPointF &p): x(p.x()), y(p.y()) {}
+    QPointF toPointF() const { return QPointF(x, y); }
+
+    constexpr Vec2 operator+(const Vec2 &v) const { return Vec2(x + v.x, y + v.y); }
+    constexpr Vec2 operator-(const Vec2 &v) const { return Vec2(x - v.x, y - v.y); }
+    constexpr Vec2 operator-() const { return Vec2(-x, -y); }
+    constexpr Vec2 operator*(qreal k) const { return Vec2(x * k, y * k); }
+    constexpr Vec2 operator/(qreal k) const { return Vec2(x / k, y / k); }
+    constexpr bool operator==(const Vec2 &v) const { return x == v.x && y == v.y; }
+    constexpr bool operator!=(const Vec2 &v) const { return !(*this == v); }
+
+    constexpr qreal dot(const Vec2 &v) const { return x * v.x + y * v.y; }
+    constexpr qreal cross(const Vec2 &v) const { return x * v.y - y * v.x; }// z-coordinate of the 3d cross product, its sign tells the turn direction
+    constexpr qreal lengthSquared() const { return x * x + y * y; }
+    qreal length() const { return std::sqrt(lengthSquared()); }
+    Vec2 normalized() const { qreal len = length(); return len > 0 ? *this / len : *this; }
+
+    static Vec2 fromAngle(qreal angle) { return Vec2(std::cos(angle), -std::sin(angle)); }// The unit vector, like QLineF::fromPolar
+    qreal angle() const// In [0, 2 * PI), like QLineF::angle
+    {
+        qreal a = std::atan2(-y, x);
+        return a < 0 ? a + 2 * PI() : a;
+    }
+    // Grows with the angle from d to this vector(angle() - d.angle() in [0, 2 * PI)), but is in [0, 4) and needs
+    // no trigonometry, a quarter turn is 1. Undefined for the zero vectors.
+    qreal pseudoAngleFrom(const Vec2 &d) const
+    {
+        qreal px = dot(d), py = cross(d);
+        if (py >= 0)
+            return px >= 0 ? py / (px + py) : 1 + px / (px - py);
+        return px < 0 ? 2 + py / (px + py) : 3 + px / (px - py);
+    }
+};
+
+constexpr Vec2 operator*(qreal k, const Vec2 &v) { return v * k; }
+
+constexpr qreal orientation(const Vec2 &a, const Vec2 &b, const Vec2 &c)// > 0 if a, b, c make a counter-clockwise turn in the math coordinates
+{
+    return (b - a).cross(c - a);
+}
+
+struct Segment
+{
+    Vec2 a, b;
+
+    constexpr Segment() {}
+    constexpr Segment(const Vec2 &a_, const Vec2 &b_): a(a_), b(b_) {}
+
+    // The same as QLineF::intersect(...) == QLineF::BoundedIntersection: touching counts, parallel segments never intersect.
+    bool intersects(const Segment &s) const
+    {
+        Vec2 d1 = b - a, d2 = s.b - s.a;
+        if (d1.cross(d2) == 0)
+            return false;
+        qreal o1 = orientation(a, b, s.a), o2 = orientation(a, b, s.b);
+        if ((o1 > 0 && o2 > 0) || (o1 < 0 && o2 < 0))
+            return false;
+        qreal o3 = orientation(s.a, s.b, a), o4 = orientation(s.a, s.b, b);
+        return !((o3 > 0 && o4 > 0) || (o3 < 0 && o4 < 0));
+    }
+
+    bool sharesEndWith(const Segment &s) const
+    {
+        return a == s.a || a == s.b || b == s.a || b == s.b;
+    }
+
+    constexpr bool operator==(const Segment &s) const { return a == s.a && b == s.b; }
+};
+
+// A circle sector, set up once and then tested against many points without trigonometry.
+struct Sector
+{
+    Vec2 centre, dir;
+    qreal radiusSquared, cosHalf;
+
+    Sector(const Vec2 &centre_, qreal radius, qreal dirAngle, qreal spanAngle):
+        centre(centre_), dir(Vec2::fromAngle(dirAngle)), radiusSquared(radius * radius), cosHalf(std::cos(spanAngle / 2))
+    {
+    }
+
+    bool contains(const Vec2 &p) const
+    {
+        Vec2 v = p - centre;
+        qreal lenSq = v.lengthSquared();
+        if (lenSq >= radiusSquared)
+            return false;
+        qreal proj = v.dot(dir);// |v| * cos(the angle between v and dir), compared with |v| * cosHalf without the square root
+        if (cosHalf >= 0)
+            return proj >= 0 && proj * proj >= lenSq * cosHalf * cosHalf;
+        return proj >= 0 || proj * proj <= lenSq * cosHalf * cosHalf;
+    }
+};
+
+#endif //GEOMETRY_H
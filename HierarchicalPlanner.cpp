@@ -0,0 +1,467 @@
+#include <QtGui>
+
+#include <queue>
+#include <vector>
+#include <functional>
+#include <algorithm>
+#include <limits>
+
+#include "HierarchicalPlanner.h"
+#include "tools.h"
+
+namespace
+{
+
+const int maxSingleEntrance = 6;// Longer entrances get a transition at each end instead of one in the middle
+const qreal diagonal = 1.41421356237309504880;
+
+}
+
+HierarchicalPlanner::HierarchicalPlanner(const World &world_):
+    Planner(world_),
+    cellsx(world.isDiscovered.size()), cellsy(world.isDiscovered[0].size()),
+    clusterSize(16),
+    clustersx((cellsx + clusterSize - 1) / clusterSize), clustersy((cellsy + clusterSize - 1) / clusterSize),
+    builtWalls(world.wallSquares), builtWallsRevision(world.wallsRevision),
+    lastExpanded(0), lastRebuilt(0)
+{
+    clusters.resize(clustersx * clustersy);
+    for (int cx = 0; cx < clustersx; cx++)
+    {
+        for (int cy = 0; cy < clustersy; cy++)
+        {
+            Cluster &c = clusters[cx * clustersy + cy];
+            c.x0 = cx * clusterSize;
+            c.y0 = cy * clusterSize;
+            c.x1 = qMin(cellsx, c.x0 + clusterSize) - 1;
+            c.y1 = qMin(cellsy, c.y0 + clusterSize) - 1;
+            c.discovered = -1;
+        }
+    }
+    borders.resize(2 * clusters.size());
+    abstractNodeOf.fill(-1, cellsx * cellsy);
+}
+
+QString HierarchicalPlanner::name() const
+{
+    return "HPA*";
+}
+
+QString HierarchicalPlanner::lastQueryStats() const
+{
+    return QString("%1 abstract nodes, %2 expanded, %3 clusters rebuilt").arg(nodes.size()).arg(lastExpanded).arg(lastRebuilt);
+}
+
+int HierarchicalPlanner::clusterOf(int node) const
+{
+    return (node / cellsy / clusterSize) * clustersy + (node % cellsy) / clusterSize;
+}
+
+QPointF HierarchicalPlanner::queryPos(int node, int start, int goal) const
+{
+    if (node == start)
+        return queryStart;
+    if (node == goal)
+        return queryTarget;
+    return world.cellSize * QPointF(node / cellsy, node % cellsy);
+}
+
+bool HierarchicalPlanner::isPassable(int node, int start, int goal) const
+{
+    return node == start || node == goal || world.isFreeNode(node / cellsy, node % cellsy);
+}
+
+void HierarchicalPlanner::updateBorder(int border) const
+{
+    QVector<QPair<int, int> > &transitions = borders[border];
+    transitions.clear();
+    const Cluster &c = clusters[border / 2];
+    bool right = border % 2 == 0;
+    if ((right && c.x1 + 1 >= cellsx) || (!right && c.y1 + 1 >= cellsy))
+        return;
+
+    int len = right ? c.y1 - c.y0 + 1 : c.x1 - c.x0 + 1;
+    int runStart = -1;
+    for (int k = 0; k <= len; k++)
+    {
+        int i = right ? c.x1 : c.x0 + k, j = right ? c.y0 + k : c.y1;
+        int ni = right ? i + 1 : i, nj = right ? j : j + 1;
+        bool open = k < len && world.isFreeNode(i, j) && world.isFreeNode(ni, nj);
+        if (open && runStart == -1)
+            runStart = k;
+        if (!open && runStart != -1)
+        {
+            int ends[2] = {runStart, k - 1};
+            if (k - runStart < maxSingleEntrance)
+                ends[0] = ends[1] = (runStart + k - 1) / 2;
+            for (int e = 0; e < (ends[0] == ends[1] ? 1 : 2); e++)
+            {
+                int ti = right ? c.x1 : c.x0 + ends[e], tj = right ? c.y0 + ends[e] : c.y1;
+                transitions.append(qMakePair(ti * cellsy + tj, right ? (ti + 1) * cellsy + tj : ti * cellsy + tj + 1));
+            }
+            runStart = -1;
+        }
+    }
+}
+
+void HierarchicalPlanner::updateEntrances(int cluster) const
+{
+    Cluster &c = clusters[cluster];
+    int cx = cluster / clustersy, cy = cluster % clustersy;
+    c.entrances.clear();
+    for (int t = 0; t < borders[2 * cluster].size(); t++)
+        c.entrances.append(borders[2 * cluster][t].first);
+    for (int t = 0; t < borders[2 * cluster + 1].size(); t++)
+        c.entrances.append(borders[2 * cluster + 1][t].first);
+    if (cx > 0)
+    {
+        const QVector<QPair<int, int> > &left = borders[2 * (cluster - clustersy)];
+        for (int t = 0; t < left.size(); t++)
+            c.entrances.append(left[t].second);
+    }
+    if (cy > 0)
+    {
+        const QVector<QPair<int, int> > &top = borders[2 * (cluster - 1) + 1];
+        for (int t = 0; t < top.size(); t++)
+            c.entrances.append(top[t].second);
+    }
+    std::sort(c.entrances.begin(), c.entrances.end());// A corner node may be an entrance of two borders
+    c.entrances.erase(std::unique(c.entrances.begin(), c.entrances.end()), c.entrances.end());
+
+    int n = c.entrances.size();
+    c.distances.fill(std::numeric_limits<qreal>::max(), n * n);
+    ArenaScope scope;
+    ArenaVector<qreal> dist;
+    ArenaVector<int> parent;
+    for (int a = 0; a < n; a++)
+    {
+        searchCluster(cluster, c.entrances[a], -1, -1, &dist, &parent);
+        for (int b = 0; b < n; b++)
+            c.distances[a * n + b] = dist[localIndex(cluster, c.entrances[b])];
+    }
+}
+
+bool HierarchicalPlanner::wallsChangedIn(const Cluster &c) const
+{
+    for (int i = c.x0; i <= c.x1; i++)
+    {
+        for (int j = c.y0; j <= c.y1; j++)
+        {
+            if (builtWalls[i][j] != world.wallSquares[i][j])
+                return true;
+        }
+    }
+    return false;
+}
+
+void HierarchicalPlanner::refresh() const
+{
+    lastRebuilt = 0;
+    QVector<bool> changed(clusters.size(), false);
+    bool newWalls = builtWallsRevision != world.wallsRevision;// Only then the squares are compared
+    for (int k = 0; k < clusters.size(); k++)
+    {
+        Cluster &c = clusters[k];
+        int discovered = world.discoveryTree.discoveredIn(QRect(c.x0, c.y0, c.x1 - c.x0 + 1, c.y1 - c.y0 + 1));
+        if (discovered != c.discovered || (newWalls && wallsChangedIn(c)))
+        {
+            c.discovered = discovered;
+            changed[k] = true;
+        }
+    }
+    if (newWalls)
+    {
+        builtWalls = world.wallSquares;
+        builtWallsRevision = world.wallsRevision;
+    }
+
+    QVector<bool> rebuild(clusters.size(), false);// The changed clusters and their neighbours, their borders have changed
+    for (int k = 0; k < clusters.size(); k++)
+    {
+        if (!changed[k])
+            continue;
+        int cx = k / clustersy, cy = k % clustersy;
+        updateBorder(2 * k);
+        updateBorder(2 * k + 1);
+        if (cx > 0)
+            updateBorder(2 * (k - clustersy));
+        if (cy > 0)
+            updateBorder(2 * (k - 1) + 1);
+        rebuild[k] = true;
+        if (cx > 0)
+            rebuild[k - clustersy] = true;
+        if (cx + 1 < clustersx)
+            rebuild[k + clustersy] = true;
+        if (cy > 0)
+            rebuild[k - 1] = true;
+        if (cy + 1 < clustersy)
+            rebuild[k + 1] = true;
+    }
+    for (int k = 0; k < clusters.size(); k++)
+    {
+        if (rebuild[k])
+        {
+            updateEntrances(k);
+            lastRebuilt++;
+        }
+    }
+    if (lastRebuilt > 0)
+        rebuildAbstractGraph();
+}
+
+void HierarchicalPlanner::rebuildAbstractGraph() const
+{
+    for (int i = 0; i < nodes.size(); i++)
+        abstractNodeOf[nodes[i].node] = -1;
+    nodes.clear();
+    for (int k = 0; k < clusters.size(); k++)
+    {
+        const Cluster &c = clusters[k];
+        int first = nodes.size(), n = c.entrances.size();
+        for (int a = 0; a < n; a++)
+        {
+            AbstractNode an;
+            an.node = c.entrances[a];
+            an.cluster = k;
+            abstractNodeOf[an.node] = nodes.size();
+            nodes.append(an);
+        }
+        for (int a = 0; a < n; a++)
+        {
+            for (int b = 0; b < n; b++)
+            {
+                if (a != b && c.distances[a * n + b] < std::numeric_limits<qreal>::max())
+                    nodes[first + a].edges.append(qMakePair(first + b, c.distances[a * n + b]));
+            }
+        }
+    }
+    for (int b = 0; b < borders.size(); b++)
+    {
+        for (int t = 0; t < borders[b].size(); t++)
+        {
+            int u = abstractNodeOf[borders[b][t].first], v = abstractNodeOf[borders[b][t].second];
+            nodes[u].edges.append(qMakePair(v, world.cellSize));
+            nodes[v].edges.append(qMakePair(u, world.cellSize));
+        }
+    }
+}
+
+int HierarchicalPlanner::localIndex(int cluster, int node) const
+{
+    const Cluster &c = clusters[cluster];
+    return (node / cellsy - c.x0) * (c.y1 - c.y0 + 1) + node % cellsy - c.y0;
+}
+
+void HierarchicalPlanner::searchCluster(int cluster, int source, int start, int goal, ArenaVector<qreal> *dist, ArenaVector<int> *parent) const
+{
+    const Cluster &c = clusters[cluster];
+    int h = c.y1 - c.y0 + 1;
+    qreal inf = std::numeric_limits<qreal>::max();
+    dist->assign((c.x1 - c.x0 + 1) * h, inf);
+    parent->assign(dist->size(), -1);
+    ArenaVector<qreal> &d = *dist;
+
+    typedef QPair<qreal, int> Entry;// (distance, local index)
+    std::priority_queue<Entry, ArenaVector<Entry>, std::greater<Entry> > open;
+    d[localIndex(cluster, source)] = 0.0;
+    open.push(qMakePair(0.0, localIndex(cluster, source)));
+    while (!open.empty())
+    {
+        Entry top = open.top();
+        open.pop();
+        int s = top.second;
+        if (top.first > d[s])
+            continue;// An outdated entry
+        int x = c.x0 + s / h, y = c.y0 + s % h;
+        for (int dx = -1; dx <= 1; dx++)
+        {
+            for (int dy = -1; dy <= 1; dy++)
+            {
+                int nx = x + dx, ny = y + dy;
+                if ((dx == 0 && dy == 0) || nx < c.x0 || nx > c.x1 || ny < c.y0 || ny > c.y1)
+                    continue;
+                if (!isPassable(nx * cellsy + ny, start, goal))
+                    continue;
+                int sNode = x * cellsy + y, nNode = nx * cellsy + ny;
+                if (sNode == start || sNode == goal || nNode == start || nNode == goal)
+                {
+                    if (!world.gridLineOfSight(queryPos(sNode, start, goal), queryPos(nNode, start, goal)))
+                        continue;// The query ends may be close to the walls, their edges are checked precisely
+                }
+                else if (dx != 0 && dy != 0 && !(isPassable(x * cellsy + ny, start, goal) && isPassable(nx * cellsy + y, start, goal)))
+                {
+                    continue;// No cutting the corners
+                }
+                int n = (nx - c.x0) * h + ny - c.y0;
+                qreal nd = d[s] + (dx != 0 && dy != 0 ? diagonal : 1.0) * world.cellSize;
+                if (nd < d[n])
+                {
+                    d[n] = nd;
+                    (*parent)[n] = s;
+                    open.push(qMakePair(nd, n));
+                }
+            }
+        }
+    }
+}
+
+bool HierarchicalPlanner::appendRefinedPath(int cluster, int from, int to, int start, int goal, QVector<int> *path) const
+{
+    ArenaScope scope;
+    ArenaVector<qreal> dist;
+    ArenaVector<int> parent;
+    searchCluster(cluster, from, start, goal, &dist, &parent);
+    if (dist[localIndex(cluster, to)] == std::numeric_limits<qreal>::max())
+        return false;
+    const Cluster &c = clusters[cluster];
+    int h = c.y1 - c.y0 + 1;
+    int first = path->size();
+    for (int cur = localIndex(cluster, to), source = localIndex(cluster, from); cur != source && cur != -1; cur = parent[cur])
+        path->append((c.x0 + cur / h) * cellsy + c.y0 + cur % h);
+    std::reverse(path->begin() + first, path->end());
+    return true;
+}
+
+QVector<QPointF> HierarchicalPlanner::smoothPath(const QVector<QPointF> &path) const
+{
+    QVector<QPointF> ans;
+    if (path.isEmpty())
+        return ans;
+    ans.append(path[0]);
+    int anchor = 0;
+    for (int i = 2; i < path.size(); i++)
+    {
+        if (!world.gridLineOfSight(path[anchor], path[i]))
+        {
+            anchor = i - 1;
+            ans.append(path[anchor]);
+        }
+    }
+    if (path.size() > 1)
+        ans.append(path.back());
+    return ans;
+}
+
+QVector<QPointF> HierarchicalPlanner::getPath(const QPointF &startPos, const QPointF &targetPos) const
+{
+    lastExpanded = 0;
+    refresh();
+
+    QPoint sn = world.nodeAt(startPos), gn = world.nodeAt(targetPos);
+    if (sn.x() < 0 || sn.x() >= cellsx || sn.y() < 0 || sn.y() >= cellsy ||
+        gn.x() < 0 || gn.x() >= cellsx || gn.y() < 0 || gn.y() >= cellsy)
+    {
+        return QVector<QPointF>();
+    }
+    int start = sn.x() * cellsy + sn.y(), goal = gn.x() * cellsy + gn.y();
+    queryStart = startPos;
+    queryTarget = targetPos;
+    int startCluster = clusterOf(start), goalCluster = clusterOf(goal);
+
+    ArenaScope scope;// All the temporaries of the query are released at once
+    qreal inf = std::numeric_limits<qreal>::max();
+    QVector<int> cells;// The refined path over the grid nodes
+    cells.append(start);
+
+    ArenaVector<qreal> startDist, goalDist;
+    ArenaVector<int> startParent, goalParent;
+    searchCluster(startCluster, start, start, goal, &startDist, &startParent);
+    if (startCluster == goalCluster && startDist[localIndex(startCluster, goal)] < inf)
+    {
+        appendRefinedPath(startCluster, start, goal, start, goal, &cells);// Just checked
+    }
+    else
+    {
+        // A* over the abstract graph with two extra nodes: the start(n) and the goal(n + 1), connected to their clusters' entrances.
+        searchCluster(goalCluster, goal, start, goal, &goalDist, &goalParent);
+        int n = nodes.size(), startNode = n, goalNode = n + 1;
+        ArenaVector<qreal> g(n + 2, inf);
+        ArenaVector<int> parent(n + 2, -1);
+        ArenaVector<char> closed(n + 2, false);
+
+        QPointF goalPoint = world.cellSize * QPointF(gn);
+        typedef QPair<qreal, int> Entry;// (f, abstract node)
+        std::priority_queue<Entry, ArenaVector<Entry>, std::greater<Entry> > open;
+        g[startNode] = 0.0;
+        open.push(qMakePair(distance(startPos, targetPos), startNode));
+        bool found = false;
+        while (!open.empty())
+        {
+            int u = open.top().second;
+            open.pop();
+            if (closed[u])
+                continue;// An outdated entry
+            closed[u] = true;
+            lastExpanded++;
+            if (u == goalNode)
+            {
+                found = true;
+                break;
+            }
+
+            // Collecting u's edges: the abstract ones, plus the extra nodes'
+            ArenaVector<QPair<int, qreal> > edges;
+            if (u == startNode)
+            {
+                const QVector<int> &entrances = clusters[startCluster].entrances;
+                for (int e = 0; e < entrances.size(); e++)
+                {
+                    qreal d = startDist[localIndex(startCluster, entrances[e])];
+                    if (d < inf)
+                        edges.push_back(qMakePair(abstractNodeOf[entrances[e]], d));
+                }
+            }
+            else
+            {
+                edges.insert(edges.end(), nodes[u].edges.begin(), nodes[u].edges.end());
+                if (nodes[u].cluster == goalCluster && goalDist[localIndex(goalCluster, nodes[u].node)] < inf)
+                    edges.push_back(qMakePair(goalNode, goalDist[localIndex(goalCluster, nodes[u].node)]));
+            }
+
+            for (size_t e = 0; e < edges.size(); e++)
+            {
+                int v = edges[e].first;
+                qreal newg = g[u] + edges[e].second;
+                if (closed[v] || newg >= g[v])
+                    continue;
+                g[v] = newg;
+                parent[v] = u;
+                QPointF vPos = v == goalNode ? goalPoint : world.cellSize * QPointF(nodes[v].node / cellsy, nodes[v].node % cellsy);
+                open.push(qMakePair(newg + distance(vPos, goalPoint), v));
+            }
+        }
+        if (!found)
+            return QVector<QPointF>();
+
+        QVector<int> corridor;
+        for (int u = parent[goalNode]; u != startNode; u = parent[u])
+            corridor.append(u);
+        std::reverse(corridor.begin(), corridor.end());
+
+        // Refining: inside a cluster the grid path is searched, between the clusters the entrance nodes are neighbours.
+        // The abstract graph is refreshed above, a hop that isn't walkable any more gives no path rather than one through a wall.
+        bool walkable = appendRefinedPath(startCluster, start, nodes[corridor[0]].node, start, goal, &cells);
+        for (int i = 0; walkable && i + 1 < corridor.size(); i++)
+        {
+            const AbstractNode &a = nodes[corridor[i]], &b = nodes[corridor[i + 1]];
+            if (a.cluster == b.cluster)
+            {
+                walkable = appendRefinedPath(a.cluster, a.node, b.node, start, goal, &cells);
+            }
+            else
+            {
+                walkable = isPassable(a.node, start, goal) && isPassable(b.node, start, goal);
+                cells.append(b.node);
+            }
+        }
+        if (!walkable || !appendRefinedPath(goalCluster, nodes[corridor.back()].node, goal, start, goal, &cells))
+            return QVector<QPointF>();
+    }
+
+    QVector<QPointF> path;
+    path.append(startPos);
+    for (int i = 1; i + 1 < cells.size(); i++)
+        path.append(world.cellSize * QPointF(cells[i] / cellsy, cells[i] % cellsy));
+    path.append(targetPos);
+    return smoothPath(path);
+}
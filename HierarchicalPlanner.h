@@ -0,0 +1,74 @@
+#ifndef HIERARCHICALPLANNER_H
+#define HIERARCHICALPLANNER_H
+
+#include <QtGui>
+
+#include "Planner.h"
+#include "Arena.h"
+
+// HPA*: the grid of the World is split into square clusters. The free node pairs on the cluster borders form entrances,
+// and the distances between the entrances of a cluster are precomputed. A query searches this small abstract graph
+// and then refines only the clusters on the chosen corridor, the result is smoothed with the grid line of sight.
+// The discovered zone only grows, so a cluster is rebuilt lazily, on the next query after its discovered count changed.
+// The wall edits and the robot's radius change World::wallSquares, then the clusters whose squares differ from the ones
+// they were built for are rebuilt too.
+class HierarchicalPlanner: public Planner
+{
+public:
+    HierarchicalPlanner(const World &world_);
+
+    QString name() const;
+    QVector<QPointF> getPath(const QPointF &startPos, const QPointF &targetPos) const;
+    QString lastQueryStats() const;
+
+private:
+    struct Cluster
+    {
+        int x0, y0, x1, y1;// The nodes, both bounds included
+        int discovered;// The discovered nodes count the entrances were built for, -1 if never built
+        QVector<int> entrances;// The nodes(i * cellsy + j) on this cluster's side of its borders
+        QVector<qreal> distances;// Between the entrances inside the cluster, entrances.size() x entrances.size()
+    };
+
+    struct AbstractNode
+    {
+        int node;// The grid node
+        int cluster;
+        QVector<QPair<int, qreal> > edges;// (abstract node, cost)
+    };
+
+    int clusterOf(int node) const;
+    int localIndex(int cluster, int node) const;// The index of the node inside the cluster
+    bool isPassable(int node, int start, int goal) const;// Free, or one of the query ends
+    QPointF queryPos(int node, int start, int goal) const;// The exact positions for the query ends, the node itself otherwise
+
+    void refresh() const;// Rebuilds the clusters whose discovered zone or wall squares have changed
+    bool wallsChangedIn(const Cluster &c) const;// Since the clusters were built
+    void updateBorder(int border) const;
+    void updateEntrances(int cluster) const;
+    void rebuildAbstractGraph() const;
+
+    // Dijkstra from source over the cluster's nodes only. dist and parent are indexed by localIndex.
+    void searchCluster(int cluster, int source, int start, int goal, ArenaVector<qreal> *dist, ArenaVector<int> *parent) const;
+    bool appendRefinedPath(int cluster, int from, int to, int start, int goal, QVector<int> *path) const;// Appends the nodes after from, up to to.
+                                                                                                          // False if to can't be reached.
+
+    QVector<QPointF> smoothPath(const QVector<QPointF> &path) const;
+
+    int cellsx, cellsy;
+    int clusterSize;// In grid nodes
+    int clustersx, clustersy;
+
+    mutable QVector<Cluster> clusters;
+    mutable QVector<QVector<QPair<int, int> > > borders;// 2 * c is the border of cluster c with its right neighbour, 2 * c + 1 with the bottom one.
+                                                        // Each holds the node pairs(this side, other side) of its entrances.
+    mutable QVector<AbstractNode> nodes;
+    mutable QVector<int> abstractNodeOf;// By grid node, -1 if it's not an entrance
+
+    mutable QVector<QVector<bool> > builtWalls;// World::wallSquares the clusters are for
+    mutable int builtWallsRevision;
+    mutable QPointF queryStart, queryTarget;
+    mutable int lastExpanded, lastRebuilt;
+};
+
+#endif //HIERARCHICALPLANNER_H
@@ -0,0 +1,373 @@
+#include <QtGui>
+
+#include <algorithm>
+
+#include "MapCompiler.h"
+#include "World.h"
+#include "Geometry.h"
+#include "tools.h"
+
+namespace
+{
+
+const int maxPasses = 4;// After the first one
+
+struct Split
+{
+    qreal t;// Along the segment
+    int vertex;
+
+    bool operator<(const Split &s) const { return t < s.t; }
+};
+
+// Splits the segment at vertex v if v is between its ends
+void addSplit(QVector<Split> *splits, const QVector<QPointF> &vertices, const QPair<int, int> &segment, int v)
+{
+    if (v == segment.first || v == segment.second)
+        return;
+    Vec2 a = vertices[segment.first], d = Vec2(vertices[segment.second]) - a;
+    Split s = {(Vec2(vertices[v]) - a).dot(d) / d.lengthSquared(), v};
+    if (s.t > 0 && s.t < 1)
+        splits->append(s);
+}
+
+qreal distanceToSegment(const Vec2 &p, const Vec2 &a, const Vec2 &b)
+{
+    Vec2 d = b - a;
+    qreal len = d.lengthSquared();
+    qreal t = len > 0 ? qBound(qreal(0.0), (p - a).dot(d) / len, qreal(1.0)) : 0.0;
+    return (p - (a + d * t)).length();
+}
+
+}
+
+MapCompiler::MapCompiler(qreal weldDistance_, qreal straightDistance_):
+    weldDistance(weldDistance_), straightDistance(straightDistance_)
+{
+}
+
+int MapCompiler::vertexAt(const QPointF &p)
+{
+    int bx = qFloor(p.x() / weldDistance), by = qFloor(p.y() / weldDistance);
+    for (int x = bx - 1; x <= bx + 1; x++)
+    {
+        for (int y = by - 1; y <= by + 1; y++)
+        {
+            const QVector<int> &bucket = buckets[qMakePair(x, y)];
+            for (int i = 0; i < bucket.size(); i++)
+            {
+                if (distance(vertices[bucket[i]], p) <= weldDistance)
+                    return bucket[i];
+            }
+        }
+    }
+    vertices.append(p);
+    buckets[qMakePair(bx, by)].append(vertices.size() - 1);
+    return vertices.size() - 1;
+}
+
+QVector<QVector<QPointF> > MapCompiler::compile(const QVector<QVector<QPointF> > &map)
+{
+    Report empty = {0, 0, -1, -1, 0, 0, 0, 0};
+    report_ = empty;
+    for (int i = 0; i < map.size(); i++)
+        report_.segmentsBefore += qMax(map[i].size() - 1, 0);
+
+    // Welding and straightening move the vertices a bit, so the walls might touch something new. It's repeated
+    // until nothing changes, that's one or two more passes.
+    QVector<QVector<QPointF> > result;
+    bool changed = compilePass(map, true, &result);
+    for (int pass = 0; pass < maxPasses && changed; pass++)
+        changed = compilePass(result, false, &result);
+    for (int i = 0; i < result.size(); i++)
+        report_.segmentsAfter += qMax(result[i].size() - 1, 0);
+    return result;
+}
+
+bool MapCompiler::compilePass(const QVector<QVector<QPointF> > &map, bool straight, QVector<QVector<QPointF> > *out)
+{
+    Report last = report_;
+    vertices.clear();
+    buckets.clear();
+    edges.clear();
+
+    QVector<QVector<QPointF> > result;
+    QVector<QPair<int, int> > segments;
+    QSet<QPointF> inputPoints;
+    for (int i = 0; i < map.size(); i++)
+    {
+        if (map[i].size() == 1)
+            result.append(map[i]);// A single point, nothing to clean up
+        for (int j = 0; j < map[i].size() - 1; j++)
+        {
+            segments.append(qMakePair(vertexAt(map[i][j]), vertexAt(map[i][j + 1])));
+            inputPoints.insert(map[i][j]);
+            inputPoints.insert(map[i][j + 1]);
+        }
+    }
+    report_.welded += inputPoints.size() - vertices.size();
+
+    // Splitting. Every segment gets the points where the others cross or touch it, the collinear ones split each other at their ends.
+    QVector<QVector<Split> > splits(segments.size());
+    for (int i = 0; i < segments.size(); i++)
+    {
+        Split s = {0.0, segments[i].first};
+        splits[i].append(s);
+        s.t = 1.0;
+        s.vertex = segments[i].second;
+        splits[i].append(s);
+    }
+    for (int i = 0; i < segments.size(); i++)
+    {
+        Vec2 a = vertices[segments[i].first], b = vertices[segments[i].second];
+        Vec2 r = b - a;
+        qreal rlen = r.length();
+        if (rlen == 0)
+            continue;
+        for (int j = i + 1; j < segments.size(); j++)
+        {
+            Vec2 c = vertices[segments[j].first], d = vertices[segments[j].second];
+            Vec2 s = d - c;
+            qreal slen = s.length();
+            if (slen == 0)
+                continue;
+            qreal den = r.cross(s);
+            if (qAbs(den) > 1e-9 * rlen * slen)// Not parallel
+            {
+                qreal t = (c - a).cross(s) / den, u = (c - a).cross(r) / den;
+                if (t > 0 && t < 1 && u > 0 && u < 1)// A crossing, the touching ends are found below
+                {
+                    int v = vertexAt((a + r * t).toPointF());
+                    addSplit(&splits[i], vertices, segments[i], v);
+                    addSplit(&splits[j], vertices, segments[j], v);
+                }
+            }
+
+            // The ends lying on the other segment split it. That's how the collinear ones are split, and the ends
+            // which come close to a segment without crossing it.
+            if (distanceToSegment(c, a, b) <= weldDistance)
+                addSplit(&splits[i], vertices, segments[i], segments[j].first);
+            if (distanceToSegment(d, a, b) <= weldDistance)
+                addSplit(&splits[i], vertices, segments[i], segments[j].second);
+            if (distanceToSegment(a, c, d) <= weldDistance)
+                addSplit(&splits[j], vertices, segments[j], segments[i].first);
+            if (distanceToSegment(b, c, d) <= weldDistance)
+                addSplit(&splits[j], vertices, segments[j], segments[i].second);
+        }
+    }
+
+    QSet<QPair<int, int> > known;
+    for (int i = 0; i < segments.size(); i++)
+    {
+        if (segments[i].first == segments[i].second)
+        {
+            report_.dropped++;// Zero-length
+            continue;
+        }
+        std::sort(splits[i].begin(), splits[i].end());
+        int pieces = 0;
+        for (int k = 0; k + 1 < splits[i].size(); k++)
+        {
+            int u = splits[i][k].vertex, v = splits[i][k + 1].vertex;
+            if (u == v)
+                continue;// Two splits welded together
+            pieces++;
+            if (known.contains(qMakePair(qMin(u, v), qMax(u, v))))
+            {
+                report_.dropped++;// Repeated
+                continue;
+            }
+            known.insert(qMakePair(qMin(u, v), qMax(u, v)));
+            edges.append(qMakePair(u, v));
+        }
+        report_.splits += qMax(pieces - 1, 0);
+    }
+
+    // Chaining. At each vertex the edges are paired up, the straightest pairs first, the chains go through the pairs.
+    incident = QVector<QVector<int> > (vertices.size());
+    for (int e = 0; e < edges.size(); e++)
+    {
+        incident[edges[e].first].append(e);
+        incident[edges[e].second].append(e);
+    }
+    pairs = QVector<QHash<int, int> > (vertices.size());
+    for (int v = 0; v < vertices.size(); v++)
+    {
+        const QVector<int> &inc = incident[v];
+        QVector<QPair<qreal, QPair<int, int> > > candidates;// (cosine of the angle between the edges, edges), -1 is straight
+        for (int x = 0; x < inc.size(); x++)
+        {
+            for (int y = x + 1; y < inc.size(); y++)
+            {
+                int ox = edges[inc[x]].first == v ? edges[inc[x]].second : edges[inc[x]].first;
+                int oy = edges[inc[y]].first == v ? edges[inc[y]].second : edges[inc[y]].first;
+                Vec2 dx = (Vec2(vertices[ox]) - vertices[v]).normalized(), dy = (Vec2(vertices[oy]) - vertices[v]).normalized();
+                candidates.append(qMakePair(dx.dot(dy), qMakePair(inc[x], inc[y])));
+            }
+        }
+        std::sort(candidates.begin(), candidates.end());
+        for (int k = 0; k < candidates.size(); k++)
+        {
+            int e = candidates[k].second.first, f = candidates[k].second.second;
+            if (pairs[v].contains(e) || pairs[v].contains(f))
+                continue;
+            pairs[v][e] = f;
+            pairs[v][f] = e;
+        }
+    }
+
+    QVector<bool> used(edges.size(), false);
+    QVector<QVector<int> > chains;
+    for (int v = 0; v < vertices.size(); v++)// The open chains start at the unpaired ends
+    {
+        for (int k = 0; k < incident[v].size(); k++)
+        {
+            int e = incident[v][k];
+            if (!used[e] && !pairs[v].contains(e))
+                chains.append(chainEdges(v, e, &used));
+        }
+    }
+    for (int e = 0; e < edges.size(); e++)// Only the cycles are left
+    {
+        if (!used[e])
+            chains.append(chainEdges(edges[e].first, e, &used));
+    }
+
+    for (int i = 0; i < chains.size(); i++)
+    {
+        QVector<QPointF> poly;
+        if (straight)
+        {
+            poly = straighten(chains[i]);
+            report_.merged += chains[i].size() - poly.size();
+        }
+        else
+        {
+            for (int k = 0; k < chains[i].size(); k++)
+                poly.append(vertices[chains[i][k]]);
+        }
+        result.append(poly);
+    }
+    *out = result;
+    return report_.welded != last.welded || report_.splits != last.splits || report_.dropped != last.dropped || report_.merged != last.merged;
+}
+
+QVector<int> MapCompiler::chainEdges(int start, int first, QVector<bool> *used) const
+{
+    QVector<int> chain;
+    chain.append(start);
+    int v = start, e = first;
+    while (e >= 0 && !(*used)[e])
+    {
+        (*used)[e] = true;
+        v = edges[e].first == v ? edges[e].second : edges[e].first;
+        chain.append(v);
+        e = pairs[v].value(e, -1);
+    }
+    return chain;
+}
+
+QVector<QPointF> MapCompiler::straighten(const QVector<int> &chain) const
+{
+    QVector<int> c = chain;
+    bool closed = c.size() > 2 && c.front() == c.back();
+    // The ends, junctions and the vertices where other chains end must stay
+    QVector<bool> fixed(c.size(), false);
+    bool anyFixed = false;
+    for (int k = 0; k < c.size(); k++)
+    {
+        fixed[k] = (!closed && (k == 0 || k == c.size() - 1)) || incident[c[k]].size() != 2;
+        anyFixed = anyFixed || fixed[k];
+    }
+    if (closed)
+    {
+        c.pop_back();
+        fixed.pop_back();
+        int start = 0;
+        if (!anyFixed)// A loop on its own, it starts at its sharpest vertex
+        {
+            qreal sharpest = -1.0;
+            for (int k = 0; k < c.size(); k++)
+            {
+                qreal bend = distanceToSegment(vertices[c[k]], vertices[c[(k + c.size() - 1) % c.size()]], vertices[c[(k + 1) % c.size()]]);
+                if (bend > sharpest)
+                {
+                    sharpest = bend;
+                    start = k;
+                }
+            }
+        }
+        else
+        {
+            while (!fixed[start])
+                start++;
+        }
+        std::rotate(c.begin(), c.begin() + start, c.end());
+        std::rotate(fixed.begin(), fixed.begin() + start, fixed.end());
+        c.append(c.front());
+        fixed[0] = true;
+        fixed.append(true);
+    }
+
+    // Greedy: a segment from the last kept vertex is extended while all the vertices it skips are close to it
+    QVector<QPointF> poly;
+    poly.append(vertices[c[0]]);
+    int anchor = 0;
+    for (int k = 1; k < c.size(); k++)
+    {
+        bool canSkip = !fixed[k] && k + 1 < c.size();
+        if (canSkip)
+        {
+            for (int m = anchor + 1; m <= k && canSkip; m++)
+                canSkip = distanceToSegment(vertices[c[m]], vertices[c[anchor]], vertices[c[k + 1]]) <= straightDistance;
+        }
+        if (!canSkip)
+        {
+            poly.append(vertices[c[k]]);
+            anchor = k;
+        }
+    }
+    return poly;
+}
+
+void MapCompiler::countPivots(const QVector<QVector<QPointF> > &before, const QVector<QVector<QPointF> > &after, int width, int height)
+{
+    report_.pivotsBefore = World(width, height, before).mapPivots.size();
+    report_.pivotsAfter = World(width, height, after).mapPivots.size();
+}
+
+QString MapCompiler::reportText() const
+{
+    QString text = QString("%1 -> %2 segments").arg(report_.segmentsBefore).arg(report_.segmentsAfter);
+    if (report_.pivotsBefore >= 0)
+        text += QString(", %1 -> %2 pivots").arg(report_.pivotsBefore).arg(report_.pivotsAfter);
+    return text + QString(" (%1 vertices welded, %2 splits, %3 pieces dropped, %4 vertices merged)")
+                  .arg(report_.welded).arg(report_.splits).arg(report_.dropped).arg(report_.merged);
+}
+
+int runMapCompiler(const QStringList &args)
+{
+    QTextStream out(stdout);
+    if (args.isEmpty() || args.size() > 2)
+    {
+        out << "Usage: --compile-map map [compiled map]" << endl;
+        return 1;
+    }
+    QVector<QVector<QPointF> > map = getMapFromFile(args[0]);
+    MapCompiler compiler;
+    QVector<QVector<QPointF> > compiled = compiler.compile(map);
+    compiler.countPivots(map, compiled, 900, 600);// The main window's field
+    out << args[0] << ": " << compiler.reportText() << endl;
+    if (args.size() == 2)
+    {
+        QFile file(args[1]);
+        if (!file.open(QIODevice::WriteOnly))
+        {
+            out << "Couldn't write " << args[1] << endl;
+            return 1;
+        }
+        QDataStream stream(&file);
+        stream << compiled;
+    }
+    return 0;
+}
@@ -0,0 +1,50 @@
+#ifndef MAPCOMPILER_H
+#define MAPCOMPILER_H
+
+#include <QtGui>
+
+// Cleans the map geometry up before it gets to the World. The drawn and generated maps have duplicate vertices,
+// overlapping and crossing walls and nearly straight chains of short segments, and all of them cost pivots and intersection tests.
+// The walls become a planar graph: the vertices closer than weldDistance are welded, the segments are split where they
+// cross or touch, and the zero-length and repeated pieces are dropped. Then the graph is chained back into polylines going
+// straight through the junctions where they can, and the vertices which only bend a chain by less than straightDistance are removed.
+class MapCompiler
+{
+public:
+    MapCompiler(qreal weldDistance_ = 0.5, qreal straightDistance_ = 0.5);
+
+    QVector<QVector<QPointF> > compile(const QVector<QVector<QPointF> > &map);
+
+    struct Report
+    {
+        int segmentsBefore, segmentsAfter;
+        int pivotsBefore, pivotsAfter;// Only counted by countPivots(...), -1 until then
+        int welded;// Vertices welded to another one
+        int splits;// Pieces added by splitting at the intersections
+        int dropped;// Zero-length and repeated pieces
+        int merged;// Vertices removed from the straight runs
+    };
+    const Report &report() const { return report_; }
+    void countPivots(const QVector<QVector<QPointF> > &before, const QVector<QVector<QPointF> > &after, int width, int height);// Builds a World for each map
+    QString reportText() const;// One line for the UI and the console
+
+private:
+    bool compilePass(const QVector<QVector<QPointF> > &map, bool straight, QVector<QVector<QPointF> > *out);// Returns true if anything changed
+    int vertexAt(const QPointF &p);// Welds p to a vertex closer than weldDistance or adds a new one
+    QVector<int> chainEdges(int start, int first, QVector<bool> *used) const;// Follows the pairs from vertex start along edge first, returns the vertices
+    QVector<QPointF> straighten(const QVector<int> &chain) const;// Drops the vertices that don't bend the chain
+
+    qreal weldDistance, straightDistance;
+
+    QVector<QPointF> vertices;
+    QHash<QPair<int, int>, QVector<int> > buckets;// The vertices by weldDistance-sized squares
+    QVector<QPair<int, int> > edges;// Vertex pairs
+    QVector<QVector<int> > incident;// The edges of each vertex
+    QVector<QHash<int, int> > pairs;// At each vertex, the edge the chain continues with after an edge, missing for the chain ends
+    Report report_;
+};
+
+// Started by "./mapexploration --compile-map map [compiled map]", prints the report and writes the result if asked to
+int runMapCompiler(const QStringList &args);
+
+#endif //MAPCOMPILER_H
@@ -2,17 +2,33 @@
 #include "MapExploration.h"
 #include "Visualisation.h"
 #include "editor/MapEditor.h"
+#include "tools.h"
+#include "MapCompiler.h"
 
 MapExploration::MapExploration(int vwidth_, int vheight_, QWidget *parent):
     QWidget(parent),
     name("Map exploration"),
     mapEditor(NULL),
+    wallEdits(NULL),
     visualisation(NULL),
     loadMapBtn(new QPushButton("Load...")),
     reloadMapBtn(new QPushButton("Reload map")),
     startMapEditorBtn(new QPushButton("Edit map")),
     pauseVisualisationBtn(new QPushButton("Pause visualisation")),
     toggleManualControlBtn(new QPushButton("Toggle manual control")),
+    plannerBox(new QComboBox()),
+    speedBox(new QSpinBox()),
+    radiusBox(new QSpinBox()),
+    coverageBox(new QSpinBox()),
+    runToCoverageBtn(new QPushButton("Run until")),
+    recordTraceBtn(new QPushButton("Record trace...")),
+    replayTraceBtn(new QPushButton("Replay trace...")),
+    replaySlider(new QSlider(Qt::Horizontal)),
+    mapReportLabel(new QLabel()),
+    completionLabel(new QLabel()),
+    captureBtn(new QPushButton("Capture video...")),
+    saveCheckpointBtn(new QPushButton("Save checkpoint...")),
+    loadCheckpointBtn(new QPushButton("Load checkpoint...")),
     vwidth(vwidth_), vheight(vheight_)
 {
     setWindowTitle(name + " - " + "Empty map");
@@ -26,15 +42,59 @@ MapExploration::MapExploration(int vwidth_, int vheight_, QWidget *parent):
     mapControls->addWidget(loadMapBtn);
     mapControls->addWidget(reloadMapBtn);
     mapControls->addWidget(startMapEditorBtn);
+    mapReportLabel->setWordWrap(true);
+    mapControls->addWidget(mapReportLabel);
+    completionLabel->setWordWrap(true);
+    mapControls->addWidget(completionLabel);
+    mapControls->addSpacing(20);
+    mapControls->addWidget(recordTraceBtn);
+    mapControls->addWidget(replayTraceBtn);
+    mapControls->addWidget(replaySlider);
+    mapControls->addWidget(captureBtn);
+    mapControls->addSpacing(20);
+    mapControls->addWidget(saveCheckpointBtn);
+    mapControls->addWidget(loadCheckpointBtn);
     mapControls->addStretch(1);
 
     QHBoxLayout *visControls = new QHBoxLayout();
     visControls->addWidget(pauseVisualisationBtn);
     visControls->addWidget(toggleManualControlBtn);
+    visControls->addWidget(new QLabel("Planner:"));
+    visControls->addWidget(plannerBox);
+    visControls->addWidget(new QLabel("Speed:"));
+    visControls->addWidget(speedBox);
+    visControls->addWidget(new QLabel("Radius:"));
+    visControls->addWidget(radiusBox);
+    visControls->addWidget(runToCoverageBtn);
+    visControls->addWidget(coverageBox);
     visControls->addStretch(1);
 
+    speedBox->setRange(1, 64);
+    speedBox->setPrefix("x");
+    coverageBox->setRange(1, 100);
+    coverageBox->setValue(95);
+    coverageBox->setSuffix("% discovered");
+    connect(speedBox, SIGNAL(valueChanged(int)), this, SLOT(setSpeed(int)));
+    radiusBox->setRange(0, 40);
+    radiusBox->setSuffix(" px");
+    connect(radiusBox, SIGNAL(valueChanged(int)), this, SLOT(setRobotRadius(int)));
+    connect(runToCoverageBtn, SIGNAL(clicked()), this, SLOT(runToCoverage()));
+
+    recordTraceBtn->setCheckable(true);
+    replayTraceBtn->setCheckable(true);
+    replaySlider->setEnabled(false);
+    connect(recordTraceBtn, SIGNAL(toggled(bool)), this, SLOT(toggleRecording(bool)));
+    connect(replayTraceBtn, SIGNAL(toggled(bool)), this, SLOT(toggleReplay(bool)));
+    connect(replaySlider, SIGNAL(sliderMoved(int)), this, SLOT(seekReplay(int)));
+    captureBtn->setCheckable(true);
+    connect(captureBtn, SIGNAL(toggled(bool)), this, SLOT(toggleCapture(bool)));
+    connect(saveCheckpointBtn, SIGNAL(clicked()), this, SLOT(saveCheckpoint()));
+    connect(loadCheckpointBtn, SIGNAL(clicked()), this, SLOT(loadCheckpoint()));
+
     mainLayout = new QGridLayout();
     setVisualisation(new Visualisation(vwidth, vheight, QVector<QVector<QPointF> > ()));
+    plannerBox->addItems(visualisation->plannerNames());
+    connect(plannerBox, SIGNAL(currentIndexChanged(int)), this, SLOT(setPlanner(int)));
     mainLayout->addLayout(visControls, 1, 0);
     mainLayout->addLayout(mapControls, 0, 1);
     mainLayout->setSizeConstraint(QLayout::SetFixedSize);
@@ -65,24 +125,10 @@ void MapExploration::editMap()
     mapEditor = new MapEditor(vwidth, vheight, curMap);
     startMapEditorBtn->setDisabled(true);
     connect(mapEditor, SIGNAL(gonnaDie()), this, SLOT(unBlockEditMap()));
+    connect(mapEditor, SIGNAL(mapEdited(const QVector<QVector<QPointF> > &)), this, SLOT(applyEditedMap(const QVector<QVector<QPointF> > &)));
     mapEditor->show();
 }
 
-namespace{
-
-QVector<QVector<QPointF> > getMapFromFile(const QString &fileName)
-{
-    QFile file(fileName);
-    file.open(QIODevice::ReadOnly);
-    QDataStream in(&file);
-    QVector<QVector<QPointF> > m;
-    in >> m;
-    file.close();
-    return m;
-}
-
-}
-
 void MapExploration::loadFromFile()
 {
     QString fileName = QFileDialog::getOpenFileName(this,
@@ -100,7 +146,7 @@ void MapExploration::loadFromFile()
 #ifdef DEBUG
         qDebug() << "File " + fileName + " has been loaded: " << endl << m << endl;
 #endif
-        setVisualisation(new Visualisation(vwidth, vheight, m));
+        showMap(m);
     }
 }
 
@@ -109,12 +155,158 @@ void MapExploration::reloadMap()
     if (curMap.isEmpty())
         return;
     QVector<QVector<QPointF> > m = getMapFromFile(curMap);
-    setVisualisation(new Visualisation(vwidth, vheight, m));
+    showMap(m);
 #ifdef DEBUG
     qDebug() << "File " + curMap + " has been reloaded: " << endl << m << endl;
 #endif
 }
 
+void MapExploration::setPlanner(int index)
+{
+    visualisation->setPlanner(index);
+}
+
+void MapExploration::setSpeed(int speed)
+{
+    visualisation->setSpeed(speed);
+}
+
+void MapExploration::setRobotRadius(int radius)
+{
+    visualisation->setRobotRadius(radius);
+}
+
+void MapExploration::runToCoverage()
+{
+    visualisation->runToCoverage(coverageBox->value());
+}
+
+void MapExploration::toggleRecording(bool on)
+{
+    if (!on)
+    {
+        visualisation->stopRecording();
+        return;
+    }
+    QString fileName = QFileDialog::getSaveFileName(this,
+                                                    "Record trace",
+                                                    "exploration.trace",
+                                                    "Trace files (*.trace);;All files (*)");
+    if (fileName.isEmpty() || !visualisation->startRecording(fileName))
+        recordTraceBtn->setChecked(false);
+}
+
+void MapExploration::toggleReplay(bool on)
+{
+    if (!on)
+    {
+        visualisation->stopReplay();
+        replaySlider->setEnabled(false);
+        return;
+    }
+    QString fileName = QFileDialog::getOpenFileName(this,
+                                                    "Replay trace",
+                                                    "",
+                                                    "Trace files (*.trace);;All files (*)");
+    if (fileName.isEmpty() || !visualisation->startReplay(fileName))
+    {
+        replayTraceBtn->setChecked(false);
+        return;
+    }
+    replaySlider->setRange(visualisation->replayFirstTick(), visualisation->replayLastTick());
+    replaySlider->setValue(visualisation->replayFirstTick());
+    replaySlider->setEnabled(true);
+}
+
+void MapExploration::seekReplay(int tick)
+{
+    visualisation->seekReplay(tick);
+}
+
+void MapExploration::toggleCapture(bool on)
+{
+    if (!on)
+    {
+        visualisation->stopCapture();
+        return;
+    }
+    QString fileName = QFileDialog::getSaveFileName(this,
+                                                    "Capture video",
+                                                    "exploration.y4m",
+                                                    "Y4M video (*.y4m);;PNG frames (*.png)");
+    if (fileName.isEmpty() || !visualisation->startCapture(fileName))
+        captureBtn->setChecked(false);
+}
+
+void MapExploration::showCaptureError(const QString &error)
+{
+    captureBtn->setChecked(false);
+    QMessageBox::warning(this, name, "The capture stopped: " + error);
+}
+
+void MapExploration::saveCheckpoint()
+{
+    QString fileName = QFileDialog::getSaveFileName(this,
+                                                    "Save checkpoint",
+                                                    "exploration.checkpoint",
+                                                    "Checkpoints (*.checkpoint);;All files (*)");
+    if (!fileName.isEmpty() && !visualisation->saveCheckpoint(fileName))
+        QMessageBox::warning(this, name, "Couldn't write " + fileName);
+}
+
+void MapExploration::loadCheckpoint()
+{
+    QString fileName = QFileDialog::getOpenFileName(this,
+                                                    "Load checkpoint",
+                                                    "",
+                                                    "Checkpoints (*.checkpoint);;All files (*)");
+    if (fileName.isEmpty())
+        return;
+    recordTraceBtn->setChecked(false);// The trace can't jump to another tick
+    replayTraceBtn->setChecked(false);
+    if (!visualisation->loadCheckpoint(fileName))
+    {
+        QMessageBox::warning(this, name, fileName + " isn't a checkpoint of the current map");
+        return;
+    }
+    plannerBox->setCurrentIndex(visualisation->plannerIndex());
+}
+
+void MapExploration::showMap(const QVector<QVector<QPointF> > &m)
+{
+    MapCompiler compiler;
+    QVector<QVector<QPointF> > compiled = compiler.compile(m);
+    compiler.countPivots(m, compiled, vwidth, vheight);
+    mapReportLabel->setText(compiler.reportText());
+#ifdef DEBUG
+    qDebug() << "Map compiled: " << compiler.reportText() << endl;
+#endif
+    setVisualisation(new Visualisation(vwidth, vheight, compiled));
+}
+
+void MapExploration::applyEditedMap(const QVector<QVector<QPointF> > &m)
+{
+    MapCompiler compiler;
+    visualisation->setWalls(compiler.compile(m));
+}
+
+bool MapExploration::listenForWallEdits(const QString &name)
+{
+    if (wallEdits == NULL)
+        wallEdits = new WallEditServer(this);
+    if (!wallEdits->listen(name))
+        return false;
+    connectWallEdits();
+    return true;
+}
+
+void MapExploration::connectWallEdits()
+{
+    connect(wallEdits, SIGNAL(wallAdded(int, const QVector<QPointF> &)), visualisation, SLOT(addWall(int, const QVector<QPointF> &)));
+    connect(wallEdits, SIGNAL(wallRemoved(int)), visualisation, SLOT(removeWall(int)));
+    connect(wallEdits, SIGNAL(wallMoved(int, const QPointF &)), visualisation, SLOT(moveWall(int, const QPointF &)));
+}
+
 void MapExploration::setVisualisation(Visualisation *newvis)
 {
     if (visualisation != NULL)
@@ -123,7 +315,25 @@ void MapExploration::setVisualisation(Visualisation *newvis)
         delete visualisation;
     }
     visualisation = newvis;
+    recordTraceBtn->setChecked(false);// A new map, a new trace
+    replayTraceBtn->setChecked(false);
+    captureBtn->setChecked(false);
+    completionLabel->clear();
     mainLayout->addWidget(visualisation, 0, 0);
     connect(pauseVisualisationBtn, SIGNAL(clicked()), visualisation, SLOT(togglePause()));
     connect(toggleManualControlBtn, SIGNAL(clicked()), visualisation, SLOT(toggleManualControl()));
+    visualisation->setPlanner(plannerBox->currentIndex());
+    visualisation->setSpeed(speedBox->value());
+    visualisation->setRobotRadius(radiusBox->value());
+    connect(visualisation, SIGNAL(replayPositionChanged(int)), replaySlider, SLOT(setValue(int)));
+    connect(visualisation, SIGNAL(explorationComplete(int, qreal)), this, SLOT(showCompletion(int, qreal)));
+    connect(visualisation, SIGNAL(captureFailed(QString)), this, SLOT(showCaptureError(QString)));
+    if (wallEdits != NULL)// The script's walls are gone with the old map, its next edits go to the new one
+        connectWallEdits();
+}
+
+void MapExploration::showCompletion(int ticks, qreal coverage)
+{
+    completionLabel->setText(QString("Explored in %1 ticks with %2, %3% of the field discovered. Nothing reachable is left.")
+                             .arg(ticks).arg(plannerBox->currentText()).arg(coverage * 100, 0, 'f', 1));
 }
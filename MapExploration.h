@@ -5,6 +5,7 @@
 
 #include "Visualisation.h"
 #include "editor/MapEditor.h"
+#include "WallEditServer.h"
 
 class MapExploration: public QWidget
 {
@@ -13,20 +14,45 @@ class MapExploration: public QWidget
 public:
     MapExploration(int vwidth_, int vheight_, QWidget *parent = NULL);
 
+    bool listenForWallEdits(const QString &name);// Starts a WallEditServer, its edits go to every map shown after that
+
 private slots:
     void loadFromFile();
     void reloadMap();
     void editMap(); // Creates a map editor instanse. If there is one already, does nothing.
     void unBlockEditMap();// To prevent creating multiple map editor windows, "Edit Map" button is blocked while editing map. This slot handles unblocking it after map editor close.
 
+    void setPlanner(int);// The planner choice survives map reloading, so it's passed through here
+    void setSpeed(int);// The same for the speed
+    void setRobotRadius(int);// And the robot's radius
+    void runToCoverage();
+    void toggleRecording(bool);
+    void toggleReplay(bool);
+    void seekReplay(int);
+    void toggleCapture(bool);
+    void showCaptureError(const QString &error);
+    void saveCheckpoint();
+    void loadCheckpoint();
+    void showCompletion(int ticks, qreal coverage);
+    void applyEditedMap(const QVector<QVector<QPointF> > &m);// The live map editor's walls replace the running map's ones
+
 private:
     void closeEvent(QCloseEvent *);
     void setVisualisation(Visualisation *newvis);// Handles the signals and layouting too
+    void showMap(const QVector<QVector<QPointF> > &m);// Compiles the map(see MapCompiler) and shows it
+    void connectWallEdits();// To the current visualisation
 
     QString name;
     MapEditor *mapEditor;
+    WallEditServer *wallEdits;// NULL unless listenForWallEdits was called
     Visualisation *visualisation;
     QPushButton *loadMapBtn, *reloadMapBtn, *startMapEditorBtn, *pauseVisualisationBtn, *toggleManualControlBtn;
+    QComboBox *plannerBox;
+    QSpinBox *speedBox, *radiusBox, *coverageBox;
+    QPushButton *runToCoverageBtn, *recordTraceBtn, *replayTraceBtn;
+    QSlider *replaySlider;
+    QLabel *mapReportLabel, *completionLabel;
+    QPushButton *captureBtn, *saveCheckpointBtn, *loadCheckpointBtn;
     QString curMap;
     int vwidth, vheight;// Visualisation parameters
     QGridLayout *mainLayout;
@@ -0,0 +1,99 @@
+#include <QtGui>
+
+#include <cmath>
+
+#include "OccupancyGrid.h"
+
+namespace
+{
+
+// The scan's sector: the origin, the ends of the span and the axis directions inside it, all at maxRange
+QRectF sectorBounds(const RangeScan &scan)
+{
+    qreal minx = scan.origin.x, maxx = minx, miny = scan.origin.y, maxy = miny;
+    qreal first = scan.heading - scan.span / 2, last = first + qMin(scan.span, 2 * PI());
+    qreal angles[7] = {first, last};// At most 5 axis directions fit between them
+    int count = 2;
+    for (qreal a = std::ceil(first / (PI() / 2)) * (PI() / 2); a < last && count < 7; a += PI() / 2)
+        angles[count++] = a;
+    for (int k = 0; k < count; k++)
+    {
+        Vec2 p = scan.origin + Vec2::fromAngle(angles[k]) * scan.maxRange;
+        minx = qMin(minx, p.x);
+        maxx = qMax(maxx, p.x);
+        miny = qMin(miny, p.y);
+        maxy = qMax(maxy, p.y);
+    }
+    return QRectF(minx, miny, maxx - minx, maxy - miny);
+}
+
+}
+
+OccupancyGrid::OccupancyGrid():
+    cellsx(0), cellsy(0)
+{
+}
+
+void OccupancyGrid::resize(int cellsx_, int cellsy_)
+{
+    cellsx = cellsx_;
+    cellsy = cellsy_;
+    cells.fill(0, cellsx * cellsy);
+}
+
+void OccupancyGrid::observe(const RangeScan &scan, qreal cellSize, Observation *out) const
+{
+    QRectF bounds = sectorBounds(scan);
+    QRect nodes(QPoint(qFloor(bounds.left() / cellSize), qFloor(bounds.top() / cellSize)),
+                QPoint(qCeil(bounds.right() / cellSize), qCeil(bounds.bottom() / cellSize)));
+    nodes &= QRect(0, 0, cellsx, cellsy);
+    out->nodes = nodes;
+    out->delta.fill(0, nodes.width() * nodes.height());
+    if (nodes.isEmpty())
+        return;
+
+    qint8 *delta = out->delta.data();
+    for (int i = nodes.left(); i <= nodes.right(); i++)
+    {
+        for (int j = nodes.top(); j <= nodes.bottom(); j++)
+        {
+            if (scan.covers(Vec2(cellSize * i, cellSize * j)))
+                delta[(i - nodes.left()) * nodes.height() + j - nodes.top()] = freeStep;
+        }
+    }
+    for (int b = 0; b < scan.beams(); b++)// The hits win over the free looks, the node closest to the hit is the occupied one
+    {
+        if (!scan.isHit(b))
+            continue;
+        Vec2 hit = scan.endPoint(b);
+        int i = qRound(hit.x / cellSize), j = qRound(hit.y / cellSize);
+        if (nodes.contains(i, j))
+            delta[(i - nodes.left()) * nodes.height() + j - nodes.top()] = hitStep;
+    }
+}
+
+void OccupancyGrid::integrate(const Observation &observation)
+{
+    // The bounds are copied, the bytes written below could alias anything as far as the compiler knows
+    const int left = observation.nodes.left(), right = observation.nodes.right();
+    const int top = observation.nodes.top(), height = observation.nodes.height();
+    qint8 *data = cells.data();
+    for (int i = left; i <= right; i++)
+    {
+        qint8 *cell = data + i * cellsy + top;
+        const qint8 *delta = observation.delta.constData() + (i - left) * height;
+        for (int j = 0; j < height; j++)
+        {
+            qint16 value = cell[j] + delta[j];// Can't overflow 16 bits, so clamping it is the saturating add
+            cell[j] = qint8(value < -maxConfidence ? -maxConfidence : value > maxConfidence ? maxConfidence : value);
+        }
+    }
+}
+
+OccupancyGrid::State OccupancyGrid::state(int i, int j) const
+{
+    int value = cells[i * cellsy + j];
+    if (value <= -knownThreshold)
+        return Free;
+    return value >= knownThreshold ? Occupied : Unknown;
+}
@@ -0,0 +1,50 @@
+#ifndef OCCUPANCYGRID_H
+#define OCCUPANCYGRID_H
+
+#include <QtGui>
+
+#include "RangeSensor.h"
+
+// The log-odds occupancy of the grid nodes, one signed byte each: 0 is unknown, the negative values say free and
+// the positive ones occupied. Every scan adds its evidence with saturation at +-maxConfidence, so a wall that was seen
+// many times needs as many looks at the free space to go away. The thresholded view(state(...)) is what the rest
+// of the program uses, see World::occupancy.
+class OccupancyGrid
+{
+public:
+    OccupancyGrid();
+
+    void resize(int cellsx_, int cellsy_);// Everything unknown
+
+    // One scan's evidence for the nodes of a rectangle, freeStep for the nodes it sees, hitStep for the ones its beams end at,
+    // 0 for the rest. delta[(i - nodes.left()) * nodes.height() + (j - nodes.top())] like the grid's columns.
+    struct Observation
+    {
+        QRect nodes;
+        QVector<qint8> delta;
+    };
+    void observe(const RangeScan &scan, qreal cellSize, Observation *out) const;
+    void integrate(const Observation &observation);// The saturating adds run column by column, vectorized by the compiler
+
+    enum State
+    {
+        Unknown,
+        Free,
+        Occupied
+    };
+    State state(int i, int j) const;
+    bool isKnown(int i, int j) const { return state(i, j) != Unknown; }
+    qint8 logOdds(int i, int j) const { return cells[i * cellsy + j]; }
+
+    // The sensor model in the bytes' units: a node needs two free looks or one hit to be known
+    static const int freeStep = -6;
+    static const int hitStep = 24;
+    static const int knownThreshold = 12;
+    static const int maxConfidence = 96;
+
+private:
+    int cellsx, cellsy;
+    QVector<qint8> cells;// The node (i, j) is cells[i * cellsy + j]
+};
+
+#endif //OCCUPANCYGRID_H
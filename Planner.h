@@ -0,0 +1,23 @@
+#ifndef PLANNER_H
+#define PLANNER_H
+
+#include <QtGui>
+
+#include "World.h"
+
+// A path planner works on the world it was created for and sees all its changes(e.g. the discovered zone growing).
+class Planner
+{
+public:
+    Planner(const World &world_): world(world_) {}
+    virtual ~Planner() {}
+
+    virtual QString name() const = 0;
+    virtual QVector<QPointF> getPath(const QPointF &startPos, const QPointF &targetPos) const = 0;// Returns the path from startPos to targetPos(both included) or an empty vector if there's no path.
+    virtual QString lastQueryStats() const = 0;// Human readable amount of work done by the last getPath call, for debugging and benchmarks.
+
+protected:
+    const World &world;
+};
+
+#endif //PLANNER_H
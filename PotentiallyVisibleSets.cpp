@@ -0,0 +1,318 @@
+#include <QtGui>
+#include <QtConcurrentMap>
+
+#include <algorithm>
+
+#include "PotentiallyVisibleSets.h"
+#include "tools.h"
+
+namespace
+{
+
+struct CacheEntry
+{
+    QVector<QVector<QPointF> > walls;
+    int width, height;
+    PotentiallyVisibleSets sets;
+};
+
+const int cacheSize = 8;// Maps remembered, the oldest one is forgotten first
+QMutex cacheMutex;
+QList<CacheEntry> cache;// The most recently used first
+
+void remember(const QVector<QVector<QPointF> > &walls, int width, int height, const PotentiallyVisibleSets &sets)
+{
+    CacheEntry entry;
+    entry.walls = walls;
+    entry.width = width;
+    entry.height = height;
+    entry.sets = sets;
+    QMutexLocker locker(&cacheMutex);
+    cache.prepend(entry);
+    while (cache.size() > cacheSize)
+        cache.removeLast();
+}
+
+bool crossesProperly(const Segment &wall, const Vec2 &p, const Vec2 &q)// Both ends of each segment strictly on the different sides of the other one
+{
+    qreal o1 = orientation(wall.a, wall.b, p), o2 = orientation(wall.a, wall.b, q);
+    if (!((o1 > 0 && o2 < 0) || (o1 < 0 && o2 > 0)))
+        return false;
+    qreal o3 = orientation(p, q, wall.a), o4 = orientation(p, q, wall.b);
+    return (o3 > 0 && o4 < 0) || (o3 < 0 && o4 > 0);
+}
+
+bool hides(const Segment &occluder, const Vec2 *corners, const Segment &wall)
+{
+    for (int c = 0; c < 4; c++)
+    {
+        if (!crossesProperly(occluder, corners[c], wall.a) || !crossesProperly(occluder, corners[c], wall.b))
+            return false;
+    }
+    return true;
+}
+
+// Tests the other segments as the occluders of segments[k], lastOccluder is tried first and is set to the one that was found
+bool isHidden(const QVector<Segment> &segments, const QRectF &tile, int k, int *lastOccluder)
+{
+    Vec2 corners[4] = {tile.topLeft(), tile.topRight(), tile.bottomRight(), tile.bottomLeft()};
+    const Segment &wall = segments[k];
+    if (*lastOccluder >= 0 && *lastOccluder != k && hides(segments[*lastOccluder], corners, wall))
+        return true;
+    Segment probe(tile.center(), (wall.a + wall.b) / 2);// An occluder crosses all the lines, this one too
+    for (int o = 0; o < segments.size(); o++)
+    {
+        if (o == k || o == *lastOccluder || !segments[o].intersects(probe))
+            continue;
+        if (hides(segments[o], corners, wall))
+        {
+            *lastOccluder = o;
+            return true;
+        }
+    }
+    return false;
+}
+
+struct TileJob
+{
+    const QVector<Segment> *segments;
+    QRectF tile;
+    // Only for the updates
+    QVector<int> set;// The tile's old set, renumbered
+    const QVector<Segment> *removed;
+    const QVector<bool> *isNew;
+};
+
+QVector<int> tileSet(const TileJob &job)
+{
+    const QVector<Segment> &segments = *job.segments;
+    QVector<int> set;
+    int lastOccluder = -1;// The neighbouring walls are mostly hidden by the same one
+    for (int k = 0; k < segments.size(); k++)
+    {
+        if (!isHidden(segments, job.tile, k, &lastOccluder))
+            set.append(k);
+    }
+    return set;
+}
+
+// A wall that is still there stays hidden if its occluder is, so only the walls a removed segment could hide
+// (it crosses their probe) and the new walls are tested. The walls a new one hides are left in the set.
+QVector<int> updatedTileSet(const TileJob &job)
+{
+    const QVector<Segment> &segments = *job.segments;
+    const QVector<Segment> &removed = *job.removed;
+    QVector<bool> inSet(segments.size(), false);
+    for (int n = 0; n < job.set.size(); n++)
+        inSet[job.set[n]] = true;
+    QVector<int> set = job.set;
+    int lastOccluder = -1;
+    Vec2 centre = job.tile.center();
+    for (int k = 0; k < segments.size(); k++)
+    {
+        if (inSet[k])
+            continue;
+        bool retest = (*job.isNew)[k];
+        Segment probe(centre, (segments[k].a + segments[k].b) / 2);
+        for (int r = 0; r < removed.size() && !retest; r++)
+            retest = removed[r].intersects(probe);
+        if (retest && !isHidden(segments, job.tile, k, &lastOccluder))
+            set.append(k);
+    }
+    std::sort(set.begin(), set.end());
+    return set;
+}
+
+}
+
+PotentiallyVisibleSets::PotentiallyVisibleSets():
+    width(0), height(0), tileSize(defaultTileSize), tilesx(0), tilesy(0)
+{
+}
+
+void PotentiallyVisibleSets::setWalls(const QVector<QVector<QPointF> > &walls, int width_, int height_, int tileSize_)
+{
+    width = width_;
+    height = height_;
+    tileSize = tileSize_;
+    tilesx = (width + tileSize - 1) / tileSize;
+    tilesy = (height + tileSize - 1) / tileSize;
+    segments.clear();
+    for (int i = 0; i < walls.size(); i++)
+    {
+        for (int j = 0; j < walls[i].size() - 1; j++)
+            segments.append(Segment(walls[i][j], walls[i][j + 1]));
+    }
+    offsets.clear();
+    indices.clear();
+}
+
+void PotentiallyVisibleSets::build(const QVector<QVector<QPointF> > &walls, int width, int height, int tileSize_)
+{
+    setWalls(walls, width, height, tileSize_);
+    QList<TileJob> jobs;
+    for (int i = 0; i < tilesx; i++)
+    {
+        for (int j = 0; j < tilesy; j++)
+        {
+            TileJob job;
+            job.segments = &segments;
+            job.tile = QRectF(i * tileSize, j * tileSize, tileSize, tileSize);
+            jobs.append(job);
+        }
+    }
+    QList<QVector<int> > sets = QtConcurrent::blockingMapped<QList<QVector<int> > >(jobs, tileSet);
+
+    offsets.append(0);
+    for (int t = 0; t < sets.size(); t++)
+    {
+        indices += sets[t];
+        offsets.append(indices.size());
+    }
+#ifdef DEBUG
+    qDebug() << "Potentially visible sets:" << segments.size() << "segments," << averageSetSize() << "per tile" << endl;
+#endif
+}
+
+void PotentiallyVisibleSets::update(const QVector<QVector<QPointF> > &walls)
+{
+    if (isEmpty())
+    {
+        build(walls, width, height, tileSize);
+        return;
+    }
+    QVector<Segment> before = segments;
+    QVector<int> oldOffsets = offsets, oldIndices = indices;
+    setWalls(walls, width, height, tileSize);
+    QVector<int> match = matchSegments(before, segments);
+    QVector<Segment> removed;
+    QVector<bool> isNew(segments.size(), true);
+    for (int k = 0; k < match.size(); k++)
+    {
+        if (match[k] >= 0)
+            isNew[match[k]] = false;
+        else
+            removed.append(before[k]);
+    }
+
+    QList<TileJob> jobs;
+    for (int i = 0; i < tilesx; i++)
+    {
+        for (int j = 0; j < tilesy; j++)
+        {
+            TileJob job;
+            job.segments = &segments;
+            job.tile = QRectF(i * tileSize, j * tileSize, tileSize, tileSize);
+            int t = i * tilesy + j;
+            for (int n = oldOffsets[t]; n < oldOffsets[t + 1]; n++)
+            {
+                if (match[oldIndices[n]] >= 0)
+                    job.set.append(match[oldIndices[n]]);
+            }
+            job.removed = &removed;
+            job.isNew = &isNew;
+            jobs.append(job);
+        }
+    }
+    QList<QVector<int> > sets = QtConcurrent::blockingMapped<QList<QVector<int> > >(jobs, updatedTileSet);
+
+    offsets.append(0);
+    for (int t = 0; t < sets.size(); t++)
+    {
+        indices += sets[t];
+        offsets.append(indices.size());
+    }
+}
+
+PotentiallyVisibleSets PotentiallyVisibleSets::shared(const QVector<QVector<QPointF> > &walls, int width, int height)
+{
+    {
+        QMutexLocker locker(&cacheMutex);
+        for (int i = 0; i < cache.size(); i++)
+        {
+            if (cache[i].width == width && cache[i].height == height && cache[i].walls == walls)
+            {
+                cache.move(i, 0);
+                return cache[0].sets;
+            }
+        }
+    }
+
+    PotentiallyVisibleSets sets;// Built unlocked, like ConfigurationSpace::inflate
+    sets.build(walls, width, height);
+    remember(walls, width, height, sets);
+    return sets;
+}
+
+void PotentiallyVisibleSets::store(PrecomputeCache::Writer *out, const QByteArray &name) const
+{
+    out->add(name + ".tileSize", QVector<int>() << tileSize);
+    out->add(name + ".offsets", offsets);
+    out->add(name + ".indices", indices);
+}
+
+bool PotentiallyVisibleSets::restore(const PrecomputeCache::Reader &in, const QByteArray &name, const QVector<QVector<QPointF> > &walls,
+                                     int width, int height)
+{
+    // Everything is read aside first, so a broken file leaves the sets as they were
+    QVector<int> size;
+    PotentiallyVisibleSets sets;
+    if (!in.read(name + ".tileSize", &size) || size.size() != 1 || size[0] <= 0)
+        return false;
+    sets.setWalls(walls, width, height, size[0]);
+    if (!in.read(name + ".offsets", &sets.offsets) || !in.read(name + ".indices", &sets.indices))
+        return false;
+    if (sets.offsets.size() != sets.tilesx * sets.tilesy + 1 || sets.offsets[0] != 0 || sets.offsets.back() != sets.indices.size())
+        return false;
+    for (int t = 0; t + 1 < sets.offsets.size(); t++)
+    {
+        if (sets.offsets[t] > sets.offsets[t + 1])
+            return false;
+    }
+    for (int n = 0; n < sets.indices.size(); n++)
+    {
+        if (sets.indices[n] < 0 || sets.indices[n] >= sets.segments.size())
+            return false;
+    }
+    *this = sets;
+    return true;
+}
+
+int PotentiallyVisibleSets::tileAt(const QPointF &p) const
+{
+    int i = qFloor(p.x() / tileSize), j = qFloor(p.y() / tileSize);
+    if (i < 0 || i >= tilesx || j < 0 || j >= tilesy || offsets.isEmpty())
+        return -1;
+    return i * tilesy + j;
+}
+
+const int *PotentiallyVisibleSets::wallsSeenFrom(const QPointF &p, int *count) const
+{
+    int t = tileAt(p);
+    if (t < 0)
+        return NULL;
+    *count = offsets[t + 1] - offsets[t];
+    return indices.constData() + offsets[t];
+}
+
+bool PotentiallyVisibleSets::hit(const QPointF &a, const QPointF &b) const
+{
+    Segment line(a, b);
+    int count = 0;
+    const int *seen = wallsSeenFrom(a, &count);
+    if (seen == NULL)
+    {
+        for (int k = 0; k < segments.size(); k++)
+        {
+            if (segments[k].intersects(line))
+                return true;
+        }
+        return false;
+    }
+    for (int n = 0; n < count; n++)
+    {
+        if (segments[seen[n]].intersects(line))
+            return true;
+    }
+    return false;
+}
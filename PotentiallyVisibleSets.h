@@ -0,0 +1,53 @@
+#ifndef POTENTIALLYVISIBLESETS_H
+#define POTENTIALLYVISIBLESETS_H
+
+#include <QtGui>
+
+#include "Geometry.h"
+#include "PrecomputeCache.h"
+
+// The field is cut into tileSize x tileSize tiles, and each tile keeps the walls a sight line starting in it can meet first.
+// A wall is left out if some other wall properly crosses every line from the tile's corners to the wall's ends: by convexity
+// it then crosses every line from the tile to the wall, closer to the tile. So the first wall such a line crosses is always
+// in the tile's set, and testing the set gives the same answer as testing all the walls. Parallel and touching walls never
+// hide anything, the sets only get a bit larger. The segments are numbered like the polylines go, polyline by polyline.
+//
+// The sets are built once per map in parallel, one tile per job, and are kept in the PrecomputeCache with the rest of the World.
+class PotentiallyVisibleSets
+{
+public:
+    PotentiallyVisibleSets();
+
+    void build(const QVector<QVector<QPointF> > &walls, int width, int height, int tileSize_ = defaultTileSize);
+    // Follows the edited walls without building the sets again: the sets are renumbered, the new walls are added where they
+    // aren't hidden, and only the walls a removed one could hide are tested again. As exact as build(...), the sets may be a bit larger.
+    void update(const QVector<QVector<QPointF> > &walls);
+
+    // The sets for the walls, from the memory or built on the first request. Safe to call from many threads.
+    static PotentiallyVisibleSets shared(const QVector<QVector<QPointF> > &walls, int width, int height);
+
+    void store(PrecomputeCache::Writer *out, const QByteArray &name) const;
+    bool restore(const PrecomputeCache::Reader &in, const QByteArray &name, const QVector<QVector<QPointF> > &walls, int width, int height);// False if they don't fit the walls
+
+    // The segment numbers that can be hit from p first, NULL outside the field(all the segments have to be tested then)
+    const int *wallsSeenFrom(const QPointF &p, int *count) const;
+    bool hit(const QPointF &a, const QPointF &b) const;// Exact, like testing all the walls, a is the end whose set is used
+
+    bool isEmpty() const { return offsets.isEmpty(); }
+    int segmentCount() const { return segments.size(); }
+    const Segment &segment(int k) const { return segments[k]; }
+    qreal averageSetSize() const { return offsets.size() > 1 ? qreal(indices.size()) / (offsets.size() - 1) : 0.0; }
+
+    static const int defaultTileSize = 32;
+
+private:
+    int tileAt(const QPointF &p) const;// -1 outside the tiles
+    void setWalls(const QVector<QVector<QPointF> > &walls, int width_, int height_, int tileSize_);
+
+    int width, height;
+    int tileSize, tilesx, tilesy;
+    QVector<Segment> segments;
+    QVector<int> offsets, indices;// The set of tile i * tilesy + j is indices[offsets[t]..offsets[t + 1])
+};
+
+#endif //POTENTIALLYVISIBLESETS_H
@@ -0,0 +1,234 @@
+#include <QtGui>
+
+#include <cstdio>
+
+#include "PrecomputeCache.h"
+#include "TraceFormat.h"
+
+namespace
+{
+
+const char magic[4] = {'M', 'E', 'P', 'C'};
+const quint32 version = 3;
+const quint32 byteOrderMark = 0x01020304;
+const int alignment = 16;
+
+QMutex directoryMutex;
+QString cacheDirectory;// Empty if the cache is off
+QAtomicInt tempCounter;// Makes the names of the files being written unique within the process
+
+template <class T>
+void appendRaw(QByteArray *out, const T &v)
+{
+    out->append(reinterpret_cast<const char *>(&v), sizeof(v));
+}
+
+template <class T>
+T readRaw(const uchar *p)
+{
+    T v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+qint64 headerSize(qint64 keySize, qint64 sectionCount)
+{
+    return sizeof(magic) + 4 * sizeof(quint32) + keySize + sectionCount * (PrecomputeCache::nameSize + 2 * sizeof(quint64));
+}
+
+qint64 aligned(qint64 offset)
+{
+    return (offset + alignment - 1) / alignment * alignment;
+}
+
+// By the time they were written, the reads don't touch the files
+void removeOldFiles(const QString &dir)
+{
+    QFileInfoList files = QDir(dir).entryInfoList(QStringList("*.cache"), QDir::Files, QDir::Time);// The newest first
+    for (int i = PrecomputeCache::maxFiles; i < files.size(); i++)
+        QFile::remove(files[i].absoluteFilePath());
+}
+
+}
+
+void PrecomputeCache::Writer::add(const QByteArray &name, const QByteArray &bytes)
+{
+    sections.append(qMakePair(name, bytes));
+}
+
+bool PrecomputeCache::Writer::save(const QByteArray &key) const
+{
+    QString name = fileName(key);
+    if (name.isEmpty())
+        return false;
+
+    QByteArray out(magic, sizeof(magic));
+    appendRaw(&out, version);
+    appendRaw(&out, byteOrderMark);
+    appendRaw(&out, quint32(key.size()));
+    out.append(key);
+    appendRaw(&out, quint32(sections.size()));
+    qint64 offset = aligned(headerSize(key.size(), sections.size()));
+    for (int i = 0; i < sections.size(); i++)
+    {
+        QByteArray sectionName = sections[i].first.left(nameSize);
+        out.append(sectionName);
+        out.append(QByteArray(nameSize - sectionName.size(), '\0'));
+        appendRaw(&out, quint64(offset));
+        appendRaw(&out, quint64(sections[i].second.size()));
+        offset = aligned(offset + sections[i].second.size());
+    }
+    for (int i = 0; i < sections.size(); i++)
+    {
+        out.append(QByteArray(int(aligned(out.size()) - out.size()), '\0'));
+        out.append(sections[i].second);
+    }
+
+    QFileInfo info(name);
+    if (!QDir().mkpath(info.absolutePath()))
+        return false;
+    QString tempName = name + QString(".%1.%2.tmp").arg(QCoreApplication::applicationPid()).arg(tempCounter.fetchAndAddOrdered(1));
+    QFile file(tempName);
+    if (!file.open(QIODevice::WriteOnly) || file.write(out) != out.size())
+    {
+        file.close();
+        QFile::remove(tempName);
+        return false;
+    }
+    file.close();
+    // Replaces a broken file or the same one another thread was faster to write. QFile::rename doesn't replace files,
+    // std::rename does it atomically on POSIX, so the readers see either file. Where it fails the old file stays.
+    if (std::rename(QFile::encodeName(tempName).constData(), QFile::encodeName(name).constData()) != 0)
+        QFile::remove(tempName);
+    removeOldFiles(info.absolutePath());
+    return true;
+}
+
+PrecomputeCache::Reader::Reader():
+    data(NULL)
+{
+}
+
+PrecomputeCache::Reader::~Reader()
+{
+    close();
+}
+
+void PrecomputeCache::Reader::close()
+{
+    if (data != NULL)
+        file.unmap(const_cast<uchar *>(data));
+    data = NULL;
+    file.close();
+    sections.clear();
+}
+
+bool PrecomputeCache::Reader::open(const QByteArray &key)
+{
+    close();
+    QString name = fileName(key);
+    if (name.isEmpty())
+        return false;
+    file.setFileName(name);
+    if (!file.open(QIODevice::ReadOnly))
+        return false;
+    qint64 size = file.size();
+    if (size < headerSize(key.size(), 0) || (data = file.map(0, size)) == NULL)
+    {
+        close();
+        return false;
+    }
+
+    const uchar *p = data + sizeof(magic);
+    if (memcmp(data, magic, sizeof(magic)) != 0 || readRaw<quint32>(p) != version || readRaw<quint32>(p + 4) != byteOrderMark ||
+        readRaw<quint32>(p + 8) != quint32(key.size()) || memcmp(p + 12, key.constData(), key.size()) != 0)
+    {
+        close();
+        return false;
+    }
+    p += 12 + key.size();
+    quint32 count = readRaw<quint32>(p);
+    p += 4;
+    if (count > quint32(size) || headerSize(key.size(), count) > size)
+    {
+        close();
+        return false;
+    }
+    for (quint32 i = 0; i < count; i++, p += nameSize + 2 * sizeof(quint64))
+    {
+        QByteArray sectionName(reinterpret_cast<const char *>(p), nameSize);
+        sectionName.truncate(sectionName.indexOf('\0') >= 0 ? sectionName.indexOf('\0') : nameSize);
+        quint64 offset = readRaw<quint64>(p + nameSize), length = readRaw<quint64>(p + nameSize + 8);
+        if (offset > quint64(size) || length > quint64(size) - offset)
+        {
+            close();
+            return false;
+        }
+        sections.insert(sectionName, qMakePair(qint64(offset), qint64(length)));
+    }
+    return true;
+}
+
+bool PrecomputeCache::Reader::read(const QByteArray &name, QByteArray *bytes) const
+{
+    if (data == NULL || !sections.contains(name))
+        return false;
+    QPair<qint64, qint64> section = sections.value(name);
+    *bytes = QByteArray(reinterpret_cast<const char *>(data + section.first), int(section.second));
+    return true;
+}
+
+void PrecomputeCache::setDirectory(const QString &dir)
+{
+    QMutexLocker locker(&directoryMutex);
+    cacheDirectory = dir;
+}
+
+QString PrecomputeCache::directory()
+{
+    QMutexLocker locker(&directoryMutex);
+    return cacheDirectory;
+}
+
+QString PrecomputeCache::defaultDirectory()
+{
+    QByteArray env = qgetenv("MAPEXPLORATION_CACHE");
+    if (!env.isNull())
+        return QString::fromLocal8Bit(env.constData());
+    return QDir::home().filePath(".mapexploration/cache");
+}
+
+QByteArray PrecomputeCache::key(const QVector<QVector<QPointF> > &walls, int width, int height, qreal cellSize, qreal pivotOffset, qreal radius)
+{
+    QByteArray bytes;
+    TraceFormat::writeVarint(&bytes, width);
+    TraceFormat::writeVarint(&bytes, height);
+    TraceFormat::writeReal(&bytes, cellSize);
+    TraceFormat::writeReal(&bytes, pivotOffset);
+    TraceFormat::writeReal(&bytes, radius);
+    TraceFormat::writeVarint(&bytes, walls.size());
+    for (int i = 0; i < walls.size(); i++)
+    {
+        TraceFormat::writeVarint(&bytes, walls[i].size());
+        for (int k = 0; k < walls[i].size(); k++)
+        {
+            TraceFormat::writeReal(&bytes, walls[i][k].x());
+            TraceFormat::writeReal(&bytes, walls[i][k].y());
+        }
+    }
+    return bytes;
+}
+
+QString PrecomputeCache::fileName(const QByteArray &key)
+{
+    QString dir = directory();
+    if (dir.isEmpty())
+        return QString();
+    quint64 hash = Q_UINT64_C(14695981039346656037);// FNV-1a, like mapHash
+    for (int i = 0; i < key.size(); i++)
+    {
+        hash ^= quint8(key[i]);
+        hash *= Q_UINT64_C(1099511628211);
+    }
+    return QDir(dir).filePath(QString("%1.cache").arg(hash, 16, 16, QChar('0')));
+}
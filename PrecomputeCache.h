@@ -0,0 +1,122 @@
+#ifndef PRECOMPUTECACHE_H
+#define PRECOMPUTECACHE_H
+
+#include <QtGui>
+
+#include <cstring>
+
+// What World builds for a map(the distance fields, the potentially visible sets, the grown walls, the free space links
+// and the pivots) kept in a directory, so a map opened before is ready at once, in the window and in every batch run.
+// A file holds the structures for one key: the walls, the field size, the cell size, the pivot offset and the robot radius(see key(...)).
+// The file is named after the key's hash, and keeps the key itself to tell the keys with the same hash apart.
+//
+// The file is a set of named sections with raw arrays of scalars, as they lie in the memory(the structs are serialized
+// by their owners, padding isn't written). It's mapped, and the arrays are copied straight out of it: magic, version,
+// the byte order mark(uint32 0x01020304, the files aren't portable), the key size(uint32) and the key,
+// the section count(uint32), then for each section its name(32 bytes, zero padded), offset and size(uint64),
+// then the sections, each starting at a multiple of 16 bytes. A file with another version, byte order or key is ignored.
+// The files are written aside and renamed over the old ones, which replaces them atomically where the system allows it
+// (elsewhere the file already there is kept), so the batch threads may race to write the same one.
+// Only the maxFiles written last are kept, a file that is only read gets older all the same.
+class PrecomputeCache
+{
+public:
+    class Writer
+    {
+    public:
+        template <class T> void add(const QByteArray &name, const QVector<T> &items);// T must be a plain struct
+        template <class T> void add(const QByteArray &name, const QVector<QVector<T> > &lists);// As the items and the list sizes
+        void add(const QByteArray &name, const QByteArray &bytes);// Serialized by the caller
+        bool save(const QByteArray &key) const;// False if the cache is off or the file can't be written
+
+    private:
+        QList<QPair<QByteArray, QByteArray> > sections;
+    };
+
+    class Reader
+    {
+    public:
+        Reader();
+        ~Reader();
+
+        bool open(const QByteArray &key);// False if the cache is off or has no valid file for the key
+        template <class T> bool read(const QByteArray &name, QVector<T> *items) const;// False if there's no such section, or its size doesn't fit T
+        template <class T> bool read(const QByteArray &name, QVector<QVector<T> > *lists) const;
+        bool read(const QByteArray &name, QByteArray *bytes) const;
+
+    private:
+        Reader(const Reader &);
+        Reader &operator=(const Reader &);
+        void close();
+
+        QFile file;
+        const uchar *data;// The mapped file, NULL if it isn't open
+        QHash<QByteArray, QPair<qint64, qint64> > sections;// Offset and size by name
+    };
+
+    static void setDirectory(const QString &dir);// The cache is off until this is called, or if dir is empty
+    static QString directory();
+    static QString defaultDirectory();// $MAPEXPLORATION_CACHE if set(empty turns the cache off), ~/.mapexploration/cache otherwise
+
+    // All the walls' points and the parameters, exact
+    static QByteArray key(const QVector<QVector<QPointF> > &walls, int width, int height, qreal cellSize, qreal pivotOffset, qreal radius);
+
+    static const int maxFiles = 64;
+    static const int nameSize = 32;
+
+private:
+    static QString fileName(const QByteArray &key);
+};
+
+template <class T>
+void PrecomputeCache::Writer::add(const QByteArray &name, const QVector<T> &items)
+{
+    add(name, QByteArray(reinterpret_cast<const char *>(items.constData()), items.size() * int(sizeof(T))));
+}
+
+template <class T>
+void PrecomputeCache::Writer::add(const QByteArray &name, const QVector<QVector<T> > &lists)
+{
+    QVector<int> sizes;
+    QVector<T> items;
+    for (int i = 0; i < lists.size(); i++)
+    {
+        sizes.append(lists[i].size());
+        items += lists[i];
+    }
+    add(name + ".sizes", sizes);
+    add(name, items);
+}
+
+template <class T>
+bool PrecomputeCache::Reader::read(const QByteArray &name, QVector<QVector<T> > *lists) const
+{
+    QVector<int> sizes;
+    QVector<T> items;
+    if (!read(name + ".sizes", &sizes) || !read(name, &items))
+        return false;
+    lists->clear();
+    for (int i = 0, from = 0; i < sizes.size(); from += sizes[i++])
+    {
+        if (sizes[i] < 0 || sizes[i] > items.size() - from)
+            return false;
+        lists->append(items.mid(from, sizes[i]));
+    }
+    return true;
+}
+
+template <class T>
+bool PrecomputeCache::Reader::read(const QByteArray &name, QVector<T> *items) const
+{
+    if (data == NULL || !sections.contains(name))
+        return false;
+    QPair<qint64, qint64> section = sections.value(name);
+    if (section.second % qint64(sizeof(T)) != 0)
+        return false;
+    items->resize(int(section.second / qint64(sizeof(T))));
+    if (!items->isEmpty())
+        memcpy(items->data(), data + section.first, size_t(section.second));
+    return true;
+}
+
+#endif //PRECOMPUTECACHE_H
@@ -0,0 +1,58 @@
+#ifndef RANDOM_H
+#define RANDOM_H
+
+#include <QtGlobal>
+
+// xoshiro256** by Blackman and Vigna. Every user keeps its own generator with an explicit seed, so several
+// simulations can run in one process (and in parallel) and still be reproducible, unlike with qsrand()/qrand().
+class Random
+{
+public:
+    explicit Random(quint64 seed = 0) { setSeed(seed); }
+
+    void setSeed(quint64 seed)// The state is filled by splitmix64, as the authors recommend, so any seed is fine
+    {
+        for (int i = 0; i < 4; i++)
+        {
+            seed += Q_UINT64_C(0x9E3779B97F4A7C15);
+            quint64 z = seed;
+            z = (z ^ (z >> 30)) * Q_UINT64_C(0xBF58476D1CE4E5B9);
+            z = (z ^ (z >> 27)) * Q_UINT64_C(0x94D049BB133111EB);
+            s[i] = z ^ (z >> 31);
+        }
+    }
+
+    // The whole state, to save a run and continue it later exactly where it was
+    quint64 state(int i) const { return s[i]; }
+    void setState(int i, quint64 v) { s[i] = v; }
+
+    quint64 next()
+    {
+        quint64 result = rotl(s[1] * 5, 7) * 9;
+        quint64 t = s[1] << 17;
+        s[2] ^= s[0];
+        s[3] ^= s[1];
+        s[1] ^= s[2];
+        s[0] ^= s[3];
+        s[2] ^= t;
+        s[3] = rotl(s[3], 45);
+        return result;
+    }
+
+    int bounded(int n)// In [0, n), n > 0. Lemire's multiply-shift on the high 32 bits, the bias is negligible for our n.
+    {
+        return int(((next() >> 32) * quint64(n)) >> 32);
+    }
+
+    qreal uniform()// In [0, 1)
+    {
+        return (next() >> 11) * (1.0 / (Q_UINT64_C(1) << 53));
+    }
+
+private:
+    static quint64 rotl(quint64 x, int k) { return (x << k) | (x >> (64 - k)); }
+
+    quint64 s[4];
+};
+
+#endif //RANDOM_H
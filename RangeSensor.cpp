@@ -0,0 +1,133 @@
+#include <QtGui>
+
+#include <cmath>
+
+#include "RangeSensor.h"
+#include "Arena.h"
+
+namespace
+{
+
+const int beamBlock = 256;// The beams tested against all the walls at once, their arrays stay in the L1 cache
+
+}
+
+qreal RangeScan::step() const
+{
+    if (beams() < 2)
+        return 0.0;
+    return span >= 2 * PI() ? span / beams() : span / (beams() - 1);// The full circle doesn't repeat the first beam
+}
+
+bool RangeScan::covers(const Vec2 &p) const
+{
+    Vec2 v = p - origin;
+    qreal lenSq = v.lengthSquared();
+    if (lenSq >= maxRange * maxRange || reach.isEmpty())
+        return false;
+    if (lenSq == 0)
+        return true;
+    int bin = int(v.pseudoAngleFrom(directions[0]) * binsPerUnit);
+    return bin < reach.size() && lenSq < reach[bin];
+}
+
+void RangeScan::buildLookup()
+{
+    reach.clear();
+    if (beams() < 2)
+        return;
+    // The pseudo-angle grows at least half as fast as the angle, so the bins are about half a step wide at most
+    binsPerUnit = 2.0 / step();
+    bool circle = span >= 2 * PI();
+    qreal end = circle ? 4.0 : directions.back().pseudoAngleFrom(directions[0]);
+    reach.fill(-1.0, int(end * binsPerUnit) + 1);
+    qreal from = 0.0;
+    for (int k = 0; k < (circle ? beams() : beams() - 1); k++)
+    {
+        int next = (k + 1) % beams();
+        qreal to = next == 0 ? end : directions[next].pseudoAngleFrom(directions[0]);
+        qreal shortest = qMin(ranges[k], ranges[next]);
+        for (int bin = int(from * binsPerUnit); bin <= qMin(int(to * binsPerUnit), reach.size() - 1); bin++)
+            reach[bin] = reach[bin] < 0 ? shortest * shortest : qMin(reach[bin], shortest * shortest);
+        from = to;
+    }
+}
+
+RangeSensor::RangeSensor(int beams_, qreal span_, qreal maxRange_):
+    spanAngle(span_), range(maxRange_)
+{
+    RangeScan layout;
+    layout.heading = 0.0;
+    layout.span = spanAngle;
+    layout.ranges.resize(qMax(1, beams_));
+    for (int b = 0; b < layout.beams(); b++)
+        offsets.append(Vec2::fromAngle(layout.beamAngle(b)));
+}
+
+void RangeSensor::scan(const PotentiallyVisibleSets &walls, const QPointF &origin, qreal heading, RangeScan *out) const
+{
+    out->origin = origin;
+    out->heading = heading;
+    out->span = spanAngle;
+    out->maxRange = range;
+    out->ranges.resize(beams());
+    out->directions.resize(beams());
+
+    ArenaScope scope;
+    int count = 0;
+    const int *seen = walls.wallsSeenFrom(origin, &count);
+    if (seen == NULL)
+        count = walls.segmentCount();
+    // Each wall as a + u * e for u in [0, 1], relative to the origin, and a x e which doesn't depend on the beam
+    ArenaVector<qreal> ax(count), ay(count), ex(count), ey(count), axe(count);
+    Vec2 o(origin);
+    for (int n = 0; n < count; n++)
+    {
+        const Segment &s = walls.segment(seen != NULL ? seen[n] : n);
+        ax[n] = s.a.x - o.x;
+        ay[n] = s.a.y - o.y;
+        ex[n] = s.b.x - s.a.x;
+        ey[n] = s.b.y - s.a.y;
+        axe[n] = ax[n] * ey[n] - ay[n] * ex[n];
+    }
+
+    Vec2 dir = Vec2::fromAngle(heading);
+    ArenaVector<qreal> dx(beams()), dy(beams());
+    for (int b = 0; b < beams(); b++)
+    {
+        // fromAngle(heading + offset) as the product of the two rotations
+        dx[b] = dir.x * offsets[b].x - dir.y * offsets[b].y;
+        dy[b] = dir.x * offsets[b].y + dir.y * offsets[b].x;
+        out->directions[b] = Vec2(dx[b], dy[b]);
+    }
+
+    // The nearest hit of each beam is kept as the fraction num / den, so the loop below doesn't divide.
+    // Plain pointers, so the compiler sees the arrays don't move while they are written.
+    ArenaVector<qreal> nums(beams(), range), dens(beams(), 1.0);
+    qreal *num = nums.data(), *den = dens.data();
+    const qreal *bx = dx.data(), *by = dy.data();
+    for (int first = 0; first < beams(); first += beamBlock)
+    {
+        int last = qMin(first + beamBlock, beams());
+        for (int n = 0; n < count; n++)
+        {
+            const qreal wax = ax[n], way = ay[n], wex = ex[n], wey = ey[n], waxe = axe[n];
+            for (int b = first; b < last; b++)
+            {
+                // origin + t * d = a + u * e gives t = (a x e) / (d x e) and u = (a x d) / (d x e), the signs are flipped
+                // to make d x e positive. Touching counts like in Segment::intersects, parallel walls(d x e == 0) never hit.
+                qreal nearNum = num[b], nearDen = den[b];
+                qreal d = bx[b] * wey - by[b] * wex;
+                qreal sign = std::copysign(1.0, d);
+                qreal wd = d * sign, tn = waxe * sign, un = (wax * by[b] - way * bx[b]) * sign;
+                bool hit = (wd > 0) & (tn >= 0) & (un >= 0) & (un <= wd) & (tn * nearDen < nearNum * wd);
+                num[b] = hit ? tn : nearNum;
+                den[b] = hit ? wd : nearDen;
+            }
+        }
+    }
+    qreal *ranges = out->ranges.data();
+    for (int b = 0; b < beams(); b++)
+        ranges[b] = num[b] / den[b];
+    out->buildLookup();
+}
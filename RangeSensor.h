@@ -0,0 +1,57 @@
+#ifndef RANGESENSOR_H
+#define RANGESENSOR_H
+
+#include <QtGui>
+
+#include "Geometry.h"
+#include "PotentiallyVisibleSets.h"
+
+// One sweep of the range sensor: the beams go evenly from heading - span / 2 to heading + span / 2(all around for a full circle).
+struct RangeScan
+{
+    Vec2 origin;
+    qreal heading, span, maxRange;
+    QVector<qreal> ranges;// By beam, the distance to the first wall, maxRange if none is that close
+    QVector<Vec2> directions;// By beam, the unit vectors
+
+    RangeScan(): heading(0.0), span(0.0), maxRange(0.0), binsPerUnit(0.0) {}
+
+    int beams() const { return ranges.size(); }
+    qreal step() const;// The angle between the neighbouring beams
+    qreal beamAngle(int beam) const { return heading - span / 2 + beam * step(); }
+    Vec2 endPoint(int beam) const { return origin + directions[beam] * ranges[beam]; }
+    bool isHit(int beam) const { return ranges[beam] < maxRange; }
+
+    // p is inside the span and closer than both beams around it, so nothing the scan knows of is in the way.
+    // For the grid nodes: with the beams closer than a node apart at maxRange it's what the sight lines would tell.
+    // Looked up by p's pseudo-angle(see Vec2::pseudoAngleFrom), a bin keeps the shortest of the beams around it,
+    // so a point may be refused near a hit a bin away, or taken a bin past the span's edges.
+    bool covers(const Vec2 &p) const;
+    void buildLookup();// After the ranges and the directions are set, RangeSensor::scan does it
+
+private:
+    QVector<qreal> reach;// The squared distance covered, by bin of the pseudo-angle from the first beam up to the last one
+    qreal binsPerUnit;
+};
+
+// A simulated lidar. A scan casts all the beams against the walls the origin's tile can see first(see PotentiallyVisibleSets),
+// so the nearest hit among them is the nearest one among all the walls. The set and the beams are copied into flat arrays
+// once per scan, then each wall is tested against a block of beams in a loop without branches or divisions, which the compiler
+// vectorizes(see the release flags in mapexploration.pro). 16k beams take about a millisecond on the example maps.
+class RangeSensor
+{
+public:
+    RangeSensor(int beams_, qreal span_, qreal maxRange_);
+
+    int beams() const { return offsets.size(); }
+    qreal span() const { return spanAngle; }
+    qreal maxRange() const { return range; }
+
+    void scan(const PotentiallyVisibleSets &walls, const QPointF &origin, qreal heading, RangeScan *out) const;
+
+private:
+    qreal spanAngle, range;
+    QVector<Vec2> offsets;// The beams' directions for heading 0, turned to the heading with one rotation per scan
+};
+
+#endif //RANGESENSOR_H
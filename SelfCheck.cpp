@@ -0,0 +1,470 @@
+#include <QtGui>
+
+#include <limits>
+#include <queue>
+#include <functional>
+
+#include "SelfCheck.h"
+#include "World.h"
+#include "DistanceField.h"
+#include "Geometry.h"
+#include "Random.h"
+#include "tools.h"
+#include "ExplorationEngine.h"
+#include "VisibilityGraphPlanner.h"
+#include "HierarchicalPlanner.h"
+
+namespace
+{
+
+const int fieldWidth = 900, fieldHeight = 600;// The same as the main window uses
+const int fieldEdits = 40;// Per map
+const int fieldProbes = 2000;// Points and segments per edit
+const int snapshotTicks = 150;// Before the snapshot and after it
+const int labelTicks = 3000, labelCheckEvery = 300;
+const int graphTicks = 300;// The exploration is under way, there are virtual walls
+const int graphQueries = 5;// Per map
+
+QStringList defaultMaps()
+{
+    QDir dir("map-examples");
+    QStringList names = dir.entryList(QStringList() << "*.map", QDir::Files, QDir::Name);
+    QStringList files;
+    for (int i = 0; i < names.size(); i++)
+        files << dir.filePath(names[i]);
+    return files;
+}
+
+bool report(QTextStream &out, const QString &name, bool ok, const QString &details = QString())
+{
+    out << (ok ? "ok     " : "FAILED ") << name;
+    if (!details.isEmpty())
+        out << " (" << details << ")";
+    out << endl;
+    return ok;
+}
+
+void discoverAll(World *world)
+{
+    for (int i = 0; i < world->isDiscovered.size(); i++)
+        world->isDiscovered[i].fill(true);
+    world->syncDiscoveryTree();
+}
+
+// A 45 degree wall through the square corners: the squares it only touches at the corners must be blocked too,
+// otherwise a sight line crossing it at a corner goes through. The start pose's corner against the field edges is let through.
+bool checkDiagonalWall(QTextStream &out)
+{
+    World world(fieldWidth, fieldHeight, QVector<QVector<QPointF> >(), 8.0);
+    QVector<QVector<QPointF> > walls(1);
+    walls[0] << QPointF(5.5, 5.5) * world.cellSize << QPointF(15.5, 15.5) * world.cellSize;// Corner to corner of the squares
+    world.setWalls(walls);
+    world.commitWalls();
+    discoverAll(&world);
+
+    int gaps = 0;
+    for (int k = 7; k < 16; k++)// The corners inside the wall
+    {
+        if (!world.wallSquares[k][k - 1] || !world.wallSquares[k - 1][k])
+            gaps++;
+    }
+    int leaks = 0;
+    for (int k = 8; k < 14; k++)// Across the wall, exactly through the corner (k, k)
+    {
+        QPointF a = world.cellSize * QPointF(k - 2, k + 1), b = world.cellSize * QPointF(k + 1, k - 2);
+        if (world.gridLineOfSight(a, b) || world.gridLineOfSight(b, a))
+            leaks++;
+    }
+    bool start = world.gridLineOfSight(QPointF(1, 1), world.cellSize * QPointF(4, 4));// Along the field edges' corner
+    return report(out, "45 degree wall rasterization", gaps == 0 && leaks == 0 && start,
+                  QString("%1 gaps, %2 sight lines through it, start corner %3").arg(gaps).arg(leaks).arg(start ? "clear" : "blocked"));
+}
+
+QPointF randomPoint(Random *random)
+{
+    return QPointF(random->uniform() * fieldWidth, random->uniform() * fieldHeight);
+}
+
+// Adds a random polyline, removes a wall(leaving an empty one, like World::removeWall) or moves one. The field edges stay.
+void editRandomly(QVector<QVector<QPointF> > *walls, Random *random)
+{
+    int kind = random->bounded(3), index = random->bounded(walls->size() - 1);
+    if (kind == 0 || walls->size() == 1)
+    {
+        QVector<QPointF> wall;
+        QPointF p = randomPoint(random);
+        for (int n = random->bounded(3) + 2; n > 0; n--)
+        {
+            wall << p;
+            p += QPointF(random->uniform() * 200 - 100, random->uniform() * 200 - 100);
+        }
+        walls->insert(walls->size() - 1, wall);
+    }
+    else if (kind == 1)
+    {
+        (*walls)[index].clear();
+    }
+    else
+    {
+        QPointF offset(random->uniform() * 40 - 20, random->uniform() * 40 - 20);
+        for (int k = 0; k < (*walls)[index].size(); k++)
+            (*walls)[index][k] += offset;
+    }
+}
+
+qreal exactDistance(const QVector<Segment> &segments, const Vec2 &p)
+{
+    qreal best = std::numeric_limits<qreal>::max();
+    for (int k = 0; k < segments.size(); k++)
+    {
+        Vec2 d = segments[k].b - segments[k].a;
+        qreal t = d.lengthSquared() > 0 ? qBound(qreal(0.0), (p - segments[k].a).dot(d) / d.lengthSquared(), qreal(1.0)) : 0.0;
+        best = qMin(best, (p - (segments[k].a + d * t)).length());
+    }
+    return best;
+}
+
+// DistanceField::update after random edits against build(...) from scratch and against the exact distance to all the walls:
+// the incremental field may pick another nearest wall than the full one, but must stay within errorBound() of the truth,
+// keep the sign away from the walls, and its hit(...) must be exact.
+bool checkDistanceFieldUpdates(QTextStream &out, const QStringList &files)
+{
+    Random random(35);
+    int probes = 0, outOfBound = 0, wrongSign = 0, wrongHits = 0;
+    qreal maxDifference = 0.0;
+    for (int f = 0; f < files.size(); f++)
+    {
+        QVector<QVector<QPointF> > walls = World::withFieldEdges(getMapFromFile(files[f]), fieldWidth, fieldHeight);
+        qreal resolution = 2.0;// World's cellSize / 4
+        DistanceField field;
+        field.build(walls, fieldWidth, fieldHeight, resolution);
+        for (int edit = 0; edit < fieldEdits; edit++)
+        {
+            editRandomly(&walls, &random);
+            field.update(walls);
+            DistanceField full;
+            full.build(walls, fieldWidth, fieldHeight, resolution);
+            QVector<Segment> segments;
+            for (int i = 0; i < walls.size(); i++)
+            {
+                for (int j = 0; j + 1 < walls[i].size(); j++)
+                    segments.append(Segment(walls[i][j], walls[i][j + 1]));
+            }
+
+            for (int n = 0; n < fieldProbes; n++, probes++)
+            {
+                QPointF p = randomPoint(&random), q = randomPoint(&random);
+                qreal exact = exactDistance(segments, p), updated = field.distance(p), built = full.distance(p);
+                if (qAbs(updated) < exact - 1e-9 || qAbs(updated) > exact + field.errorBound())
+                    outOfBound++;
+                if (exact > field.errorBound() && (updated < 0) != (built < 0))
+                    wrongSign++;
+                maxDifference = qMax(maxDifference, qAbs(qAbs(updated) - qAbs(built)));
+
+                bool hit = false;
+                for (int k = 0; k < segments.size() && !hit; k++)
+                    hit = Segment(p, q).intersects(segments[k]);
+                if (field.hit(p, q) != hit)
+                    wrongHits++;
+            }
+        }
+    }
+    return report(out, "distance field updates", probes > 0 && outOfBound == 0 && wrongSign == 0 && wrongHits == 0,
+                  QString("%1 probes after %2 edits: %3 out of the error bound, %4 with the wrong sign, %5 wrong hits, at most %6 px from the full build")
+                  .arg(probes).arg(fieldEdits * files.size()).arg(outOfBound).arg(wrongSign).arg(wrongHits).arg(maxDifference, 0, 'f', 3));
+}
+
+// A run with edited walls and a robot radius is saved, restored into a fresh engine for the same map and both go on:
+// they must stay in the same places, and a snapshot restored into an engine for another map must be refused.
+bool checkSnapshots(QTextStream &out, const QStringList &files)
+{
+    int diverged = 0, refused = 0, accepted = 0;
+    for (int f = 0; f < files.size(); f++)
+    {
+        QVector<QVector<QPointF> > map = getMapFromFile(files[f]);
+        ExplorationEngine saved(fieldWidth, fieldHeight, map);
+        for (int t = 0; t < snapshotTicks; t++)
+            saved.tick();
+        QVector<QPointF> wall;
+        wall << QPointF(fieldWidth / 3, fieldHeight / 2) << QPointF(fieldWidth / 2, fieldHeight / 3);
+        saved.addWall(wall);
+        if (!map.isEmpty())
+            saved.removeWall(0);
+        saved.setRobotRadius(5.0);
+        saved.tick();
+        QByteArray snapshot = saved.saveSnapshot();
+
+        ExplorationEngine restored(fieldWidth, fieldHeight, map);
+        if (!restored.restoreSnapshot(snapshot))
+        {
+            refused++;
+            continue;
+        }
+        for (int t = 0; t < snapshotTicks; t++)
+        {
+            saved.tick();
+            restored.tick();
+            if (saved.getPos() != restored.getPos())
+            {
+                diverged++;
+                break;
+            }
+        }
+        if (saved.saveSnapshot() != restored.saveSnapshot())
+            diverged++;
+
+        ExplorationEngine other(fieldWidth, fieldHeight, getMapFromFile(files[(f + 1) % files.size()]));
+        if (files.size() > 1 && other.restoreSnapshot(snapshot))
+            accepted++;
+    }
+    return report(out, "snapshots with edited walls and radius", diverged == 0 && refused == 0 && accepted == 0,
+                  QString("%1 maps: %2 runs diverged after restoring, %3 snapshots refused, %4 accepted by another map")
+                  .arg(files.size()).arg(diverged).arg(refused).arg(accepted));
+}
+
+// The runs of every planner on the maps. Every labelCheckEvery ticks: no discovered node FreeSpaceLabels puts out of reach
+// may have a path to it, and the frontier kept by FreeSpaceLabels must say the same as a scan of all the nodes.
+// When a run is complete, no node next to an unknown pocket may have a path to it.
+bool checkFreeSpaceLabels(QTextStream &out, const QStringList &files)
+{
+    int unreachable = 0, paths = 0, frontiers = 0, completed = 0, leftBehind = 0;
+    for (int f = 0; f < files.size(); f++)
+    {
+        QVector<QVector<QPointF> > map = getMapFromFile(files[f]);
+        int planners = 1;
+        for (int planner = 0; planner < planners; planner++)
+        {
+            ExplorationEngine engine(fieldWidth, fieldHeight, map);
+            engine.setPlanner(planner);
+            planners = engine.plannerNames().size();
+            const World &world = engine.getWorld();
+            int minNodes = qCeil(world.minPocketArea / (world.cellSize * world.cellSize));
+            for (int t = 1; t <= labelTicks && !engine.isComplete(); t++)
+            {
+                engine.tick();
+                if (t % labelCheckEvery != 0 && !engine.isComplete())
+                    continue;
+                int reach = world.freeSpaceAt(engine.getPos());
+                bool frontier = false;
+                for (int i = 0; i < world.isDiscovered.size(); i++)
+                {
+                    for (int j = 0; j < world.isDiscovered[i].size(); j++)
+                    {
+                        bool inReach = reach == -1 || world.freeSpace.label(i, j) == reach;
+                        frontier = frontier || (inReach && world.freeSpace.bordersUnknown(i, j, minNodes));
+                        bool check = engine.isComplete() ? world.freeSpace.bordersUnknown(i, j, minNodes) : !inReach;
+                        if (!world.isDiscovered[i][j] || !check)
+                            continue;
+                        bool found = !engine.getPlanner()->getPath(engine.getPos(), world.cellSize * QPointF(i, j)).isEmpty();
+                        if (engine.isComplete())
+                        {
+                            leftBehind += found;
+                        }
+                        else
+                        {
+                            unreachable++;
+                            paths += found;
+                        }
+                    }
+                }
+                frontiers += frontier != world.freeSpace.hasFrontier(reach, minNodes);
+            }
+            completed += engine.isComplete();
+        }
+    }
+    return report(out, "free space labels against the planners", paths == 0 && frontiers == 0 && leftBehind == 0,
+                  QString("%1 nodes out of reach: %2 with a path, %3 frontiers differ from the scan, %4 complete runs left %5 reachable frontier nodes")
+                  .arg(unreachable).arg(paths).arg(frontiers).arg(completed).arg(leftBehind));
+}
+
+// Both sides of every corner of the polyline, as the pivots were made before only the reflex ones were kept.
+// The ends get the same points as in World::getPivots.
+void everyCornerPivots(const World &world, const QVector<QPointF> &v, QVector<QPointF> *points)
+{
+    QVector<World::Pivot> pivots;
+    world.getPivots(v, true, &pivots);// The ends, and the reflex side of the corners
+    for (int k = 0; k < pivots.size(); k++)
+    {
+        points->append(pivots[k].pos);
+        if (pivots[k].isCorner)
+            points->append(2 * pivots[k].vertex - pivots[k].pos);// The other side
+    }
+}
+
+bool isClear(const World &world, const DistanceField &virtualField, const QPointF &a, const QPointF &b)
+{
+    return !world.wallOnPath(a, b) && !virtualField.hit(a, b);
+}
+
+// A* over all the points, any pair may be an edge, tested when it's about to be relaxed. -1 if there's no path.
+qreal shortestPath(const World &world, const DistanceField &virtualField, const QVector<QPointF> &points, int start, int target)
+{
+    int n = points.size();
+    QVector<qreal> g(n, std::numeric_limits<qreal>::max());
+    QVector<bool> closed(n, false);
+    typedef QPair<qreal, int> Entry;// (g + h, point)
+    std::priority_queue<Entry, std::vector<Entry>, std::greater<Entry> > open;
+    g[start] = 0;
+    open.push(qMakePair(distance(points[start], points[target]), start));
+    while (!open.empty())
+    {
+        int top = open.top().second;
+        open.pop();
+        if (top == target)
+            return g[target];
+        if (closed[top])
+            continue;
+        closed[top] = true;
+        for (int next = 0; next < n; next++)
+        {
+            qreal newG = g[top] + distance(points[top], points[next]);
+            if (closed[next] || newG >= g[next] || !isClear(world, virtualField, points[top], points[next]))
+                continue;
+            g[next] = newG;
+            open.push(qMakePair(newG + distance(points[next], points[target]), next));
+        }
+    }
+    return -1.0;
+}
+
+qreal pathLength(const QVector<QPointF> &path)
+{
+    qreal length = 0.0;
+    for (int i = 0; i + 1 < path.size(); i++)
+        length += distance(path[i], path[i + 1]);
+    return path.isEmpty() ? -1.0 : length;
+}
+
+// The visibility graph keeps only the reflex pivots and the bitangent edges. The paths must be as short as over both
+// sides of every corner with all the clear edges, in the middle of the exploration, with the virtual walls. The pivots
+// stand pivotOffset off the corners, so neither graph is exact: the other sides may shave a pixel off a long path,
+// a lost corner costs more than that. The sizes of both graphs are reported, the edges as the eager planner builds
+// them for the last query.
+bool checkReducedGraph(QTextStream &out, const QStringList &files)
+{
+    Random random(26);
+    int queries = 0, longer = 0, missed = 0;
+    qreal maxExcess = 0.0;
+    qint64 allPoints = 0, reflexPoints = 0, allEdges = 0, bitangentEdges = 0;
+    for (int f = 0; f < files.size(); f++)
+    {
+        ExplorationEngine engine(fieldWidth, fieldHeight, getMapFromFile(files[f]));
+        for (int t = 0; t < graphTicks; t++)
+            engine.tick();
+        const World &world = engine.getWorld();
+        DistanceField virtualField;
+        virtualField.build(world.virtualWalls, fieldWidth, fieldHeight, world.cellSize / 4, false);
+
+        QVector<QPointF> points;
+        for (int i = 0; i < world.obstacles.size(); i++)
+            everyCornerPivots(world, world.obstacles[i], &points);
+        for (int i = 0; i < world.virtualWalls.size(); i++)
+            everyCornerPivots(world, world.virtualWalls[i], &points);
+        QPointF start = engine.getPos();
+        points << start << start;// The target is set for each query
+        allPoints += points.size();
+        reflexPoints += world.mapPivots.size() + world.virtualPivots.size() + 2;
+
+        VisibilityGraphPlanner planner(world), eager(world, false);
+        QPointF target;
+        for (int q = 0; q < graphQueries; q++)
+        {
+            // A discovered node out of sight, the straight line says nothing about the graph
+            for (int tries = 0; tries < 1000 && (tries == 0 || isClear(world, virtualField, start, target)); tries++)
+            {
+                int i = random.bounded(world.isDiscovered.size()), j = random.bounded(world.isDiscovered[0].size());
+                if (world.isDiscovered[i][j])
+                    target = world.cellSize * QPointF(i, j);
+            }
+            points.back() = target;
+            qreal reduced = pathLength(planner.getPath(start, target));
+            qreal full = shortestPath(world, virtualField, points, points.size() - 2, points.size() - 1);
+            queries++;
+            if ((reduced < 0) != (full < 0))
+            {
+                missed++;
+            }
+            else if (reduced > full)
+            {
+                maxExcess = qMax(maxExcess, reduced - full);
+                longer += reduced - full > world.pivotOffset / 8;
+            }
+        }
+
+        ArenaScope scope;
+        VisibilityGraphPlanner::Graph graph;
+        eager.getGraph(start, target, &graph);
+        bitangentEdges += graph.edges.size() / 2;
+        for (int a = 0; a < points.size(); a++)
+        {
+            for (int b = a + 1; b < points.size(); b++)
+                allEdges += isClear(world, virtualField, points[a], points[b]);
+        }
+    }
+    return report(out, "reduced visibility graph", queries > 0 && longer == 0 && missed == 0,
+                  QString("%1 queries: %2 longer than over every corner(at most by %3 px), %4 found by one of the graphs only; "
+                          "%5 points and %6 edges over every corner, %7 and %8 reflex and bitangent")
+                  .arg(queries).arg(longer).arg(maxExcess, 0, 'f', 2).arg(missed)
+                  .arg(allPoints).arg(allEdges).arg(reflexPoints).arg(bitangentEdges));
+}
+
+bool crossesWall(const World &world, const QVector<QPointF> &path)
+{
+    for (int i = 0; i + 1 < path.size(); i++)
+    {
+        if (world.wallOnPath(path[i], path[i + 1]))
+            return true;
+    }
+    return false;
+}
+
+// HPA* keeps the entrances and the distances of its clusters between the queries. A wall put across the corridor
+// it has just used must be gone around, one through the whole field must leave no path, and with the wall removed
+// the straight path must come back.
+bool checkHierarchicalWallEdits(QTextStream &out)
+{
+    World world(fieldWidth, fieldHeight, QVector<QVector<QPointF> >(), 8.0);
+    discoverAll(&world);
+    HierarchicalPlanner planner(world);
+    QPointF start(100, 300), target(800, 300);
+    qreal straight = pathLength(planner.getPath(start, target));
+
+    QVector<QVector<QPointF> > walls(1);
+    walls[0] << QPointF(450, 0) << QPointF(450, 500);// The way around is at the bottom
+    world.setWalls(walls);
+    world.commitWalls();
+    QVector<QPointF> around = planner.getPath(start, target);
+    bool crossing = crossesWall(world, around);
+
+    walls[0].back() = QPointF(450, fieldHeight - 1);
+    world.setWalls(walls);
+    world.commitWalls();
+    bool blocked = planner.getPath(start, target).isEmpty();
+
+    world.setWalls(QVector<QVector<QPointF> >());
+    world.commitWalls();
+    qreal reopened = pathLength(planner.getPath(start, target));
+
+    bool ok = qAbs(straight - distance(start, target)) < 1e-6 && !around.isEmpty() && !crossing &&
+              pathLength(around) > straight && blocked && qAbs(reopened - straight) < 1e-6;
+    return report(out, "HPA* after the wall edits", ok,
+                  QString("%1 px straight, %2 px around the wall%3, %4 through the whole field, %5 px without it")
+                  .arg(straight, 0, 'f', 1).arg(pathLength(around), 0, 'f', 1).arg(crossing ? " crossing it" : "")
+                  .arg(blocked ? "no path" : "a path").arg(reopened, 0, 'f', 1));
+}
+
+}
+
+int runSelfCheck(const QStringList &mapFiles)
+{
+    QStringList files = mapFiles.isEmpty() ? defaultMaps() : mapFiles;
+    QTextStream out(stdout);
+    bool ok = true;
+    ok = checkDiagonalWall(out) && ok;
+    ok = checkDistanceFieldUpdates(out, files) && ok;
+    ok = checkSnapshots(out, files) && ok;
+    ok = checkFreeSpaceLabels(out, files) && ok;
+    ok = checkReducedGraph(out, files) && ok;
+    ok = checkHierarchicalWallEdits(out) && ok;
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,11 @@
+#ifndef SELFCHECK_H
+#define SELFCHECK_H
+
+#include <QtGui>
+
+// Checks the invariants the optimisations rely on against the plain computations they replaced, on made-up maps
+// and the given ones(map-examples/ by default). Prints a line per check and returns 1 if any failed.
+// Started by "./mapexploration --self-check [map files]".
+int runSelfCheck(const QStringList &mapFiles);
+
+#endif //SELFCHECK_H
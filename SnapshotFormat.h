@@ -0,0 +1,26 @@
+#ifndef SNAPSHOTFORMAT_H
+#define SNAPSHOTFORMAT_H
+
+#include <QtGlobal>
+
+// A snapshot(checkpoint) of ExplorationEngine has everything the run depends on, so the restored engine goes on exactly
+// like the saved one would. The map itself isn't stored, the snapshot is only restored into an engine for the same map,
+// but the edits of its walls and the robot radius are, restoring brings them back.
+// magic, version,
+// the map check: field width and height(int16), grid size(varints), a hash of the map the engine was made for(World::initialMap, uint64),
+// the robot radius, the walls: a byte, 0 if they weren't edited, else their count(varint, without the field edges) and the polylines(point count and points),
+// tick(varint), control, state and planner(bytes), position and angle, target and the heading to face there, path(count and points), the random generator state,
+// the discovery grid - runs along columns, alternately unknown and discovered ones, starting with unknown,
+// the visits - a run of zeros and a run of non-zero values followed by the values, until the grid is over,
+// the potential - of the unknown cells(they all have the same), then of the discovered cells updatePotential doesn't recompute,
+// column by column. The others are recomputed before the potential is used again.
+// The grid and the visits are varints, the poses and the potential are exact doubles(TraceFormat::writeReal), as the run depends on every bit of them.
+namespace SnapshotFormat
+{
+
+const char magic[4] = {'M', 'E', 'S', 'N'};
+const quint8 version = 3;
+
+}
+
+#endif //SNAPSHOTFORMAT_H
@@ -0,0 +1,75 @@
+#ifndef SQUAREWALKER_H
+#define SQUAREWALKER_H
+
+#include <QtGlobal>
+#include <QtCore/qmath.h>
+
+#include <limits>
+
+// Visits all the unit squares the segment touches, in order(Amanatides & Woo). Coordinates are in squares.
+// Through an exact corner both side squares come before the one across the corner(a supercover): a wall rasterized with it
+// leaves no diagonal gap, while a sight line may skip them, see isCornerSide().
+class SquareWalker
+{
+public:
+    SquareWalker(qreal x0, qreal y0, qreal x1, qreal y1):
+        ix(qFloor(x0)), iy(qFloor(y0)), endx(qFloor(x1)), endy(qFloor(y1)), corner(0)
+    {
+        qreal dx = x1 - x0, dy = y1 - y0;
+        qreal inf = std::numeric_limits<qreal>::max();
+        stepx = dx > 0 ? 1 : -1;
+        stepy = dy > 0 ? 1 : -1;
+        tDeltaX = dx != 0 ? qAbs(1.0 / dx) : inf;
+        tDeltaY = dy != 0 ? qAbs(1.0 / dy) : inf;
+        tMaxX = dx > 0 ? (ix + 1 - x0) / dx : (dx < 0 ? (x0 - ix) / -dx : inf);
+        tMaxY = dy > 0 ? (iy + 1 - y0) / dy : (dy < 0 ? (y0 - iy) / -dy : inf);
+    }
+
+    int x() const { return ix; }
+    int y() const { return iy; }
+    bool isLast() const { return ix == endx && iy == endy; }
+    bool isCornerSide() const { return corner != 0; }// The segment only touches this square at a corner
+
+    bool next()// Returns false when the segment is over
+    {
+        if (isLast() || qMin(tMaxX, tMaxY) > 1.0)
+            return false;
+        if (corner == 1)// From the side square along x to the one along y
+        {
+            ix -= stepx;
+            iy += stepy;
+            corner = 2;
+        }
+        else if (corner == 2)// Across the corner
+        {
+            ix += stepx;
+            tMaxX += tDeltaX;
+            tMaxY += tDeltaY;
+            corner = 0;
+        }
+        else if (tMaxX == tMaxY)
+        {
+            ix += stepx;
+            corner = 1;
+        }
+        else if (tMaxX < tMaxY)
+        {
+            ix += stepx;
+            tMaxX += tDeltaX;
+        }
+        else
+        {
+            iy += stepy;
+            tMaxY += tDeltaY;
+        }
+        return true;
+    }
+
+private:
+    int ix, iy, endx, endy;
+    int corner;// 1 or 2 on the first or the second side square of a corner, 0 otherwise
+    int stepx, stepy;
+    qreal tMaxX, tMaxY, tDeltaX, tDeltaY;
+};
+
+#endif //SQUAREWALKER_H
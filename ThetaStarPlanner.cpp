@@ -0,0 +1,173 @@
+#include <QtGui>
+
+#include <queue>
+#include <vector>
+#include <functional>
+#include <algorithm>
+#include <limits>
+
+#include "ThetaStarPlanner.h"
+#include "tools.h"
+#include "Arena.h"
+
+namespace
+{
+
+struct Nodes// Node n is the grid node (n / cellsy, n % cellsy), except the start and the goal, which use the exact positions
+{
+    int cellsy, start, goal;
+    qreal cellSize;
+    QPointF startPos, targetPos;
+
+    QPointF pos(int n) const
+    {
+        if (n == start)
+            return startPos;
+        if (n == goal)
+            return targetPos;
+        return cellSize * QPointF(n / cellsy, n % cellsy);
+    }
+};
+
+}
+
+ThetaStarPlanner::ThetaStarPlanner(const World &world_):
+    Planner(world_),
+    lastExpanded(0), lastSightChecks(0)
+{
+}
+
+QString ThetaStarPlanner::name() const
+{
+    return "Lazy Theta*";
+}
+
+QString ThetaStarPlanner::lastQueryStats() const
+{
+    return QString("%1 nodes expanded, %2 sight checks").arg(lastExpanded).arg(lastSightChecks);
+}
+
+bool ThetaStarPlanner::lineOfSight(const QPointF &a, const QPointF &b) const
+{
+    lastSightChecks++;
+    return world.gridLineOfSight(a, b);
+}
+
+QVector<QPointF> ThetaStarPlanner::getPath(const QPointF &startPos, const QPointF &targetPos) const
+{
+    lastExpanded = 0;
+    lastSightChecks = 0;
+
+    int cellsx = world.wallSquares.size(), cellsy = world.wallSquares[0].size();
+    int start = cellsx * cellsy;// An extra node, since the start position isn't bound to the grid
+    QPoint goalNode = world.nodeAt(targetPos);
+    if (goalNode.x() < 0 || goalNode.x() >= cellsx || goalNode.y() < 0 || goalNode.y() >= cellsy)
+        return QVector<QPointF>();
+    int goal = goalNode.x() * cellsy + goalNode.y();
+
+    Nodes nodes;
+    nodes.cellsy = cellsy;
+    nodes.start = start;
+    nodes.goal = goal;
+    nodes.cellSize = world.cellSize;
+    nodes.startPos = startPos;
+    nodes.targetPos = targetPos;
+    QPoint startNode = world.nodeAt(startPos);
+    qreal inf = std::numeric_limits<qreal>::max();
+
+    ArenaScope scope;// All the temporaries of the query are released at once
+    ArenaVector<qreal> g(start + 1, inf);
+    ArenaVector<int> parent(start + 1, -1);
+    ArenaVector<char> closed(start + 1, false);
+
+    typedef QPair<qreal, int> Entry;// (f, node)
+    std::priority_queue<Entry, ArenaVector<Entry>, std::greater<Entry> > open;
+    g[start] = 0.0;
+    parent[start] = start;
+    open.push(qMakePair(distance(startPos, targetPos), start));
+
+    bool found = false;
+    ArenaVector<int> neighbours;
+    neighbours.reserve(10);
+    while (!open.empty())
+    {
+        int s = open.top().second;
+        open.pop();
+        if (closed[s])
+            continue;// An outdated entry
+        QPointF sPos = nodes.pos(s);
+        int x = s / cellsy, y = s % cellsy;
+
+        neighbours.clear();
+        if (s == start)
+        {
+            x = startNode.x();
+            y = startNode.y();
+            neighbours.push_back(x * cellsy + y);
+        }
+        for (int dx = -1; dx <= 1; dx++)
+            for (int dy = -1; dy <= 1; dy++)
+                if (!(dx == 0 && dy == 0) && x + dx >= 0 && x + dx < cellsx && y + dy >= 0 && y + dy < cellsy)
+                    neighbours.push_back((x + dx) * cellsy + y + dy);
+        bool nearStart = s != start && qAbs(x - startNode.x()) <= 1 && qAbs(y - startNode.y()) <= 1;
+
+        if (parent[s] != s && !lineOfSight(nodes.pos(parent[s]), sPos))
+        {
+            // The lazy part: the parent was assumed to be visible, now it turned out it's not,
+            // so we fall back to the best already expanded neighbour.
+            g[s] = inf;
+            if (nearStart)
+                neighbours.push_back(start);
+            for (size_t i = 0; i < neighbours.size(); i++)
+            {
+                int n = neighbours[i];
+                qreal newg = g[n] + distance(nodes.pos(n), sPos);
+                if (closed[n] && newg < g[s] && lineOfSight(nodes.pos(n), sPos))
+                {
+                    g[s] = newg;
+                    parent[s] = n;
+                }
+            }
+            if (nearStart)
+                neighbours.pop_back();
+            if (g[s] == inf)
+                continue;
+        }
+
+        closed[s] = true;
+        lastExpanded++;
+        if (s == goal)
+        {
+            found = true;
+            break;
+        }
+
+        int sParent = parent[s];
+        QPointF parentPos = nodes.pos(sParent);
+        for (size_t i = 0; i < neighbours.size(); i++)
+        {
+            int n = neighbours[i];
+            if (closed[n] || (n != goal && !world.isFreeNode(n / cellsy, n % cellsy)))
+                continue;
+            QPointF nPos = nodes.pos(n);
+            if (!lineOfSight(sPos, nPos))// The grid edge itself, it's short
+                continue;
+            qreal newg = g[sParent] + distance(parentPos, nPos);// Assuming the parent sees n, checked when n is expanded
+            if (newg < g[n])
+            {
+                g[n] = newg;
+                parent[n] = sParent;
+                open.push(qMakePair(newg + distance(nPos, targetPos), n));
+            }
+        }
+    }
+
+    QVector<QPointF> ans;
+    if (!found)
+        return ans;
+    for (int cur = goal; cur != start; cur = parent[cur])
+        ans.append(nodes.pos(cur));
+    ans.append(startPos);
+    std::reverse(ans.begin(), ans.end());
+    return ans;
+}
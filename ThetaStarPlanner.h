@@ -0,0 +1,26 @@
+#ifndef THETASTARPLANNER_H
+#define THETASTARPLANNER_H
+
+#include <QtGui>
+
+#include "Planner.h"
+
+// Lazy Theta*: any-angle A* right on the discovery grid, no pivots needed.
+// Works on the grid squares of the World(see World::wallSquares), line of sight checks walk the squares under the segment,
+// so their cost depends on the segment length only.
+class ThetaStarPlanner: public Planner
+{
+public:
+    ThetaStarPlanner(const World &world_);
+
+    QString name() const;
+    QVector<QPointF> getPath(const QPointF &startPos, const QPointF &targetPos) const;
+    QString lastQueryStats() const;
+
+private:
+    bool lineOfSight(const QPointF &a, const QPointF &b) const;// Counts the checks
+
+    mutable int lastExpanded, lastSightChecks;
+};
+
+#endif //THETASTARPLANNER_H
@@ -0,0 +1,178 @@
+#ifndef TRACEFORMAT_H
+#define TRACEFORMAT_H
+
+#include <QtGlobal>
+#include <QByteArray>
+#include <QPointF>
+#include <QtCore/qmath.h>
+
+#include <cstring>
+
+#include "Geometry.h"
+
+// The trace file is a header followed by the per-tick records.
+// Header: magic, version, field width and height(int16), cell size(int16), the map as QDataStream writes it(without the field edges).
+// Record: type(byte), tick(varint), payload length(varint), payload. The length lets the replay index the file without decoding it.
+// Every payload starts with the pose and the exploration state, then:
+//   keyframe - target, path and the whole discovery grid, bit-packed column by column;
+//   delta    - flags, then the new target and path if the path was replanned, then the newly discovered cells as runs along columns.
+// A walls record(no pose) has all the map walls as QDataStream writes them, after each edit(see World::commitWalls),
+// it's in effect from its tick on. Version 1 traces have none.
+// Positions are stored in 1/8 pixels as int16, angles as uint16 fractions of the full turn, counts as varints.
+namespace TraceFormat
+{
+
+const char magic[4] = {'M', 'E', 'T', 'R'};
+const quint8 version = 2;
+const int keyframeInterval = 100;// ticks between the keyframes, the replay never applies more deltas than this when seeking
+
+enum RecordType
+{
+    KeyframeRecord = 1,
+    DeltaRecord = 2,
+    WallsRecord = 3
+};
+
+enum DeltaFlags
+{
+    NewPath = 1,// The path was replanned, the target and the whole path follow
+    PathAdvanced = 2// The first path point was passed
+};
+
+const qreal positionScale = 8.0;
+
+inline void writeByte(QByteArray *out, quint8 v)
+{
+    out->append(char(v));
+}
+
+inline void writeVarint(QByteArray *out, quint32 v)
+{
+    while (v >= 0x80)
+    {
+        out->append(char((v & 0x7f) | 0x80));
+        v >>= 7;
+    }
+    out->append(char(v));
+}
+
+inline void writeInt16(QByteArray *out, qint16 v)
+{
+    out->append(char(v & 0xff));
+    out->append(char((v >> 8) & 0xff));
+}
+
+inline void writeUint64(QByteArray *out, quint64 v)
+{
+    for (int i = 0; i < 8; i++)
+        out->append(char((v >> (8 * i)) & 0xff));
+}
+
+inline void writeReal(QByteArray *out, double v)// Exact, bit for bit
+{
+    quint64 bits;
+    memcpy(&bits, &v, sizeof(bits));
+    writeUint64(out, bits);
+}
+
+inline void writePoint(QByteArray *out, const QPointF &p)
+{
+    writeInt16(out, qint16(qBound(-32768.0, p.x() * positionScale, 32767.0)));
+    writeInt16(out, qint16(qBound(-32768.0, p.y() * positionScale, 32767.0)));
+}
+
+inline void writeAngle(QByteArray *out, qreal angle)// angle is in radians
+{
+    qreal turns = angle / (2 * PI());
+    turns -= qFloor(turns);
+    writeInt16(out, qint16(quint16(turns * 65536.0)));
+}
+
+class Reader// Reads the values back, never goes past the end. ok() turns false if it tried to.
+{
+public:
+    Reader(const char *begin, const char *end_): p(begin), end(end_), good(true) {}
+
+    bool ok() const { return good; }
+    bool atEnd() const { return p >= end; }
+    const char *position() const { return p; }
+
+    quint8 byte()
+    {
+        if (p >= end)
+        {
+            good = false;
+            return 0;
+        }
+        return quint8(*p++);
+    }
+
+    quint32 varint()
+    {
+        quint32 v = 0;
+        for (int shift = 0; shift < 35; shift += 7)
+        {
+            quint8 b = byte();
+            v |= quint32(b & 0x7f) << shift;
+            if (!(b & 0x80))
+                return v;
+        }
+        good = false;
+        return 0;
+    }
+
+    qint16 int16()
+    {
+        quint8 lo = byte(), hi = byte();
+        return qint16(quint16(lo) | (quint16(hi) << 8));
+    }
+
+    quint64 uint64()
+    {
+        quint64 v = 0;
+        for (int i = 0; i < 8; i++)
+            v |= quint64(byte()) << (8 * i);
+        return v;
+    }
+
+    double real()
+    {
+        quint64 bits = uint64();
+        double v;
+        memcpy(&v, &bits, sizeof(v));
+        return v;
+    }
+
+    QPointF point()
+    {
+        qreal x = int16() / positionScale;
+        qreal y = int16() / positionScale;
+        return QPointF(x, y);
+    }
+
+    qreal angle()
+    {
+        return quint16(int16()) / 65536.0 * 2 * PI();
+    }
+
+    void skip(int n)
+    {
+        if (end - p < n)
+        {
+            good = false;
+            p = end;
+        }
+        else
+        {
+            p += n;
+        }
+    }
+
+private:
+    const char *p, *end;
+    bool good;
+};
+
+}
+
+#endif //TRACEFORMAT_H
@@ -0,0 +1,197 @@
+#include <QtGui>
+
+#include <cstring>
+
+#include "TraceRecorder.h"
+#include "TraceFormat.h"
+#include "World.h"
+
+using namespace TraceFormat;
+
+TraceRecorder::TraceRecorder():
+    ring(capacity, 0),
+    readPos(0), used(0),
+    stopping(false),
+    lastKeyframe(-1)
+{
+}
+
+TraceRecorder::~TraceRecorder()
+{
+    stop();
+}
+
+bool TraceRecorder::start(const QString &fileName, const World &world)
+{
+    stop();
+    file.setFileName(fileName);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate))
+        return false;
+
+    QByteArray header(magic, sizeof(magic));
+    writeByte(&header, version);
+    writeInt16(&header, world.width);
+    writeInt16(&header, world.height);
+    writeInt16(&header, world.cellSize);
+    QDataStream out(&header, QIODevice::WriteOnly | QIODevice::Append);
+    out << world.map.mid(0, world.map.size() - 1);// without the field edges the World adds itself
+    file.write(header);
+
+    readPos = 0;
+    used = 0;
+    stopping = false;
+    lastKeyframe = -1;
+    QThread::start();
+    return true;
+}
+
+void TraceRecorder::stop()
+{
+    if (!isRunning())
+        return;
+    mutex.lock();
+    stopping = true;
+    notEmpty.wakeAll();
+    mutex.unlock();
+    wait();
+    file.close();
+}
+
+void TraceRecorder::push(const QByteArray &data)
+{
+    QMutexLocker locker(&mutex);
+    int written = 0;
+    while (written < data.size())// A record bigger than the buffer goes in parts
+    {
+        while (used == capacity)
+            notFull.wait(&mutex);
+        int writePos = (readPos + used) % capacity;
+        int n = qMin(data.size() - written, qMin(capacity - used, capacity - writePos));
+        memcpy(ring.data() + writePos, data.constData() + written, n);
+        used += n;
+        written += n;
+        notEmpty.wakeOne();
+    }
+}
+
+void TraceRecorder::run()
+{
+    QByteArray chunk;
+    while (true)
+    {
+        mutex.lock();
+        while (used == 0 && !stopping)
+            notEmpty.wait(&mutex);
+        if (used == 0 && stopping)
+        {
+            mutex.unlock();
+            break;
+        }
+        int n = qMin(used, capacity - readPos);// Up to the end of the buffer, the rest goes next time
+        chunk = QByteArray(ring.constData() + readPos, n);
+        readPos = (readPos + n) % capacity;
+        used -= n;
+        notFull.wakeAll();
+        mutex.unlock();
+
+        file.write(chunk);
+    }
+    file.flush();
+}
+
+void TraceRecorder::recordWalls(const World &world, int tick)
+{
+    if (!isRunning())
+        return;
+
+    QByteArray &payload = record_;
+    payload.clear();
+    QDataStream out(&payload, QIODevice::WriteOnly);
+    out << world.map.mid(0, world.map.size() - 1);// Like the header
+
+    QByteArray data;
+    writeByte(&data, WallsRecord);
+    writeVarint(&data, tick);
+    writeVarint(&data, payload.size());
+    data.append(payload);
+    push(data);
+}
+
+void TraceRecorder::record(const World &world, const Tick &t, const QVector<QPoint> &newCells, int pathEvents)
+{
+    if (!isRunning())
+        return;
+
+    int tick = t.tick;
+    bool keyframe = lastKeyframe == -1 || tick - lastKeyframe >= keyframeInterval;
+
+    QByteArray &payload = record_;
+    payload.clear();
+    writePoint(&payload, t.pos);
+    writeAngle(&payload, t.angle);
+    writeByte(&payload, t.state);
+
+    const QVector<QPointF> &path = *t.path;
+    if (keyframe)
+    {
+        lastKeyframe = tick;
+        writePoint(&payload, t.targetPos);
+        writeVarint(&payload, path.size());
+        for (int i = 0; i < path.size(); i++)
+            writePoint(&payload, path[i]);
+
+        const QVector<QVector<bool> > &grid = world.isDiscovered;
+        quint8 bits = 0;
+        int n = 0;
+        for (int i = 0; i < grid.size(); i++)
+        {
+            for (int j = 0; j < grid[i].size(); j++, n++)
+            {
+                if (grid[i][j])
+                    bits |= 1 << (n % 8);
+                if (n % 8 == 7)
+                {
+                    writeByte(&payload, bits);
+                    bits = 0;
+                }
+            }
+        }
+        if (n % 8 != 0)
+            writeByte(&payload, bits);
+    }
+    else
+    {
+        writeByte(&payload, pathEvents);
+        if (pathEvents & NewPath)
+        {
+            writePoint(&payload, t.targetPos);
+            writeVarint(&payload, path.size());
+            for (int i = 0; i < path.size(); i++)
+                writePoint(&payload, path[i]);
+        }
+
+        // The cells come column by column, so they are easily packed into runs
+        QByteArray runs;
+        int runCount = 0;
+        for (int k = 0; k < newCells.size(); )
+        {
+            int len = 1;
+            while (k + len < newCells.size() && newCells[k + len].x() == newCells[k].x() && newCells[k + len].y() == newCells[k].y() + len)
+                len++;
+            writeVarint(&runs, newCells[k].x());
+            writeVarint(&runs, newCells[k].y());
+            writeVarint(&runs, len);
+            runCount++;
+            k += len;
+        }
+        writeVarint(&payload, runCount);
+        payload.append(runs);
+    }
+
+    QByteArray data;
+    writeByte(&data, keyframe ? KeyframeRecord : DeltaRecord);
+    writeVarint(&data, tick);
+    writeVarint(&data, payload.size());
+    data.append(payload);
+    push(data);
+}
@@ -0,0 +1,60 @@
+#ifndef TRACERECORDER_H
+#define TRACERECORDER_H
+
+#include <QtGui>
+
+class World;
+
+// Encodes the engine's ticks into the trace format(see TraceFormat.h) and streams them into a file.
+// The records go through a fixed size ring buffer, a background thread writes them out, so the simulation never waits for the disk
+// unless the buffer is full.
+class TraceRecorder: public QThread
+{
+public:
+    TraceRecorder();
+    ~TraceRecorder();// Stops and flushes everything
+
+    // Any BasicExplorationEngine configuration can be recorded, the engine is only read through its getters
+    template <class Engine>
+    bool start(const QString &fileName, const Engine &engine) { return start(fileName, engine.getWorld()); }// Writes the header and starts the writer thread
+    void stop();
+    void recordWalls(const World &world, int tick);// After the edited walls are committed, tick is the last one made
+
+    template <class Engine>
+    void record(const Engine &engine, const QVector<QPoint> &newCells, int pathEvents)// Called after each tick. pathEvents are TraceFormat::DeltaFlags.
+    {
+        Tick t = { engine.getTickCount(), engine.getPos(), engine.getAngle(), engine.getState(), engine.getTargetPos(), &engine.getPath() };
+        record(engine.getWorld(), t, newCells, pathEvents);
+    }
+
+private:
+    struct Tick
+    {
+        int tick;
+        QPointF pos;
+        qreal angle;
+        int state;
+        QPointF targetPos;
+        const QVector<QPointF> *path;
+    };
+
+    bool start(const QString &fileName, const World &world);
+    void record(const World &world, const Tick &t, const QVector<QPoint> &newCells, int pathEvents);
+
+    void run();
+    void push(const QByteArray &data);// Blocks while there's no room in the buffer
+
+    static const int capacity = 1 << 20;
+
+    QFile file;
+    QByteArray ring;
+    int readPos, used;
+    bool stopping;
+    QMutex mutex;
+    QWaitCondition notEmpty, notFull;
+
+    int lastKeyframe;// The tick, -1 if there was none yet
+    QByteArray record_;// Reused for encoding
+};
+
+#endif //TRACERECORDER_H
@@ -0,0 +1,225 @@
+#include <QtGui>
+
+#include <cstring>
+
+#include "TraceReplay.h"
+#include "TraceFormat.h"
+
+using namespace TraceFormat;
+
+TraceReplay::TraceReplay():
+    curRecord(-1),
+    curWalls(-1),
+    world(NULL),
+    curTick(0),
+    curAngle(0.0),
+    state(0)
+{
+}
+
+TraceReplay::~TraceReplay()
+{
+    delete world;
+}
+
+bool TraceReplay::load(const QString &fileName)
+{
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly))
+        return false;
+    data = file.readAll();
+    file.close();
+
+    if (data.size() < int(sizeof(magic)) + 1 || memcmp(data.constData(), magic, sizeof(magic)) != 0)
+        return false;
+    Reader header(data.constData() + sizeof(magic), data.constData() + data.size());
+    int fileVersion = header.byte();
+    if (fileVersion != version && fileVersion != 1)// Version 1 only lacks the wall edits
+        return false;
+    int width = header.int16(), height = header.int16();
+    int cellSize = header.int16();// The engine's policies set it
+
+    QDataStream in(data);
+    in.skipRawData(header.position() - data.constData());
+    QVector<QVector<QPointF> > map;
+    in >> map;
+    if (!header.ok() || in.status() != QDataStream::Ok || cellSize <= 0)
+        return false;
+    int recordsStart = in.device()->pos();
+
+    records.clear();
+    keyframes.clear();
+    wallEdits.clear();
+    Reader r(data.constData() + recordsStart, data.constData() + data.size());
+    while (!r.atEnd())
+    {
+        Record rec;
+        rec.type = r.byte();
+        rec.tick = r.varint();
+        rec.size = r.varint();
+        rec.offset = r.position() - data.constData();
+        r.skip(rec.size);
+        if (!r.ok())
+            break;// The writer was interrupted in the middle of a record, the rest is fine
+        if (rec.type == KeyframeRecord)
+        {
+            keyframes.append(records.size());
+        }
+        else if (keyframes.isEmpty())
+        {
+            if (rec.type == WallsRecord && !readWalls(rec, &map))// The edits before the first keyframe are where the trace starts
+                return false;
+            continue;
+        }
+        else if (rec.type == WallsRecord)
+        {
+            wallEdits.append(records.size());
+        }
+        records.append(rec);
+    }
+    if (keyframes.isEmpty())
+        return false;
+
+    delete world;
+    world = new World(width, height, map, cellSize);
+    initialWalls = map;
+    curRecord = -1;
+    curWalls = -1;
+    return seek(firstTick());
+}
+
+int TraceReplay::firstTick() const
+{
+    return records.isEmpty() ? 0 : records.front().tick;
+}
+
+int TraceReplay::lastTick() const
+{
+    return records.isEmpty() ? 0 : records.back().tick;
+}
+
+bool TraceReplay::seek(int tick)
+{
+    // The last record not after the tick
+    int target = -1;
+    int lo = 0, hi = records.size() - 1;
+    while (lo <= hi)
+    {
+        int mid = (lo + hi) / 2;
+        if (records[mid].tick <= tick)
+        {
+            target = mid;
+            lo = mid + 1;
+        }
+        else
+        {
+            hi = mid - 1;
+        }
+    }
+    if (target == -1)
+        return false;
+
+    int from = curRecord + 1;// Going on from the current state if there's no keyframe in between
+    int keyframe = target;
+    while (records[keyframe].type != KeyframeRecord)
+        keyframe--;
+    if (curRecord == -1 || target < curRecord || keyframe > curRecord)
+        from = keyframe;
+
+    for (int i = from; i <= target; i++)
+    {
+        if (!apply(records[i]))
+            return false;
+        curRecord = i;
+    }
+
+    int walls = -1;
+    for (int k = 0; k < wallEdits.size() && wallEdits[k] <= target; k++)
+        walls = wallEdits[k];
+    if (walls != curWalls && !applyWalls(walls))
+        return false;
+    curTick = tick;
+    return true;
+}
+
+bool TraceReplay::readWalls(const Record &rec, QVector<QVector<QPointF> > *walls) const
+{
+    QDataStream in(QByteArray::fromRawData(data.constData() + rec.offset, rec.size));
+    in >> *walls;
+    return in.status() == QDataStream::Ok;
+}
+
+bool TraceReplay::applyWalls(int record)
+{
+    QVector<QVector<QPointF> > walls = initialWalls;
+    if (record != -1 && !readWalls(records[record], &walls))
+        return false;
+    world->setWalls(walls);
+    world->commitWalls();
+    curWalls = record;
+    return true;
+}
+
+bool TraceReplay::apply(const Record &rec)
+{
+    if (rec.type == WallsRecord)
+        return true;// See seek
+    Reader r(data.constData() + rec.offset, data.constData() + rec.offset + rec.size);
+    curPos = r.point();
+    curAngle = r.angle();
+    state = r.byte();
+
+    if (rec.type == KeyframeRecord)
+    {
+        targetPos = r.point();
+        int count = r.varint();
+        if (count > rec.size)
+            return false;
+        path.resize(count);
+        for (int i = 0; i < path.size() && r.ok(); i++)
+            path[i] = r.point();
+
+        QVector<QVector<bool> > &grid = world->isDiscovered;
+        quint8 bits = 0;
+        int n = 0;
+        for (int i = 0; i < grid.size(); i++)
+        {
+            for (int j = 0; j < grid[i].size(); j++, n++)
+            {
+                if (n % 8 == 0)
+                    bits = r.byte();
+                grid[i][j] = bits & (1 << (n % 8));
+            }
+        }
+        world->syncDiscoveryTree();
+    }
+    else
+    {
+        int flags = r.byte();
+        if (flags & NewPath)
+        {
+            targetPos = r.point();
+            int count = r.varint();
+            if (count > rec.size)
+                return false;
+            path.resize(count);
+            for (int i = 0; i < path.size() && r.ok(); i++)
+                path[i] = r.point();
+        }
+        if ((flags & PathAdvanced) && !path.isEmpty())
+            path.pop_front();
+
+        const QVector<QVector<bool> > &grid = world->isDiscovered;
+        int runCount = r.varint();
+        for (int k = 0; k < runCount && r.ok(); k++)
+        {
+            int x = r.varint(), y = r.varint(), len = r.varint();
+            for (int j = y; j < y + len; j++)
+            {
+                if (x >= 0 && x < grid.size() && j >= 0 && j < grid[x].size())
+                    world->setDiscovered(x, j);
+            }
+        }
+    }
+    return r.ok();
+}
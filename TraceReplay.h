@@ -0,0 +1,59 @@
+#ifndef TRACEREPLAY_H
+#define TRACEREPLAY_H
+
+#include <QtGui>
+
+#include "World.h"
+
+// Plays a recorded trace back without running the engine. Seeking goes to the nearest keyframe before the tick
+// and applies the deltas from there, so any tick is at most TraceFormat::keyframeInterval records away.
+// The wall edits are followed too, the world gets the walls of the last edit before the tick.
+class TraceReplay
+{
+public:
+    TraceReplay();
+    ~TraceReplay();
+
+    bool load(const QString &fileName);// Reads the file and indexes its records
+    int firstTick() const;
+    int lastTick() const;
+    bool seek(int tick);// Shows the state after the given tick. Returns false if the trace is broken there.
+    int getTick() const { return curTick; }
+
+    const World &getWorld() const { return *world; }
+    QPointF getPos() const { return curPos; }
+    qreal getAngle() const { return curAngle; }
+    int getState() const { return state; }
+    const QVector<QPointF> &getPath() const { return path; }
+    QPointF getTargetPos() const { return targetPos; }
+
+private:
+    struct Record
+    {
+        int tick;
+        int type;// TraceFormat::RecordType
+        int offset, size;// The payload position in the data
+    };
+
+    bool apply(const Record &r);
+    bool readWalls(const Record &r, QVector<QVector<QPointF> > *walls) const;
+    bool applyWalls(int record);// The walls of records[record], the header's ones for -1
+
+    QByteArray data;
+    QVector<Record> records;// Ordered by tick
+    QVector<int> keyframes;// Indices in records
+    QVector<int> wallEdits;// Indices in records
+    int curRecord;// The last applied record, -1 if none
+    QVector<QVector<QPointF> > initialWalls;// Without the field edges, as of the first keyframe
+    int curWalls;// The wall edit the world has, -1 for initialWalls
+
+    World *world;
+    int curTick;
+    QPointF curPos;
+    qreal curAngle;
+    int state;
+    QVector<QPointF> path;
+    QPointF targetPos;
+};
+
+#endif //TRACEREPLAY_H
@@ -0,0 +1,289 @@
+#include <QtGui>
+
+#include <algorithm>
+#include <queue>
+#include <functional>
+#include <limits>
+
+#include "VisibilityGraphPlanner.h"
+#include "tools.h"
+#include "Geometry.h"
+
+VisibilityGraphPlanner::VisibilityGraphPlanner(const World &world_, bool lazy_):
+    Planner(world_),
+    lazy(lazy_),
+    memoRevision(-1),
+    memoGeneration(0),
+    lastNodes(0), lastEdges(0), lastTests(0)
+{
+}
+
+QString VisibilityGraphPlanner::name() const
+{
+    return lazy ? "Visibility graph" : "Visibility graph(eager)";
+}
+
+QString VisibilityGraphPlanner::lastQueryStats() const
+{
+    return QString("%1 nodes, %2 edges checked, %3 intersection tests").arg(lastNodes).arg(lastEdges).arg(lastTests);
+}
+
+void VisibilityGraphPlanner::getPoints(const QPointF &startPos, const QPointF &targetPos, ArenaVector<World::Pivot> *points) const
+{
+    points->reserve(world.mapPivots.size() + world.virtualPivots.size() + 2);
+    points->insert(points->end(), world.mapPivots.begin(), world.mapPivots.end());
+    points->insert(points->end(), world.virtualPivots.begin(), world.virtualPivots.end());
+
+    World::Pivot endPoint;
+    endPoint.isCorner = false;
+    endPoint.pos = startPos;
+    points->push_back(endPoint);
+    endPoint.pos = targetPos;
+    points->push_back(endPoint);
+}
+
+void VisibilityGraphPlanner::getLines(ArenaVector<Segment> *lines, ArenaVector<Segment> *virtualLines) const
+{
+    for (int i = 0; i < world.obstacles.size(); i++)
+    {
+        for (int j = 0; j < world.obstacles[i].size() - 1; j++)
+        {
+            lines->push_back(Segment(world.obstacles[i][j], world.obstacles[i][j + 1]));
+        }
+    }
+    for (int i = 0; i < world.virtualWalls.size(); i++)
+    {
+        for (int j = 0; j < world.virtualWalls[i].size() - 1; j++)
+        {
+            virtualLines->push_back(Segment(world.virtualWalls[i][j], world.virtualWalls[i][j + 1]));
+        }
+    }
+}
+
+bool VisibilityGraphPlanner::isVisible(const World::Pivot &a, const World::Pivot &b,
+                                       const ArenaVector<Segment> &lines, const ArenaVector<Segment> &virtualLines,
+                                       const EndSight &sight) const
+{
+    lastEdges++;
+    if (!world.isTangent(a, b.pos) || !world.isTangent(b, a.pos))
+        return false;// Much cheaper than the intersection tests below
+    Segment line(a.pos, b.pos);
+    int count = sight.seen ? sight.count : int(lines.size());
+    for (int n = 0; n < count; n++)
+    {
+        const Segment &wall = lines[sight.seen ? sight.seen[n] : n];
+        lastTests++;
+        if (!line.sharesEndWith(wall))//то есть линии не смежные
+            if (line.intersects(wall))
+                return false;
+    }
+    for (size_t l = 0; l < virtualLines.size(); l++)
+    {
+        lastTests++;
+        if (line.intersects(virtualLines[l]))
+            return false;
+    }
+    return true;
+}
+
+void VisibilityGraphPlanner::getGraph(const QPointF &startPos, const QPointF &targetPos, Graph *graph) const
+{
+    ArenaVector<World::Pivot> &points = graph->points;
+    getPoints(startPos, targetPos, &points);
+    lastNodes = points.size();
+
+    ArenaVector<Segment> lines, virtualLines;
+    getLines(&lines, &virtualLines);
+#ifdef DEBUG
+//    qDebug() << "There are " << lines.size() << " solid and " << world.virtualWalls.size() << " virtual walls ,and " << points.size() << "points" << endl;
+#endif
+    int n = points.size();
+    EndSight startSight(world, startPos), targetSight(world, targetPos), anySight;
+    ArenaVector<QPair<int, int> > found;//visibility graph edges, i < j
+    for (int i = 0; i < n; i++)
+    {
+        for (int j = i + 1; j < n; j++)
+        {
+            const EndSight &sight = j == n - 1 ? targetSight : (j == n - 2 ? startSight : anySight);
+            if (isVisible(points[i], points[j], lines, virtualLines, sight))
+                found.push_back(qMakePair(i, j));
+        }
+    }
+
+    ArenaVector<int> &offsets = graph->offsets;// Counting sort of the edges by their first point
+    offsets.assign(points.size() + 1, 0);
+    for (size_t e = 0; e < found.size(); e++)
+    {
+        offsets[found[e].first + 1]++;
+        offsets[found[e].second + 1]++;
+    }
+    for (size_t i = 1; i < offsets.size(); i++)
+        offsets[i] += offsets[i - 1];
+    ArenaVector<int> fill(offsets.begin(), offsets.end() - 1);
+    graph->edges.resize(2 * found.size());
+    for (size_t e = 0; e < found.size(); e++)
+    {
+        graph->edges[fill[found[e].first]++] = found[e].second;
+        graph->edges[fill[found[e].second]++] = found[e].first;
+    }
+}
+
+QVector<QPointF> VisibilityGraphPlanner::getPath(const QPointF &startPos, const QPointF &targetPos) const
+{
+    lastEdges = 0;
+    lastTests = 0;
+    if (startPos == targetPos)
+    {
+        lastNodes = 0;
+        return QVector<QPointF>() << startPos;
+    }
+    return lazy ? getLazyPath(startPos, targetPos) : getEagerPath(startPos, targetPos);
+}
+
+QVector<QPointF> VisibilityGraphPlanner::getEagerPath(const QPointF &startPos, const QPointF &targetPos) const
+{
+    QVector<QPointF> ans;
+    ArenaScope scope;// All the temporaries of the query are released at once
+    Graph graph;
+    getGraph(startPos, targetPos, &graph);
+    int n = graph.points.size();
+    int start = n - 2, target = n - 1;
+
+    ArenaVector<double> g(n, std::numeric_limits<double>::max());
+    ArenaVector<int> parent(n, -1);
+    ArenaVector<char> closed(n, false);
+
+    typedef QPair<double, int> Entry;// (g + h, node)
+    std::priority_queue<Entry, ArenaVector<Entry>, std::greater<Entry> > open;
+    g[start] = 0;
+    open.push(qMakePair(distance(startPos, targetPos), start));
+
+    while (!open.empty())
+    {
+        int top = open.top().second;
+        open.pop();
+        if (closed[top])
+            continue;// An outdated entry
+        if (top == target)
+        {
+            for (int cur = target; cur != start; cur = parent[cur])
+                ans.append(graph.points[cur].pos);
+            ans.append(startPos);
+            break;
+        }
+        closed[top] = true;
+
+        const QPointF &topPos = graph.points[top].pos;
+        for (int e = graph.offsets[top]; e < graph.offsets[top + 1]; e++)
+        {
+            int next = graph.edges[e];
+            if (closed[next])
+                continue;
+            const QPointF &nextPos = graph.points[next].pos;
+            double new_g = g[top] + distance(topPos, nextPos);
+            if (new_g < g[next])
+            {
+                parent[next] = top;
+                g[next] = new_g;
+                open.push(qMakePair(new_g + distance(nextPos, targetPos), next));
+            }
+        }
+    }
+    std::reverse(ans.begin(), ans.end());
+    return ans;
+}
+
+QVector<QPointF> VisibilityGraphPlanner::getLazyPath(const QPointF &startPos, const QPointF &targetPos) const
+{
+    int pivots = world.mapPivots.size() + world.virtualPivots.size();
+    if (memoRevision != world.revision)
+    {
+        memoRevision = world.revision;
+        if (++memoGeneration == generations)// The stamps wrapped around, the oldest entries would look current
+        {
+            pivotEdges.fill(0);
+            memoGeneration = 1;
+        }
+        if (pivotEdges.size() < pivots * (pivots - 1) / 2)
+            pivotEdges.resize(pivots * (pivots - 1) / 2);
+        startEdges.fill(0, pivots);
+        memoStart = startPos;
+    }
+    else if (memoStart != startPos)
+    {
+        startEdges.fill(0, pivots);
+        memoStart = startPos;
+    }
+
+    QVector<QPointF> ans;
+    ArenaScope scope;// All the temporaries of the query are released at once
+    ArenaVector<World::Pivot> points;
+    getPoints(startPos, targetPos, &points);
+    ArenaVector<Segment> lines, virtualLines;
+    getLines(&lines, &virtualLines);
+    int n = points.size();
+    int start = n - 2, target = n - 1;
+    lastNodes = n;
+    EndSight startSight(world, startPos), targetSight(world, targetPos), anySight;
+
+    ArenaVector<double> g(n, std::numeric_limits<double>::max());
+    ArenaVector<int> parent(n, -1);
+    ArenaVector<char> closed(n, false);
+
+    typedef QPair<double, int> Entry;// (g + h, node)
+    std::priority_queue<Entry, ArenaVector<Entry>, std::greater<Entry> > open;
+    g[start] = 0;
+    open.push(qMakePair(distance(startPos, targetPos), start));
+
+    while (!open.empty())
+    {
+        int top = open.top().second;
+        open.pop();
+        if (closed[top])
+            continue;// An outdated entry
+        if (top == target)
+        {
+            for (int cur = target; cur != start; cur = parent[cur])
+                ans.append(points[cur].pos);
+            ans.append(startPos);
+            break;
+        }
+        closed[top] = true;
+
+        const QPointF &topPos = points[top].pos;
+        for (int next = 0; next < n; next++)// The same order as the eager graph lists the neighbours in
+        {
+            if (next == top || closed[next])
+                continue;
+            const QPointF &nextPos = points[next].pos;
+            double new_g = g[top] + distance(topPos, nextPos);
+            if (new_g >= g[next])
+                continue;// The edge can't improve anything, so it's never tested
+
+            quint16 *memo = NULL;// The edges to the target are only tested once per query anyway
+            if (top < pivots && next < pivots)
+                memo = &pivotEdges[qMax(top, next) * (qMax(top, next) - 1) / 2 + qMin(top, next)];
+            else if (top == start && next < pivots)
+                memo = &startEdges[next];
+            else if (next == start && top < pivots)
+                memo = &startEdges[top];
+            int state = memo && (*memo >> 2) == memoGeneration ? (*memo & 3) : int(UnknownEdge);
+            if (state == UnknownEdge)
+            {
+                const EndSight &sight = top == target || next == target ? targetSight :
+                                        (top == start || next == start ? startSight : anySight);
+                state = isVisible(points[top], points[next], lines, virtualLines, sight) ? VisibleEdge : BlockedEdge;
+                if (memo)
+                    *memo = quint16((memoGeneration << 2) | state);
+            }
+            if (state == BlockedEdge)
+                continue;
+
+            parent[next] = top;
+            g[next] = new_g;
+            open.push(qMakePair(new_g + distance(nextPos, targetPos), next));
+        }
+    }
+    std::reverse(ans.begin(), ans.end());
+    return ans;
+}
@@ -0,0 +1,70 @@
+#ifndef VISIBILITYGRAPHPLANNER_H
+#define VISIBILITYGRAPHPLANNER_H
+
+#include <QtGui>
+
+#include "Planner.h"
+#include "Arena.h"
+#include "Geometry.h"
+
+// Runs A* on the visibility graph over the map and virtual walls pivots.
+// In the lazy mode(the default) the nodes are known up front, but an edge is only tested against the walls when A* is
+// about to relax it through a better g. The results are memoized until the virtual walls change, so the other queries
+// of the same planning step(see ExplorationEngine::getAITarget) reuse them. The eager mode builds the whole graph first,
+// it's kept for comparison, the paths are the same.
+class VisibilityGraphPlanner: public Planner
+{
+public:
+    VisibilityGraphPlanner(const World &world_, bool lazy_ = true);
+
+    QString name() const;
+    QVector<QPointF> getPath(const QPointF &startPos, const QPointF &targetPos) const;
+    QString lastQueryStats() const;
+
+    struct Graph// Lives in the arena, so it's only valid in the planning job's ArenaScope
+    {
+        ArenaVector<World::Pivot> points;// The start and the target are the last two
+        ArenaVector<int> offsets, edges;// The neighbours of point i are edges[offsets[i]..offsets[i + 1])
+    };
+    void getGraph(const QPointF &startPos, const QPointF &targetPos, Graph *graph) const;// Calculates the visibility graph
+
+private:
+    void getPoints(const QPointF &startPos, const QPointF &targetPos, ArenaVector<World::Pivot> *points) const;
+    void getLines(ArenaVector<Segment> *lines, ArenaVector<Segment> *virtualLines) const;
+    // The map walls an edge from a query end can meet first(see PotentiallyVisibleSets), the rest can't change the answer
+    struct EndSight
+    {
+        const int *seen;// Indices into the lines, NULL to test them all
+        int count;
+
+        EndSight(): seen(NULL), count(0) {}
+        EndSight(const World &world, const QPointF &pos): count(0) { seen = world.obstacleSets().wallsSeenFrom(pos, &count); }
+    };
+    bool isVisible(const World::Pivot &a, const World::Pivot &b, const ArenaVector<Segment> &lines, const ArenaVector<Segment> &virtualLines,
+                   const EndSight &sight) const;
+
+    QVector<QPointF> getEagerPath(const QPointF &startPos, const QPointF &targetPos) const;
+    QVector<QPointF> getLazyPath(const QPointF &startPos, const QPointF &targetPos) const;
+
+    enum EdgeState
+    {
+        UnknownEdge,
+        VisibleEdge,
+        BlockedEdge
+    };
+
+    bool lazy;
+
+    // A memo entry is (generation << 2) | EdgeState, the entries of the older generations are unknown. A new revision
+    // starts a new generation instead of clearing the memo, so a tick doesn't pay for all the pivot pairs.
+    static const int generations = 1 << 14;
+    mutable int memoRevision;// World::revision the memo is for
+    mutable int memoGeneration;// From 1, the fresh entries are 0
+    mutable QPointF memoStart;
+    mutable QVector<quint16> pivotEdges;// Of pivots i < j at j * (j - 1) / 2 + i, the pivots are the map ones and then the virtual ones. Only grows.
+    mutable QVector<quint16> startEdges;// From memoStart to each pivot
+
+    mutable int lastNodes, lastEdges, lastTests;
+};
+
+#endif //VISIBILITYGRAPHPLANNER_H
@@ -1,68 +1,75 @@
 #include <QtGui>
 
-#include <queue>
-#include <cmath>
-#include <algorithm>
-
 #include "Visualisation.h"
+#include "MapCompiler.h"
 #include "tools.h"
 
 Visualisation::Visualisation(int width_, int height_, QVector<QVector<QPointF> > map_, QWidget *parent):
     QWidget(parent),
-    moveSpeed(10.0), rotSpeed(0.1),
-    fovDist(200.0), fovAngle(degr2rad(60.0)),
-    curPos(1, 1), curAngle(degr2rad(-45.0)),
-    pivotOffset(8.0), cellSize(8.0),
-    control(AIControl),
-    state(NoState),
-    map(map_),
-    targetPos(curPos),
-    timer(new QTimer(this))
-{
-   qsrand(10);
+    engine(new ExplorationEngine(width_, height_, map_)),
+    replay(NULL),
+    speed(1),
+    pendingTime(0.0),
+    targetCoverage(-1),
+    timer(new QTimer(this)),
+    captureTimer(new QTimer(this)),
+    capturedFrames(0),
+    idle(false),
+    commitScheduled(false)
+{
    setFixedSize(width_, height_);
    setFocusPolicy(Qt::StrongFocus);
 
-   connect(timer, SIGNAL(timeout()), this, SLOT(makeMove()));
-
-   int cellsx = width() / cellSize + 1;
-   int cellsy = height() / cellSize + 1;
-   isDiscovered = QVector<QVector<bool> > (cellsx, QVector<bool> (cellsy, false));
-   isDiscovered[0][0] = true;
-   isDiscovered[1][1] = true;
-   isDiscovered[0][1] = true;
-   isDiscovered[1][0] = true;
-
-   visits = QVector<QVector<int> > (cellsx, QVector<int> (cellsy, 0));
-   potential = QVector<QVector<qreal> > (cellsx, QVector<qreal> (cellsy, 0.0));
-
-   QPointF p00 = QPointF(0, 0), p10 = QPointF(width() - 1, 0), p01 = QPointF(0, height() - 1), p11 = QPointF(width() - 1, height() - 1);
-   QVector<QPointF> edge;
-   edge.append(p00);
-   edge.append(p01);
-   edge.append(p11);
-   edge.append(p10);
-   edge.append(p00);
-   map.append(edge);
+   connect(timer, SIGNAL(timeout()), this, SLOT(makeFrame()));
+   connect(captureTimer, SIGNAL(timeout()), this, SLOT(captureFrame()));
 
-   for (int i = 0; i < map.size(); i++)
-       mapPivots += getPivots(map[i], true);
+   frameClock.start();
+   timer->start(frameInterval);// let it begin!
+}
 
-   timer->start(50);// let it begin!
+Visualisation::~Visualisation()
+{
+    delete engine;
+    delete replay;
 }
 
 void Visualisation::keyPressEvent(QKeyEvent *e)
 {
-    pressedKeys[e->key()] = true;
+    engine->setKeyPressed(e->key(), true);
 }
 
 void Visualisation::keyReleaseEvent(QKeyEvent *e)
 {
-    pressedKeys[e->key()] = false;
+    engine->setKeyPressed(e->key(), false);
 }
 
 void Visualisation::paintEvent(QPaintEvent *)
 {
+    QImage img = renderFrame();// Drawing on the widget directly causes perfomance loss.
+    if (capture.isActive())
+        lastFrame = img;
+    QPainter q(this);
+    q.drawImage(QPointF(0, 0), img);// And finally..Drawing the whole image on the widget.
+}
+
+QImage Visualisation::renderFrame() const
+{
+    return renderExploration(size(), *engine, replay, true);
+}
+
+QImage renderExploration(const QSize &size, const ExplorationEngine &engine, const TraceReplay *replay, bool debugOverlay)
+{
+    const World &world = replay != NULL ? replay->getWorld() : engine.getWorld();
+    QPointF curPos = replay != NULL ? replay->getPos() : engine.getPos();
+    QPointF targetPos = replay != NULL ? replay->getTargetPos() : engine.getTargetPos();
+    qreal curAngle = replay != NULL ? replay->getAngle() : engine.getAngle();
+    qreal fovDist = engine.getFovDist(), fovAngle = engine.getFovAngle();
+    const QVector<QPointF> &path = replay != NULL ? replay->getPath() : engine.getPath();
+#ifdef DEBUG
+    const ExplorationEngine::PotentialGrid &potential = engine.getPotential();// Of the engine's world, not of a replayed one
+    debugOverlay = debugOverlay && replay == NULL;
+#endif
+
     QPainterPath posMark;
     qreal markWidth = 20, markHeight = 10;
     QPolygonF triangle;
@@ -76,6 +83,7 @@ void Visualisation::paintEvent(QPaintEvent *)
 
     QPen pathPen(QColor(51, 204, 255), 2);
     QPen mapPen(QColor(45, 0, 179), 3);
+    QPen obstaclePen(QColor(180, 170, 220), 1);
     QPen bkgPen(Qt::white);
     QPen undiscPen(Qt::black);
     QPen posMarkPen(Qt::green);
@@ -84,18 +92,24 @@ void Visualisation::paintEvent(QPaintEvent *)
     QBrush undiscBrush(Qt::black);
     QBrush posMarkBrush(Qt::green);
 
-    QImage img(width(), height(), QImage::Format_RGB32);
-    QPainter p(&img);// Drawing on the widget directly causes perfomance loss.
+    QImage img(size, QImage::Format_RGB32);
+    QPainter p(&img);
 
 
     p.setPen(bkgPen);
     p.setBrush(bkgBrush);
-    p.drawRect(QRectF(0, 0, width() - 1, height() - 1));
+    p.drawRect(QRectF(0, 0, size.width() - 1, size.height() - 1));
 
     p.setPen(mapPen);
-    for (int i = 0; i < map.size(); i++)
-        for (int j = 0; j < map[i].size() - 1; j++)
-            p.drawLine(QLineF(map[i][j], map[i][j + 1]));
+    for (int i = 0; i < world.map.size(); i++)
+        for (int j = 0; j < world.map[i].size() - 1; j++)
+            p.drawLine(QLineF(world.map[i][j], world.map[i][j + 1]));
+    if (world.robotRadius > 0)// Where the bot's center can't go
+    {
+        p.setPen(obstaclePen);
+        for (int i = 0; i < world.obstacles.size(); i++)
+            p.drawPolyline(QPolygonF(world.obstacles[i]));
+    }
 
     p.setPen(undiscPen);
 #ifdef DEBUG
@@ -105,15 +119,19 @@ void Visualisation::paintEvent(QPaintEvent *)
 #ifdef DEBUG
     p.setPen(Qt::yellow);
 #endif
-    for (int i = 0; i < isDiscovered.size(); i++)
+    ArenaScope scope;
+    ArenaVector<DiscoveryTree::Leaf> leaves;
+    world.discoveryTree.getLeaves(QRect(0, 0, world.isDiscovered.size(), world.isDiscovered[0].size()), &leaves);
+    for (int k = 0; k < int(leaves.size()); k++)
     {
-        for (int j = 0; j < isDiscovered[0].size(); j++)
-        {
-            if (!isDiscovered[i][j])
-            {
-                p.drawEllipse(cellSize * QPointF(i, j), cellSize, cellSize);
-            }
-        }
+        const QRect &r = leaves[k].cells;
+        if (leaves[k].discovered)
+            continue;
+        if (r.width() == 1 && r.height() == 1)
+            p.drawEllipse(world.cellSize * QPointF(r.left(), r.top()), world.cellSize, world.cellSize);
+        else// The circles of the cells merge into a rounded rectangle
+            p.drawRoundedRect(QRectF(world.cellSize * QPointF(r.left() - 1, r.top() - 1), world.cellSize * QPointF(r.right() + 1, r.bottom() + 1)),
+                              world.cellSize, world.cellSize);
     }
     
     p.setPen(pathPen);
@@ -125,38 +143,44 @@ void Visualisation::paintEvent(QPaintEvent *)
     p.drawPath(posMark);
 
 #ifdef DEBUG
-    for (int i = 0; i < dbgCompNumber.size(); i++)
-        for (int j = 0; j < dbgCompNumber[0].size(); j++)
+    for (int i = 0; debugOverlay && i < world.dbgCompNumber.size(); i++)
+        for (int j = 0; j < world.dbgCompNumber[0].size(); j++)
         {
-            if (dbgCompNumber[i][j] == 2)//aka undiscovered
+            if (world.dbgCompNumber[i][j] == 2)//aka undiscovered
             {
                 p.setPen(Qt::red);
                 p.setBrush(Qt::red);
-                p.drawEllipse(cellSize * QPointF(i, j), 2, 2);
+                p.drawEllipse(world.cellSize * QPointF(i, j), 2, 2);
             }
             else
             {
                 p.setPen(Qt::green);
                 p.setBrush(Qt::green);
-                p.drawEllipse(cellSize * QPointF(i, j), 1, 1);
+                p.drawEllipse(world.cellSize * QPointF(i, j), 1, 1);
             }
             p.setPen(Qt::blue);
             if (i % 2 == 0 && j % 2 == 0 && potential[i][j] > -10000)
-                p.drawText(cellSize * QPointF(i, j), QString::number(int(potential[i][j])));
+                p.drawText(world.cellSize * QPointF(i, j), QString::number(int(potential[i][j])));
         }
    
     p.setPen(Qt::magenta);// Drawing the FOV
     p.setBrush(Qt::transparent);
     p.drawPie(QRectF(curPos - QPointF(fovDist, fovDist), curPos + QPointF(fovDist, fovDist)), rad2degr(curAngle - fovAngle / 2) * 16, rad2degr(fovAngle) * 16);
 
+    if (debugOverlay)
+    {
+        p.setPen(Qt::red);// The last visibility graph size
+        p.drawText(QPointF(10, size.height() - 10), engine.getPlanner()->name() + ": " + engine.getPlanner()->lastQueryStats());
+    }
+
     p.setPen(QPen(Qt::blue, 5)); // Drawing the virtual wals
     p.setBrush(Qt::blue);
-    for (int i = 0; i < virtualWalls.size(); i++)
+    for (int i = 0; i < world.virtualWalls.size(); i++)
     {
-        for (int j = 0; j < virtualWalls[i].size() - 1; j++)
+        for (int j = 0; j < world.virtualWalls[i].size() - 1; j++)
         {
-            p.drawLine(QLineF(virtualWalls[i][j], virtualWalls[i][j + 1]));
-            p.drawEllipse(virtualWalls[i][j], 1, 1);
+            p.drawLine(QLineF(world.virtualWalls[i][j], world.virtualWalls[i][j + 1]));
+            p.drawEllipse(world.virtualWalls[i][j], 1, 1);
         }
     }
 /*
@@ -170,804 +194,346 @@ void Visualisation::paintEvent(QPaintEvent *)
 */
 #endif
     p.drawEllipse(targetPos, 3, 3);
-
-    QPainter q(this);
-    q.drawImage(QPointF(0, 0), img);// And finally..Drawing the whole image on the widget.
-
-}
-
-QPair<QPointF, QPointF> Visualisation::getVertexPivots(const QPointF &a, const QPointF &b, const QPointF &c) const
-{
-    QLineF dir1 = QLineF(b, a).unitVector(),
-           dir2 = QLineF(b, c).unitVector();
-    QLineF helper = QLineF(a, c).normalVector();
-
-    QPointF med = (dir1.p2() + dir2.p2()) / 2.0;
-    QLineF dir = QLineF(b, med);
-    dir.setLength(pivotOffset);
-    QPointF d1 = dir.p2(), d2 = dir.p1() - (dir.p2() - dir.p1());
-
-    int angle = helper.angleTo(dir);
-    if (90 <= angle && angle < 270) //First point will always be in the inner side
-        return qMakePair(d2, d1);
-    else
-        return qMakePair(d1, d2);
+    p.end();// Otherwise returning would copy the image
+    return img;
 }
 
-
-QVector<QPointF> Visualisation::getPivots(const QVector<QPointF> &v, bool mapPivots) const
+void Visualisation::makeFrame()
 {
-    bool innerZone = isDiscovered[v[0].x() / cellSize][v[0].y() / cellSize];
-    QVector<QPointF> ans;
-    if (v.size() == 1)
-    {
-        ans.append(v.front() - QPointF(pivotOffset, 0));
-        ans.append(v.front() - QPointF(0, pivotOffset));
-        ans.append(v.front() + QPointF(pivotOffset, 0));
-        ans.append(v.front() + QPointF(0, pivotOffset));
-        return ans;
-    }
-    if (v.front() == v.back() && v.size() > 2) // the line is enclosed
-    {
-        QPair<QPointF, QPointF> pv = getVertexPivots(v[v.size() - 2], v[0], v[1]);
-        ans.append(pv.first);
-        ans.append(pv.second);
-    }
-    else
+    qint64 elapsed = frameClock.restart();
+    if (replay != NULL)
     {
-        // The line is not enclosed, so we'll use two points on its extension to the first and the last vertices.
-        QLineF dir1 = QLineF(v[0], v[1]),
-               dir2 = QLineF(v[v.size() - 1], v[v.size() - 2]);
-        dir1.setLength(pivotOffset);
-        dir2.setLength(pivotOffset);
-        ans.push_back(dir1.p1() - (dir1.p2() - dir1.p1()));
-        ans.push_back(dir2.p1() - (dir2.p2() - dir2.p1()));
-
-        // And four on the perpendiculars to the first and the last segment(extended to both sides).
-        QLineF norm1 = QLineF(v[0], v[1]).normalVector(),
-               norm2 = QLineF(v[v.size() - 1], v[v.size() - 2]).normalVector();
-        norm1.setLength(pivotOffset);
-        norm2.setLength(pivotOffset);
-        ans.push_back(norm1.p2());
-        ans.push_back(norm1.p1() - (norm1.p2() - norm1.p1()));
-        ans.push_back(norm2.p2());
-        ans.push_back(norm2.p1() - (norm2.p2() - norm2.p1()));
-    }
-    
-    for (int i = 1; i < v.size() - 1; i++)
-    {
-        QPair<QPointF, QPointF> pv = getVertexPivots(v[i - 1], v[i], v[i + 1]);
-        if (mapPivots)
+        pendingTime = qMin(pendingTime + elapsed * speed, 4.0 * speed * tickInterval);
+        int ticks = pendingTime / tickInterval;
+        pendingTime -= ticks * tickInterval;
+        if (ticks > 0 && replay->getTick() < replay->lastTick())
         {
-            ans.append(pv.first);
-            ans.append(pv.second);
-        }
-        else
-        {
-            if (innerZone)
-                ans.append(pv.first);
-            else
-                ans.append(pv.second);
+            replay->seek(qMin(replay->getTick() + ticks, replay->lastTick()));
+            emit replayPositionChanged(replay->getTick());
+            update();
         }
+        return;
     }
-    
-    return ans;
-}
-
-namespace
-{
-
-void bfs(QVector<QVector<int> > *v, int stx, int sty, int cid) // Helper function for connectivity components determining. cid = component id.
-{
-    QVector<QVector<int> > &lv = *v;
-
-    QQueue<QPair<int, int> > q;
-    q.enqueue(qMakePair(stx, sty));
-    lv[stx][sty] = cid;
-    while (!q.isEmpty())
+    if (targetCoverage >= 0)
     {
-        QPair<int, int> top = q.head(); 
-        for (int i = -1; i <= 1; i++)
+        // Spending the whole frame on ticks, the picture is only updated when the target is reached
+        QElapsedTimer budget;
+        budget.start();
+        while (budget.elapsed() < frameInterval)
         {
-            for (int j = -1; j <= 1; j++)
+            if (engine->coverage() * 100 >= targetCoverage || engine->isComplete())
             {
-                if ((top.first + i >= 0) && (top.first + i < lv.size()) && 
-                    (top.second + j >= 0) && (top.second + j < lv[0].size()) &&
-                    lv[top.first + i][top.second + j] == 0)
-                {
-                    q.enqueue(qMakePair(top.first + i, top.second + j));
-                    lv[top.first + i][top.second + j] = cid;
-                }
+                targetCoverage = -1;
+                pendingTime = 0.0;
+                update();
+                break;
             }
+            engine->tick();
         }
-        q.dequeue();
+        stopIfComplete();
+        return;
     }
-}
-}
 
-QVector<QVector<int> > Visualisation::determineConnComp() const
-{
-    QVector<QVector<int> > isVisited(isDiscovered.size(), QVector<int>(isDiscovered[0].size(), 0));
-    for (int i = 0; i < isVisited.size(); i++)// First, we marks _discovered_ nodes as "walls"
+    pendingTime = qMin(pendingTime + elapsed * speed, 4.0 * speed * tickInterval);// Don't try to catch up for too long if the ticks are slower than the real time
+    bool ticked = false;
+    while (pendingTime >= tickInterval)
     {
-        for (int j = 0; j < isVisited[0].size(); j++)
-        {
-            if (isDiscovered[i][j])
-                isVisited[i][j] = 1;
-        }
+        engine->tick();
+        pendingTime -= tickInterval;
+        ticked = true;
     }
-    int compCount = 1;
-    for (int i = 0; i < isVisited.size(); i++)// Searching for the connected components
-    {
-        for (int j = 0; j < isVisited[0].size(); j++)
-        {
-            if (isVisited[i][j] == 0)
-            {
-                bfs(&isVisited, i, j, compCount + 1);// components ids are 1-indexed
-                compCount += 1;
-            }
-        }
-    }
-#ifdef DEBUG
-    //qDebug() << isVisited << endl;
-    dbgCompNumber = isVisited;
-#endif
-    return isVisited;
+    if (ticked)
+        update();
+    stopIfComplete();
+}
+
+void Visualisation::stopIfComplete()
+{
+    if (!engine->isComplete())
+        return;
+    timer->stop();
+    idle = true;
+    update();
+    emit explorationComplete(engine->getTickCount(), engine->coverage());
 }
 
-namespace
+void Visualisation::wake()
 {
+    if (!idle)
+        return;
+    idle = false;
+    frameClock.restart();
+    pendingTime = 0.0;
+    timer->start(frameInterval);
+}
 
-QVector<QPointF> optimizeWall(const QVector<QPointF> &w)// Optimising walls is merging some its consequent segments into one. For example:
-                                                        // {..(20, 100),(20, 200),(20, 300)..} might be merged into {..(20, 100); (20, 300)..}
-                                                        // {..(20, 100),(20, 200),(21, 300)..} can't be merged because the second segment is not on the first segment's line.
+void Visualisation::togglePause()
 {
-    QVector<QPointF> ans;
-    if (w.size() >= 2)
+    if (idle)
+        return;// Nothing to pause, the timer is already stopped
+    if (timer->isActive())
     {
-        ans.append(w[0]);
-        ans.append(w[1]);
+        timer->stop();
     }
     else
     {
-        return w;
-    }
-    qreal eps = 0.001;
-    for (int i = 2; i < w.size(); i++)
-    {
-        QLineF l1(ans[ans.size() - 2], ans[ans.size() - 1]);
-        QLineF l2(ans[ans.size() - 1], w[i]);
-        if (qAbs(l1.angle() - l2.angle()) < eps)
-        {
-            ans.pop_back();
-        }
-        ans.append(w[i]);
+        frameClock.restart();
+        timer->start(frameInterval);
     }
-    return ans;
 }
 
+void Visualisation::setRobotRadius(int radius)
+{
+    engine->setRobotRadius(radius);
+    wake();
+    update();
 }
 
-void Visualisation::updateVirtualWalls()
+void Visualisation::setSpeed(int newSpeed)
 {
-    virtualWalls.clear();
-
-    QVector<QVector<int> > connComp = determineConnComp();
-
-#ifdef DEBUG
-    dbgCompNumber = connComp;
-#endif
-
-    int curComp = 1;
-    while (true)
-    {
-        QVector<QPointF> result;
-        int startx = -1, starty = -1;// Searching for the leftmost topmost point.
-        for (int j = 0; j < connComp[0].size() && starty == -1; j++)
-        {
-            for (int i = 0; i < connComp.size() && startx == -1; i++)
-            {
-                if (connComp[i][j] == curComp)
-                {
-                    startx = i;
-                    starty = j;
-                    break;
-                }
-            }
-        }
-        if (startx == -1 && starty == -1)
-            break;
-        int curx = startx, cury = starty;
-
-        int dx[] = {-1, -1, 0, 1, 1,  1,  0, -1};
-        int dy[] = {0 ,  1, 1, 1, 0, -1, -1, -1};
-        int curDir = 4;
-
-        bool startVisited = false;
-        while (!(startVisited && curx == startx && cury == starty))
-        {
-            if (curx == startx && cury == starty)
-                startVisited = true;
-            if (result.size() > 400)
-            {
-//                qDebug() << "oops";
-            }
-            result.append(cellSize * QPointF(curx, cury));
-
-            int c = (curDir + 4) % 8;
-            bool foundNew = false;
-            for (int i = c + 1; i < 8 && !foundNew; i++)
-            {
-                int nx = curx + dx[i];
-                int ny = cury + dy[i];
-                if (nx >= 0 && nx < connComp.size() &&
-                    ny >= 0 && ny < connComp[0].size() &&
-                    (connComp[nx][ny] == curComp))
-                {
-                    curx = nx;
-                    cury = ny;
-                    foundNew = true;
-                    curDir = i;
-                }
-            }
-            for (int i = 0; i <= c && !foundNew; i++)
-            {
-                int nx = curx + dx[i];
-                int ny = cury + dy[i];
-
-                if (nx >= 0 && nx < connComp.size() &&
-                    ny >= 0 && ny < connComp[0].size() &&
-                    (connComp[nx][ny] == curComp))
-                {
-                    curx = nx;
-                    cury = ny;
-                    foundNew = true;
-                    curDir = i;
-                }
-            }
-            if (!foundNew)
-            {
-                break;
-            }
-        }
-        if (result.size() >= 2)
-        {
-            result.append(result.front());
-        }
-
-        QVector<QPointF> optResult = optimizeWall(result);
-#ifdef DEBUG
-//        qDebug() << "Result was " << result.size() << " optimized to " << optResult.size() << endl;
-#endif
-        virtualWalls.append(optResult);
-        curComp++;
-    }
+    speed = qMax(newSpeed, 1);
 }
 
-QHash<QPointF, QVector<QPointF> > Visualisation::getGraph(const QPointF &startPos, const QPointF &targetPos) const
+void Visualisation::runToCoverage(int percent)
 {
-    QVector<QPointF> points;
+    targetCoverage = percent;
+}
 
-    points += mapPivots;
+bool Visualisation::startRecording(const QString &fileName)
+{
+    if (!recorder.start(fileName, *engine))
+        return false;
+    engine->setRecorder(&recorder);
+    return true;
+}
 
-    for (int i = 0; i < virtualWalls.size(); i++)
-        points += getPivots(virtualWalls[i]);
+void Visualisation::stopRecording()
+{
+    engine->setRecorder(NULL);
+    recorder.stop();
+}
 
-    points.push_back(startPos);
-    points.push_back(targetPos);
+bool Visualisation::startCapture(const QString &fileName)
+{
+    if (!capture.start(fileName, size(), 1000, captureInterval, FrameCapture::SkipWhenFull))// The window must stay smooth, a slow disk costs frames
+        return false;
+    lastFrame = renderFrame();
+    capturedFrames = 0;
+    captureClock.start();
+    captureFrame();
+    captureTimer->start(captureInterval);
+    return true;
+}
 
-#ifdef DEBUG
-dbgPivots = points;
-#endif
+void Visualisation::stopCapture()
+{
+    captureTimer->stop();
+    capture.stop();
+    lastFrame = QImage();
+}
 
-    QVector<QLineF> lines;
-    for (int i = 0; i < map.size(); i++)
-    {
-        for (int j = 0; j < map[i].size() - 1; j++)
-        {
-            lines.push_back(QLineF(map[i][j], map[i][j + 1]));
-        }
-    }
-#ifdef DEBUG
-//    qDebug() << "There are " << lines.size() << " solid and " << virtualWalls.size() << " virtual walls ,and " << points.size() << "points" << endl;
-#endif
-    QHash<QPointF, QVector<QPointF> > graph;//visibility graph
-    QPointF trash;
-    for (int i = 0; i < points.size(); i++)
+void Visualisation::captureFrame()
+{
+    QString error = capture.error();
+    if (!error.isEmpty())
     {
-        for (int j = i + 1; j < points.size(); j++)
-        {
-            QLineF line(points[i], points[j]);
-            bool wasIntersection = false;
-            for (int l = 0; l < lines.size() && !wasIntersection; l++)
-            {
-                if (line.p1() != lines[l].p1() && line.p2() != lines[l].p1() && line.p1() != lines[l].p2() && line.p2() != lines[l].p2())//то есть линии не смежные
-                    if (line.intersect(lines[l], &trash) == QLineF::BoundedIntersection)
-                        wasIntersection = true;
-            }
-            for (int l = 0; l < virtualWalls.size() && !wasIntersection; l++)
-            {
-                for (int e = 0; e < virtualWalls[l].size() - 1 && !wasIntersection; e++)
-                {
-                    QLineF tline(virtualWalls[l][e], virtualWalls[l][e + 1]);
-                    if (line.intersect(tline, &trash) == QLineF::BoundedIntersection)
-                        wasIntersection = true;
-                }
-            }
-            if (!wasIntersection)
-            {
-                graph[points[i]].push_back(points[j]);
-                graph[points[j]].push_back(points[i]);
-            }
-        }
+        stopCapture();
+        emit captureFailed(error);
+        return;
     }
-    return graph;
+    int due = captureClock.elapsed() / captureInterval + 1;// Frame k is shown from k * captureInterval ms on
+    for (; capturedFrames < due; capturedFrames++)
+        capture.push(lastFrame);// The timer may be late, the missed frames repeat the picture they would have had
 }
 
-QVector<QPointF> Visualisation::getPath(const QPointF &startPos, const QPointF &targetPos) const
+bool Visualisation::startReplay(const QString &fileName)
 {
-    QHash<QPointF, QVector<QPointF> > graph = getGraph(startPos, targetPos);
-    
-    QVector<QPointF> ans;
-
-    QSet<QPointF> closed, open;
-    QHash<QPointF, double> g_h, h_h;
-    QHash<QPointF, QPointF> parent;
-
-    open.insert(startPos);
-    g_h[startPos] = 0;
-    h_h[startPos] = distance(startPos, targetPos);
-
-    while (!open.isEmpty())
+    TraceReplay *newReplay = new TraceReplay();
+    if (!newReplay->load(fileName))
     {
-        QPointF top = *open.begin();
-        for (QSet<QPointF>::ConstIterator it = open.begin(); it != open.end(); ++it)
-        {
-            if (g_h[*it] + h_h[*it] < g_h[top] + h_h[top])
-                top = *it;
-        }
-        if (top == targetPos)
-        {
-            QPointF cur = targetPos;
-            while (cur != startPos)
-            {
-                ans.append(cur);
-                cur = parent[cur];
-            }
-            ans.append(startPos);
-            break;
-        }
-
-        open.remove(top);
-        closed.insert(top);
-        QVector<QPointF> l = graph[top];
-        
-        for (int i = 0; i < l.size(); i++)
-        {
-            if (closed.contains(l[i]))
-                continue;
-            
-            double new_g = g_h[top] + distance(top, l[i]);
-            bool upd;
-            if (!open.contains(l[i]))
-            {
-                open.insert(l[i]);
-                upd = true;
-            }
-            else 
-            {
-                upd = new_g < g_h[l[i]];
-            }
-            if (upd)
-            {
-                parent[l[i]] = top;
-                g_h[l[i]] = new_g;
-                h_h[l[i]] = distance(l[i], targetPos);
-            }
-        }
+        delete newReplay;
+        return false;
     }
-    std::reverse(ans.begin(), ans.end());
-    return ans;
+    delete replay;
+    replay = newReplay;
+    pendingTime = 0.0;
+    wake();
+    update();
+    return true;
 }
 
-namespace
+void Visualisation::stopReplay()
 {
+    delete replay;
+    replay = NULL;
+    pendingTime = 0.0;
+    update();
+}
 
-bool fits(const QPointF &p, const QPointF &centre, qreal radius, qreal dirAngle, qreal spanAngle)// checks if p would feet in a circle sector.
+void Visualisation::seekReplay(int tick)
 {
-    dirAngle = fmod(dirAngle, PI() * 2);
-
-    qreal st = dirAngle - spanAngle / 2;
-    qreal fn = dirAngle + spanAngle / 2;
-
-    st = fmod(st, PI() * 2);
-    if (st < 0)
-        st += 2 * PI();
-    fn = fmod(fn, PI() * 2);
-    if (fn < 0)
-        fn += 2 * PI();
-    if (st > fn)
-        fn += 2 * PI();
-    qreal angle = degr2rad(QLineF(centre, p).angle());
-
-    if (angle < 0)
-        angle += 2 * PI();
-    if (angle < st)
-        angle += 2 * PI();
-#ifdef DEBUG
-//    qDebug() << "Start angle " << rad2degr(st) << " Finish angle " << rad2degr(fn) << " Anlge " << rad2degr(angle) << endl;
-#endif
+    if (replay == NULL)
+        return;
+    replay->seek(tick);
+    update();
+}
 
-    return (distance(p, centre) < radius && st <= angle && angle <= fn);
+int Visualisation::replayFirstTick() const
+{
+    return replay != NULL ? replay->firstTick() : 0;
 }
 
+int Visualisation::replayLastTick() const
+{
+    return replay != NULL ? replay->lastTick() : 0;
 }
 
-bool Visualisation::exploreMap()
+bool Visualisation::saveCheckpoint(const QString &fileName)
 {
-    bool discovered = false;
+    QFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate))
+        return false;
+    return file.write(engine->saveSnapshot()) != -1;
+}
 
-    qreal stx = curPos.x() - fovDist, fnx = curPos.x() + fovDist;
-    qreal sty = curPos.y() - fovDist, fny = curPos.y() + fovDist;
-    int stxp = qMax(0.0, stx / cellSize), fnxp = qMin(qreal(isDiscovered.size() - 1), fnx / cellSize);
-    int styp = qMax(0.0, sty / cellSize), fnyp = qMin(qreal(isDiscovered[0].size() - 1), fny / cellSize);
-    for (int i = stxp; i <= fnxp; i++)
-    {
-        for (int j = styp; j <= fnyp; j++)
-        {
-            if (!isDiscovered[i][j] && fits(cellSize * QPointF(i, j), curPos, fovDist, curAngle, fovAngle) && !wallOnPathTo(cellSize * QPointF(i, j)))
-            {
-                isDiscovered[i][j] = true;
-                discovered = true;
-            }
-        }
-    }
-    updateVirtualWalls();
+bool Visualisation::loadCheckpoint(const QString &fileName)
+{
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly))
+        return false;
+    if (!engine->restoreSnapshot(file.readAll()))
+        return false;
+    pendingTime = 0.0;
+    targetCoverage = -1;
+    wake();
     update();
-    return discovered;
+    return true;
 }
 
-void Visualisation::handleKeys()
+QStringList Visualisation::plannerNames() const
 {
-    bool needsDiscover = false;
-    if (pressedKeys[Qt::Key_Left])
-    {
-        curAngle += rotSpeed;
-        needsDiscover = true;
-    }
-    if (pressedKeys[Qt::Key_Right])
-    {
-        curAngle -= rotSpeed;
-        needsDiscover = true;
-    }
-    if (pressedKeys[Qt::Key_Up])
-    {
-        makeManualMove();
-        needsDiscover = true;
-    }
-    if (needsDiscover)
-    {
-        exploreMap();
-    }
+    return engine->plannerNames();
 }
 
-bool Visualisation::makeManualMove()
+int Visualisation::plannerIndex() const
 {
-    QLineF dir = QLineF::fromPolar(moveSpeed, rad2degr(curAngle)).translated(curPos);
-    QPointF trash;
-    bool intersects = false;
-    for (int i = 0; i < map.size() && !intersects; i++)
-    {
-        for (int j = 0; j < map[i].size() - 1 && !intersects; j++)
-        {
-            QLineF tmp(map[i][j], map[i][j + 1]);
-            if (dir.intersect(tmp, &trash) == QLineF::BoundedIntersection)
-            {
-                intersects = true;
-
-                qreal prod = dir.dx() * tmp.dx() + dir.dy() * tmp.dy();
-                int angle = dir.angleTo(tmp);
-                if ((0 <= angle && angle <= 180) ^ (prod > 0))
-                    curAngle -= rotSpeed;
-                else
-                    curAngle += rotSpeed;
-            }
-        }
-    }
-    if (!intersects)
-    {
-        curPos += QLineF::fromPolar(moveSpeed, rad2degr(curAngle)).p2();
-    }
-    return !intersects;
+    return engine->getPlannerIndex();
 }
 
-bool Visualisation::wallOnPathTo(const QPointF &b) const
+void Visualisation::setPlanner(int index)
 {
-    QLineF line(curPos, b);
-    QPointF trash;
-    for (int i = 0; i < map.size(); i++)
-    {
-        for (int j = 0; j < map[i].size() - 1; j++)
-        {
-            if (QLineF(map[i][j], map[i][j + 1]).intersect(line, &trash) == QLineF::BoundedIntersection)
-            {
-                return true;
-            }
-        }
-    }
-    return false;
+    engine->setPlanner(index);
+    wake();
 }
 
-void Visualisation::updatePotential()
+void Visualisation::toggleManualControl()
 {
-    int prob = 100;//%
-    for (int i = 0; i < potential.size(); i++)
-    {
-        for (int j = 0; j < potential[0].size(); j++)
-        {
-            if (!isDiscovered[i][j])
-            {
-                potential[i][j] = -1000000.0;
-            }
-            if (!(isDiscovered[i][j] &&
-                i > 0 && i < potential.size() - 1 &&
-                j > 0 && j < potential[0].size() - 1 &&
-                isDiscovered[i - 1][j] && isDiscovered[i + 1][j] &&
-                isDiscovered[i][j - 1] && isDiscovered[i][j + 1]))
-            {
-                continue;
-            }
-            potential[i][j] = 0.0;
-            for (int q = qMax(i - 5, 0); q < qMin(potential.size(), i + 5); q++)
-            {
-                for (int w = qMax(j - 5, 0); w < qMin(potential[0].size(), j + 5); w++)
-                {
-                    if (i == q && j == w)
-                        continue;
-                    if (!isDiscovered[q][w])
-                    {
-                        if (qrand() % 100 >= prob)
-                            continue;
-                        potential[i][j] += 10.0 / qSqrt((q - i) * (q - i) + (w - j) * (w - j) + 0.0);
-                    }
-                }
-            }
-            potential[i][j] -= visits[i][j];
-        }
-    }
+    engine->toggleManualControl();
+    wake();
 }
 
-QPointF Visualisation::getAITarget() const
+void Visualisation::addWall(int id, const QVector<QPointF> &points)
 {
-    int mi = -1, mj = -1;
-    for (int i = 0; i < potential.size(); i++)
-    {
-        for (int j = 0; j < potential[0].size(); j++)
-        {
-            if (isDiscovered[i][j] && (mi == -1 || mj == -1 || potential[i][j] > potential[mi][mj]))
-            {
-                mi = i;
-                mj = j;
-            }
-        }
-    }
-    int ci = mi, cj = mj;
-    qreal maxpath = 0.0;
-    QVector<QPointF> mp = getPath(curPos, cellSize * QPointF(mi, mj));
-    for (int i = 0; i < mp.size() - 1; i++)
-        maxpath += distance(mp[i], mp[i + 1]);
+    removeWall(id);
+    int index = engine->addWall(points);
+    if (index >= 0)
+        scriptedWalls.insert(id, index);
+    scheduleCommit();
+}
 
-    for (int i = 0; i < potential.size(); i++)
-    {
-        for (int j = 0; j < potential[0].size(); j++)
-        {
-            if (isDiscovered[i][j])
-            {
-                if (potential[i][j] >= 0.95 * potential[mi][mj] &&
-                    distance(curPos, cellSize * QPointF(i, j)) > 1.0)//epsilon
-                {
-                    qreal curpath = 0.0;
-                    QVector<QPointF> cp = getPath(curPos, cellSize * QPointF(i, j));
-                    for (int e = 0; e < cp.size() - 1; e++)
-                        curpath += distance(cp[e], cp[e + 1]);
-                    if (curpath < maxpath)
-                    {
-                        ci = i;
-                        cj = j;
-                        maxpath = curpath;
-                    }
-                }
-            }
-        }
-    }
-    return cellSize * QPointF(ci, cj);
+void Visualisation::removeWall(int id)
+{
+    if (!scriptedWalls.contains(id))
+        return;
+    engine->removeWall(scriptedWalls.take(id));
+    scheduleCommit();
 }
 
-void Visualisation::makeAIMove()
+void Visualisation::moveWall(int id, const QPointF &offset)
 {
-    exploreMap();
-#ifdef DEBUG
-    /*qDebug() << state << endl;
-    if (state == FollowPathState)
-    {
-        qDebug() << path << endl;
-    }
-    qDebug() << " -------" << endl;*/
-#endif
-    if (state == FollowPathState)
-    {
-        if (path.size() == 0) // We haven't found a path(or it is incorrect)
-        {
-            addVisitsCount(targetPos);// We lower target point's potential, and its probality to be chosen again
-            state = NoState;// Another chance
-        }
-        else
-        {
-            addVisitsCount(curPos);
-            if (path.size() <= 1)
-            {
-                if (rand() % 2 == 0)
-                    state = PointExploreStateCW;
-                else
-                    state = PointExploreStateCCW;
-                return;
-            }
-            QPointF a = path[0];
-            QPointF b = path[1];
-            bool came = makeMoveByLine(a, b);
-            if (came) // we have passed a, so we can remove it from the path
-                path.pop_front();
-        }
-    }
-    else if (state == NoState)
-    {
-        updatePotential();
-        targetPos = getAITarget();
-        path = getPath(curPos, targetPos);
-        state = FollowPathState;
-    }
-    else if (state == PointExploreStateCW || state == PointExploreStateCCW)
-    {
-        int stopProbality = 90;// The parameter to control rotation time.
-        if (qrand() % 100 > stopProbality)
-        {
-            state = NoState;
-        }
-        else
-        {
-            if (state == PointExploreStateCW)
-                curAngle -= rotSpeed;
-            else
-                curAngle += rotSpeed;
-        }
-    }
+    if (!scriptedWalls.contains(id))
+        return;
+    engine->moveWall(scriptedWalls.value(id), offset);
+    scheduleCommit();
 }
 
-namespace
+void Visualisation::setWalls(const QVector<QVector<QPointF> > &walls)
 {
+    scriptedWalls.clear();
+    engine->setWalls(walls);
+    scheduleCommit();
+}
 
-bool isOnSegment(QPointF p, QPointF a, QPointF b) //returns true if p belongs to segment [a, b]
+void Visualisation::scheduleCommit()
 {
-    //segment = [t * a + (1 - t) * b | 0 <= t <= 1]
-    qreal eps = 0.001;
-    if (qAbs(a.x() - b.x()) < eps) // to exclude division by zero
-    {
-        qSwap(a.rx(), a.ry());
-        qSwap(b.rx(), b.ry());
-        qSwap(p.rx(), p.ry());
-    }
-    qreal t = (p.x() - b.x()) / (a.x() - b.x());
-    if (t >= 0 && t <= 1)
-    {
-        if (qAbs(t * a.y() + (1 - t) * b.y() - p.y()) < 0.01)
-            return true;
-    }
-    return false;
+    if (commitScheduled)
+        return;
+    commitScheduled = true;
+    QTimer::singleShot(0, this, SLOT(commitWalls()));
 }
 
+void Visualisation::commitWalls()
+{
+    commitScheduled = false;
+    engine->commitWalls();
+    wake();// The new walls may have opened something up
+    update();
 }
 
-bool Visualisation::makeMoveByLine(const QPointF &a, const QPointF &b)
+int runCapture(const QStringList &args)
 {
-    QLineF dir(a, b);
-    qreal angle = degr2rad(dir.angle());
+    int stride = 1, percent = 95, maxTicks = 20000, queueSize = 16;
+    FrameCapture::Policy policy = FrameCapture::BlockWhenFull;
+    QStringList files;
+    for (int i = 0; i < args.size(); i++)
+    {
+        if (args[i] == "--stride" && i + 1 < args.size())
+            stride = qMax(1, args[++i].toInt());
+        else if (args[i] == "--coverage" && i + 1 < args.size())
+            percent = qBound(1, args[++i].toInt(), 100);
+        else if (args[i] == "--max-ticks" && i + 1 < args.size())
+            maxTicks = qMax(1, args[++i].toInt());
+        else if (args[i] == "--queue" && i + 1 < args.size())
+            queueSize = qMax(1, args[++i].toInt());
+        else if (args[i] == "--skip")
+            policy = FrameCapture::SkipWhenFull;
+        else
+            files << args[i];
+    }
 
-    while (curAngle + 2 * PI() < 0)
-        curAngle += 2 * PI();
-    while (curAngle - 2 * PI() >= 0)
-        curAngle -= 2 * PI();
+    QTextStream out(stdout);
+    if (files.size() != 2)
+    {
+        out << "Usage: --capture [--stride N] [--coverage P] [--max-ticks N] [--queue N] [--skip] output(.y4m or .png) map" << endl;
+        return 1;
+    }
 
-    if (curAngle == angle)
+    // No widget, the frames are painted straight into images. The DEBUG overlay is left out, its text needs a QApplication.
+    QSize frameSize(900, 600);
+    ExplorationEngine engine(frameSize.width(), frameSize.height(), MapCompiler().compile(getMapFromFile(files[1])));
+    FrameCapture capture;
+    QElapsedTimer timer;
+    timer.start();
+    if (!capture.start(files[0], frameSize, 1000, Visualisation::tickInterval * stride, policy, queueSize))
     {
-        QLineF delta = QLineF::fromPolar(moveSpeed, rad2degr(curAngle));
-        QPointF newPos = curPos + delta.p2();
-        if (isOnSegment(newPos, a, b))
-            curPos = newPos;
-        else
-        {
-            curPos = b;
-            return true;
-        }
+        out << "Couldn't write " << files[0] << endl;
+        return 1;
     }
-    else
+    capture.push(renderExploration(frameSize, engine, NULL, false));
+    while (engine.coverage() * 100 < percent && engine.getTickCount() < maxTicks && !engine.isComplete() && capture.error().isEmpty())
     {
-        bool ccw;//counter-clockwise
-        if (angle > curAngle)
-        {
-            if (curAngle + PI() > angle)
-                ccw = true;
-            else
-                ccw = false;
-        }
-        else
-        {
-            if (angle + PI() > curAngle)
-                ccw = false;
-            else
-                ccw = true;
-        }
-        if (ccw)
-        {
-            if (angle < curAngle)
-                angle += 2 * PI();
-            if (curAngle + rotSpeed >= angle)
-                curAngle = angle;
-            else
-                curAngle += rotSpeed;
-        }
-        else
-        {
-            if (curAngle < angle)
-                curAngle += 2 * PI();
-            if (curAngle - rotSpeed <= angle)
-                curAngle = angle;
-            else
-                curAngle -= rotSpeed;
-        }
+        engine.tick();
+        if (engine.getTickCount() % stride == 0)
+            capture.push(renderExploration(frameSize, engine, NULL, false));
     }
-    return false;
-}
-
-void Visualisation::addVisitsCount(const QPointF &p, qreal value)
-{
-    int affectionRadius = 3;
-    int cx = p.x() / cellSize, cy = p.y() / cellSize;
-    for (int q = -affectionRadius; q <= affectionRadius; q++)
+    capture.stop();
+    out << QString("%1 ticks, %2 frames written, %3 skipped in %4 s")
+           .arg(engine.getTickCount()).arg(capture.framesWritten()).arg(capture.framesSkipped())
+           .arg(timer.elapsed() / 1000.0, 0, 'f', 1) << endl;
+    if (!capture.error().isEmpty())
     {
-        if (cx + q < 0 || cx + q >= potential.size())
-            continue;
-        for (int w = -affectionRadius; w <= affectionRadius; w++)
-        {
-            if (cy + w < 0 || cy + w >= potential[0].size())
-                continue;
-            visits[cx + q][cy + w] += value / (abs(q) + abs(w) + 1.0);
-        }
+        out << "The capture failed: " << capture.error() << endl;
+        return 1;
     }
-    visits[cx][cy] += value;
-}
-
-void Visualisation::togglePause()
-{
-    if (timer->isActive())
-        timer->stop();
-    else
-        timer->start(50);
-}
-
-void Visualisation::toggleManualControl()
-{
-    state = NoState;
-    if (control == ManualContol)
-        control = AIControl;
-    else
-        control = ManualContol;
+    return 0;
 }
-
-void Visualisation::makeMove()
-{
-    if (control == ManualContol)
-        handleKeys();
-    else
-        makeAIMove();
-}
-
@@ -3,94 +3,101 @@
 
 #include <QtGui>
 
+#include "ExplorationEngine.h"
+#include "TraceRecorder.h"
+#include "TraceReplay.h"
+#include "FrameCapture.h"
+
+// Renders the engine and steps it with a fixed timestep: the simulation time runs "speed" times faster than the real one
+// and is spent in tickInterval steps, while the picture is updated at most once per frame.
 class Visualisation: public QWidget
 {
     Q_OBJECT
 
 public:
     Visualisation(int width_, int height_, QVector<QVector<QPointF> > map_,  QWidget *parent = NULL);
+    ~Visualisation();
+
+    QStringList plannerNames() const;
+    int plannerIndex() const;
+    int replayFirstTick() const;
+    int replayLastTick() const;
+    QImage renderFrame() const;
+
+    static const int tickInterval = 50;// Simulation time of one tick, ms
+
+signals:
+    void replayPositionChanged(int tick);
+    // The engine has nothing left to explore(see ExplorationEngine::isComplete). The timer is stopped then, until
+    // the control, the planner, the radius or the checkpoint changes, or a replay is started.
+    void explorationComplete(int ticks, qreal coverage);
+    void captureFailed(const QString &error);// A frame couldn't be written, the capture is stopped
 
 public slots:
     void togglePause();
     void toggleManualControl();
+    void setPlanner(int);
+    void setRobotRadius(int);// In pixels, 0 for a point
+    void setSpeed(int);// Simulation speed multiplier, 1 is the real time
+    void runToCoverage(int percent);// Runs the simulation flat out, without painting, until the given part of the field is discovered
+    bool startRecording(const QString &fileName);
+    void stopRecording();
+    bool startReplay(const QString &fileName);// The engine is paused while the trace is shown
+    void stopReplay();
+    void seekReplay(int tick);
+    bool startCapture(const QString &fileName);// The frames go at the capture's own rate, see captureFrame. FrameCapture tells the file names.
+    void stopCapture();
+    bool saveCheckpoint(const QString &fileName);
+    bool loadCheckpoint(const QString &fileName);// Only the checkpoints of the same map are accepted
+
+    // The wall edits, numbered by the caller(a script behind WallEditServer): adding an existing id replaces that wall.
+    // They are gathered until the event loop is free and applied together(see World::commitWalls), also when paused.
+    void addWall(int id, const QVector<QPointF> &points);
+    void removeWall(int id);
+    void moveWall(int id, const QPointF &offset);
+    void setWalls(const QVector<QVector<QPointF> > &walls);// Replaces all the map walls, the numbered ones too(the live map editor)
 
 private slots:
-    void makeMove();
+    void makeFrame();
+    void commitWalls();
+    void captureFrame();// Pushes the last painted frame once for each captureInterval passed since the last call, so the video runs in real time
 
 private:
     void paintEvent(QPaintEvent *);
     void keyPressEvent(QKeyEvent *);
     void keyReleaseEvent(QKeyEvent *);
+    void stopIfComplete();
+    void wake();// Restarts the timer stopped by stopIfComplete
+    void scheduleCommit();
+
+    static const int frameInterval = 16;// About the display refresh rate
+    static const int captureInterval = tickInterval;// A frame of the capture, the Y4M header says so. Slower than the paints, they don't come at a steady rate.
+
+    ExplorationEngine *engine;
+    TraceRecorder recorder;
+    FrameCapture capture;
+    TraceReplay *replay;// NULL if not replaying
+    int speed;
+    qreal pendingTime;// Simulation time not yet spent in ticks, ms
+    int targetCoverage;// In percents, -1 if not running to coverage
+    QElapsedTimer frameClock;
+    QTimer* timer;// Calls makeFrame
+    QTimer* captureTimer;// Calls captureFrame while capturing, it goes on when the simulation is paused
+    QElapsedTimer captureClock;
+    int capturedFrames;
+    QImage lastFrame;// The last painted one, only kept while capturing
+    bool idle;// The timer is stopped because the exploration is complete, not paused
+    QHash<int, int> scriptedWalls;// The wall ids of addWall to their numbers in World::map
+    bool commitScheduled;
+};
 
-    void makeAIMove();// Follows the path in the "path" variable
-    bool makeManualMove();// Tries to move and returns true if could. If couldn't, tries to rotate.
-
-    void handleKeys();
-
-    bool makeMoveByLine(const QPointF &a, const QPointF &b);// helper method for makeAIMove. Rotates while curAngle isn't equal to
-                                                            // Line(a, b).angle, then follows this line.
-    QPointF getAITarget() const;// Finds the point with the hightest potential.
-
-    bool exploreMap();// Updates the "isExplored" variable. Returns true if finds a new point
-    QVector<QVector<int> > determineConnComp() const;// A helper function for updateVirtualWalls
-    void updateVirtualWalls();
-
-    void updatePotential();
-
-    QPair<QPointF, QPointF> getVertexPivots(const QPointF &a, const QPointF &b, const QPointF &c) const;// Calculates the pivots for line [a, b][b, c]. The first element in the return value will always be the "inner" point
-    QVector<QPointF> getPivots(const QVector<QPointF> &, bool mapPivots = false) const;// Calculates pivots for the polyline(might be enclosed). Additional parameter is for correct handling of map pivots generating.
-    QHash<QPointF, QVector<QPointF> > getGraph(const QPointF &startPos, const QPointF &targetPos) const;// Calculates the visibility graph and returns it
-    QVector<QPointF> getPath(const QPointF &startPos, const QPointF &targetPos) const;// Calculates the path and returns it
-    bool wallOnPathTo(const QPointF &a) const;// Returns true if there's a wall on the line from curPoint to a
-    void addVisitsCount(const QPointF &p, qreal value = 20.0);//Adds visits count to the point and its neighbours(affection radius is set in the method).
-
-
-    qreal moveSpeed, rotSpeed;// rotSpeed is in radians
-    qreal fovDist, fovAngle;// FOV(field of view) is a circle sector with the radius fovDist and the central angle fovAngle(in radians)
-    QPointF curPos;
-    qreal curAngle;
-
-    qreal pivotOffset; // A parameter for conflicts exclusion. Path should be binded not to polygonal chains' vertices, but to the nearby located point, soThis parameter sets there points' offset from the vertices.
-    qreal cellSize;// The discovered zones edges are being drawn as circles, so this parameter affects "smoothing". Also, it significantly affects the perfomance.
-
-    enum Control
-    {
-        ManualContol,
-        AIControl
-    };
-    Control control;
-
-    enum ExplorationState
-    {
-        NoState,
-        FollowPathState,
-        PointExploreStateCW,// starts rotating and tries to stop with the given probality each moment(I consider it as a dirty hack, but don't see another sufficient method to handle it)
-        PointExploreStateCCW //the same, but counter-clockwise
-    };
-    ExplorationState state;
-
-    QVector<QVector<qreal> > potential;// The potential heuristic is formed by the nearby located undiscovered point(they increase it) and by the nearby located points' visits(they decrease it).
-    QVector<QVector<int> > visits;// Not exactly the visits count, but comparatively to other points, it's the time the bot was close to the point.
-    QVector<QVector<QPointF > > map;// Contains just the map, shoudn't be changed during the visualisation. Changed once in the constructor to add the screen edges.
-    QVector<QPointF> mapPivots;// Initialized at the startup, for the better perfomance.
-    QVector<QVector<bool> > isDiscovered;// The Visualisation field is a grid, so some points of this grid are already discovered, some not
-                                         // To convert grid nodes into real coordinates, you'll just multiply it by cellSize.
-    QVector<QPointF> path;// Contains the path to targetPos
-
-    QPointF targetPos;// Program will follow the path to this point
-    
-    QHash<int, bool> pressedKeys;// This map contains the states of the keys, to support key combinations(e.g. to rotate and move simultaneously)
-
-    QVector<QVector<QPointF> > virtualWalls;// These walls are formed by the edges of the undiscovered zone.
-                                            // They are "virtual" because they don't physically exist(unlike the walls formed by the "map" variable, their purpose is limitation for the path search algorithm
-
-    QTimer* timer;// Calls makeMove
-#ifdef DEBUG
-    mutable QVector<QPointF> dbgPivots;
-    mutable QVector<QPointF> dbgConnComp;
-    mutable QVector<QVector<int> > dbgCompNumber;
-#endif
+// Paints the engine's world, or the replayed one if replay isn't NULL, without a widget. debugOverlay adds the DEBUG build's
+// potential, components and planner stats, only for the engine's own world.
+QImage renderExploration(const QSize &size, const ExplorationEngine &engine, const TraceReplay *replay, bool debugOverlay);
 
-};
+// Started by "./mapexploration --capture [--stride N] [--coverage P] [--max-ticks N] [--queue N] [--skip] output map",
+// renders the exploration into a video without a window(under a QCoreApplication, see main.cpp). The simulation waits for the encoders unless --skip is given.
+// The capture also ends when the exploration is complete.
+int runCapture(const QStringList &args);
 
 #endif //VISUALISATION_H
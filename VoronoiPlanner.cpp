@@ -0,0 +1,612 @@
+#include <QtGui>
+
+#include <queue>
+#include <vector>
+#include <functional>
+#include <algorithm>
+#include <limits>
+
+#include "VoronoiPlanner.h"
+#include "tools.h"
+
+namespace
+{
+
+const qreal diagonal = 1.41421356237309504880;
+
+// The 8 neighbours in the circular order, the even ones share a side with the node
+const int ringx[] = {1, 1, 0, -1, -1, -1, 0, 1};
+const int ringy[] = {0, 1, 1, 1, 0, -1, -1, -1};
+
+int findRing(int *parent, int k)
+{
+    while (parent[k] != k)
+        k = parent[k] = parent[parent[k]];
+    return k;
+}
+
+}
+
+VoronoiPlanner::VoronoiPlanner(const World &world_):
+    Planner(world_),
+    cellsx(world.isDiscovered.size()), cellsy(world.isDiscovered[0].size()),
+    builtRevision(-1),
+    lastExpanded(0), lastRebuilt(false)
+{
+}
+
+QString VoronoiPlanner::name() const
+{
+    return "Voronoi roadmap";
+}
+
+QString VoronoiPlanner::lastQueryStats() const
+{
+    return QString("%1 junctions, %2 corridors, %3 nodes expanded to reach them%4")
+           .arg(vertexCells.size()).arg(corridors.size()).arg(lastExpanded).arg(lastRebuilt ? ", rebuilt" : "");
+}
+
+void VoronoiPlanner::brushfire(ArenaVector<int> *nearest) const
+{
+    // Dijkstra from all the obstacle nodes at once, each free node takes the nearest obstacle node of its neighbours
+    ArenaVector<int> &src = *nearest;
+    src.assign(cellsx * cellsy, -1);
+    ArenaVector<int> dist(cellsx * cellsy, std::numeric_limits<int>::max());// Squared, in nodes
+    typedef QPair<int, int> Entry;// (squared distance, node)
+    std::priority_queue<Entry, ArenaVector<Entry>, std::greater<Entry> > open;
+    for (int i = 0; i < cellsx; i++)
+    {
+        for (int j = 0; j < cellsy; j++)
+        {
+            if (world.isFreeNode(i, j))
+                continue;
+            int k = i * cellsy + j;
+            src[k] = k;
+            dist[k] = 0;
+            for (int d = 0; d < 8; d++)
+            {
+                if (world.isFreeNode(i + ringx[d], j + ringy[d]))// Only the obstacles' edges spread
+                {
+                    open.push(qMakePair(0, k));
+                    break;
+                }
+            }
+        }
+    }
+    while (!open.empty())
+    {
+        int d = open.top().first, k = open.top().second;
+        open.pop();
+        if (d > dist[k])
+            continue;
+        int si = src[k] / cellsy, sj = src[k] % cellsy;
+        int i = k / cellsy, j = k % cellsy;
+        for (int r = 0; r < 8; r++)
+        {
+            int ni = i + ringx[r], nj = j + ringy[r];
+            if (!world.isFreeNode(ni, nj))
+                continue;
+            int n = ni * cellsy + nj;
+            int nd = (ni - si) * (ni - si) + (nj - sj) * (nj - sj);
+            if (nd < dist[n])
+            {
+                dist[n] = nd;
+                src[n] = src[k];
+                open.push(qMakePair(nd, n));
+            }
+        }
+    }
+    clearance.resize(cellsx * cellsy);
+    for (int k = 0; k < cellsx * cellsy; k++)
+        clearance[k] = src[k] < 0 ? 0.0f : float(qSqrt(qreal(dist[k])) * world.cellSize);
+}
+
+int VoronoiPlanner::skeletonNeighbours(int node) const
+{
+    int i = node / cellsy, j = node % cellsy;
+    int count = 0;
+    for (int r = 0; r < 8; r++)
+    {
+        int ni = i + ringx[r], nj = j + ringy[r];
+        if (ni >= 0 && ni < cellsx && nj >= 0 && nj < cellsy && skeleton[ni * cellsy + nj])
+            count++;
+    }
+    return count;
+}
+
+void VoronoiPlanner::thin() const
+{
+    // A node can go if its skeleton neighbours stay connected without it and it isn't an end.
+    // The nodes closest to the obstacles go first, so what's left is on the ridge of the clearance.
+    QVector<QPair<float, int> > order;
+    for (int k = 0; k < cellsx * cellsy; k++)
+    {
+        if (skeleton[k])
+            order.append(qMakePair(clearance[k], k));
+    }
+    std::sort(order.begin(), order.end());
+
+    bool changed = true;
+    while (changed)
+    {
+        changed = false;
+        for (int o = 0; o < order.size(); o++)
+        {
+            int k = order[o].second;
+            if (!skeleton[k])
+                continue;
+            int i = k / cellsy, j = k % cellsy;
+            bool on[8];
+            int count = 0;
+            for (int r = 0; r < 8; r++)
+            {
+                int ni = i + ringx[r], nj = j + ringy[r];
+                on[r] = ni >= 0 && ni < cellsx && nj >= 0 && nj < cellsy && skeleton[ni * cellsy + nj];
+                count += on[r];
+            }
+            if (count < 2)
+                continue;
+
+            // The neighbours next to each other on the ring touch, and so do the side ones two apart(across a corner)
+            int parent[8];
+            for (int r = 0; r < 8; r++)
+                parent[r] = r;
+            for (int r = 0; r < 8; r++)
+            {
+                if (on[r] && on[(r + 1) % 8])
+                    parent[findRing(parent, r)] = findRing(parent, (r + 1) % 8);
+                if (r % 2 == 0 && on[r] && on[(r + 2) % 8])
+                    parent[findRing(parent, r)] = findRing(parent, (r + 2) % 8);
+            }
+            int components = 0;
+            for (int r = 0; r < 8; r++)
+                components += on[r] && findRing(parent, r) == r;
+            if (components == 1)
+            {
+                skeleton[k] = false;
+                changed = true;
+            }
+        }
+    }
+}
+
+void VoronoiPlanner::extractCorridors() const
+{
+    vertexOf.fill(-1, cellsx * cellsy);
+    corridorOf.fill(-1, cellsx * cellsy);
+    indexInCorridor.fill(-1, cellsx * cellsy);
+    vertexCells.clear();
+    vertexCorridors.clear();
+    corridors.clear();
+
+    for (int k = 0; k < cellsx * cellsy; k++)
+    {
+        if (skeleton[k] && skeletonNeighbours(k) != 2)
+        {
+            vertexOf[k] = vertexCells.size();
+            vertexCells.append(k);
+        }
+    }
+
+    // The corridors are traced from the vertices, then the loops without any vertex get one at their first node
+    for (int pass = 0; pass < 2; pass++)
+    {
+        for (int k = 0; k < cellsx * cellsy; k++)
+        {
+            if (!skeleton[k])
+                continue;
+            if (pass == 1)
+            {
+                if (vertexOf[k] >= 0 || corridorOf[k] >= 0)
+                    continue;
+                vertexOf[k] = vertexCells.size();
+                vertexCells.append(k);
+            }
+            else if (vertexOf[k] < 0)
+            {
+                continue;
+            }
+
+            int i = k / cellsy, j = k % cellsy;
+            for (int r = 0; r < 8; r++)
+            {
+                int ni = i + ringx[r], nj = j + ringy[r];
+                if (ni < 0 || ni >= cellsx || nj < 0 || nj >= cellsy || !skeleton[ni * cellsy + nj])
+                    continue;
+                int w = ni * cellsy + nj;
+                if ((vertexOf[w] >= 0 && w < k) || corridorOf[w] >= 0)
+                    continue;// Traced from the other end already
+
+                Corridor c;
+                c.cells.append(k);
+                int prev = k, cur = w;
+                while (vertexOf[cur] < 0)
+                {
+                    c.cells.append(cur);
+                    int ci = cur / cellsy, cj = cur % cellsy, next = -1;
+                    for (int q = 0; q < 8 && next < 0; q++)
+                    {
+                        int qi = ci + ringx[q], qj = cj + ringy[q];
+                        if (qi >= 0 && qi < cellsx && qj >= 0 && qj < cellsy && skeleton[qi * cellsy + qj] && qi * cellsy + qj != prev)
+                            next = qi * cellsy + qj;
+                    }
+                    prev = cur;
+                    cur = next;
+                    corridorOf[prev] = corridors.size();// Marked as it goes, so a loop isn't traced again from its other side
+                }
+                c.cells.append(cur);
+                if (c.cells.size() == 3 && c.cells[0] == c.cells[2])
+                {
+                    corridorOf[c.cells[1]] = -1;// There and back over a single node, not a loop
+                    continue;
+                }
+                c.a = vertexOf[k];
+                c.b = vertexOf[cur];
+                c.prefix.append(0.0);
+                for (int m = 1; m < c.cells.size(); m++)
+                {
+                    bool straight = c.cells[m] / cellsy == c.cells[m - 1] / cellsy || c.cells[m] % cellsy == c.cells[m - 1] % cellsy;
+                    c.prefix.append(c.prefix.back() + (straight ? 1.0 : diagonal) * world.cellSize);
+                }
+                for (int m = 1; m + 1 < c.cells.size(); m++)
+                    indexInCorridor[c.cells[m]] = m;
+                corridors.append(c);
+            }
+        }
+    }
+
+    vertexCorridors.fill(QVector<int>(), vertexCells.size());
+    for (int c = 0; c < corridors.size(); c++)
+    {
+        vertexCorridors[corridors[c].a].append(c);
+        if (corridors[c].b != corridors[c].a)
+            vertexCorridors[corridors[c].b].append(c);
+    }
+}
+
+bool VoronoiPlanner::pruneSpurs() const
+{
+    // A dead end shorter than the clearance at its junction only points into a corner,
+    // and a piece connected to nothing that is shorter than its clearance is a bump of some wall
+    bool pruned = false;
+    for (int c = 0; c < corridors.size(); c++)
+    {
+        const Corridor &cor = corridors[c];
+        bool deadA = skeletonNeighbours(cor.cells.front()) == 1, deadB = skeletonNeighbours(cor.cells.back()) == 1;
+        if (!deadA && !deadB)
+            continue;
+        int junction = -1;
+        qreal limit = qMax(clearance[cor.cells.front()], clearance[cor.cells.back()]);
+        if (deadA != deadB)
+        {
+            junction = deadA ? cor.cells.back() : cor.cells.front();
+            limit = clearance[junction];
+        }
+        if (cor.prefix.back() >= limit)
+            continue;
+        for (int m = 0; m < cor.cells.size(); m++)
+        {
+            if (cor.cells[m] != junction)
+                skeleton[cor.cells[m]] = false;
+        }
+        pruned = true;
+    }
+    for (int v = 0; v < vertexCells.size(); v++)
+    {
+        if (vertexCorridors[v].isEmpty() && skeleton[vertexCells[v]])
+        {
+            skeleton[vertexCells[v]] = false;
+            pruned = true;
+        }
+    }
+    return pruned;
+}
+
+void VoronoiPlanner::refresh() const
+{
+    if (builtRevision == world.revision)
+        return;
+    builtRevision = world.revision;
+    lastRebuilt = true;
+
+    ArenaScope scope;
+    ArenaVector<int> nearest;
+    brushfire(&nearest);
+
+    // A free node is on the diagram if its side neighbour's nearest obstacle is farther from its own than both are from the node,
+    // and more than 2 nodes away, so the staircases of the slanted walls and the slightly bent walls don't make ridges.
+    // Of the two nodes only the farther one from the obstacles is taken, the obstacles next to it count when they are on its other side.
+    skeleton.fill(false, cellsx * cellsy);
+    for (int i = 0; i < cellsx; i++)
+    {
+        for (int j = 0; j < cellsy; j++)
+        {
+            int k = i * cellsy + j;
+            if (!world.isFreeNode(i, j))
+                continue;
+            int si = nearest[k] / cellsy, sj = nearest[k] % cellsy;
+            qreal nodes = clearance[k] / world.cellSize;
+            int threshold = qMax(4, qRound(nodes * nodes));
+            for (int r = 0; r < 8 && !skeleton[k]; r += 2)
+            {
+                int ni = i + ringx[r], nj = j + ringy[r];
+                if (ni < 0 || ni >= cellsx || nj < 0 || nj >= cellsy)
+                    continue;
+                int n = ni * cellsy + nj;
+                int oi = nearest[n] / cellsy, oj = nearest[n] % cellsy;
+                int separation = (si - oi) * (si - oi) + (sj - oj) * (sj - oj);
+                if (!world.isFreeNode(ni, nj))
+                    skeleton[k] = separation >= 4;
+                else if (separation > threshold)
+                    skeleton[k] = clearance[k] > clearance[n] || (clearance[k] == clearance[n] && k < n);
+            }
+        }
+    }
+
+    thin();
+    extractCorridors();
+    if (pruneSpurs())
+    {
+        thin();
+        extractCorridors();
+    }
+}
+
+QPointF VoronoiPlanner::nodePos(int node) const
+{
+    return world.cellSize * QPointF(node / cellsy, node % cellsy);
+}
+
+bool VoronoiPlanner::isPassable(int node, int start, int goal) const
+{
+    return node == start || node == goal || world.isFreeNode(node / cellsy, node % cellsy);
+}
+
+bool VoronoiPlanner::walkToSkeleton(const QPointF &fromPos, int from, int start, int goal, QVector<int> *cells) const
+{
+    qreal inf = std::numeric_limits<qreal>::max();
+    ArenaScope scope;
+    ArenaVector<qreal> g(cellsx * cellsy, inf);
+    ArenaVector<int> parent(cellsx * cellsy, -1);
+    typedef QPair<qreal, int> Entry;// (g, node)
+    std::priority_queue<Entry, ArenaVector<Entry>, std::greater<Entry> > open;
+    g[from] = 0.0;
+    open.push(qMakePair(0.0, from));
+    while (!open.empty())
+    {
+        qreal d = open.top().first;
+        int k = open.top().second;
+        open.pop();
+        if (d > g[k])
+            continue;
+        lastExpanded++;
+        if (skeleton[k])
+        {
+            cells->clear();
+            for (int c = k; c != -1; c = parent[c])
+                cells->append(c);
+            return true;
+        }
+        int i = k / cellsy, j = k % cellsy;
+        for (int r = 0; r < 8; r++)
+        {
+            int ni = i + ringx[r], nj = j + ringy[r];
+            if (ni < 0 || ni >= cellsx || nj < 0 || nj >= cellsy)
+                continue;
+            int n = ni * cellsy + nj;
+            qreal ng = d + (r % 2 == 0 ? 1.0 : diagonal);
+            if (ng < g[n] && isPassable(n, start, goal) && (k != from || world.gridLineOfSight(fromPos, nodePos(n))))
+            {
+                g[n] = ng;
+                parent[n] = k;
+                open.push(qMakePair(ng, n));
+            }
+        }
+    }
+    return false;
+}
+
+QVector<VoronoiPlanner::Link> VoronoiPlanner::linksOf(int node) const
+{
+    QVector<Link> links;
+    if (vertexOf[node] >= 0)
+    {
+        Link l = {vertexOf[node], 0.0, -1, 0, 0};
+        links.append(l);
+        return links;
+    }
+    int c = corridorOf[node], m = indexInCorridor[node];
+    const Corridor &cor = corridors[c];
+    Link toA = {cor.a, cor.prefix[m], c, m, 0};
+    Link toB = {cor.b, cor.prefix.back() - cor.prefix[m], c, m, cor.cells.size() - 1};
+    links.append(toA);
+    links.append(toB);
+    return links;
+}
+
+void VoronoiPlanner::appendCells(const Link &link, bool reversed, QVector<int> *cells) const
+{
+    if (link.corridor < 0)
+        return;
+    const QVector<int> &c = corridors[link.corridor].cells;
+    int from = reversed ? link.to : link.from, to = reversed ? link.from : link.to;
+    int step = from <= to ? 1 : -1;
+    for (int m = from; m != to + step; m += step)
+    {
+        if (cells->isEmpty() || cells->back() != c[m])
+            cells->append(c[m]);
+    }
+}
+
+QVector<QPointF> VoronoiPlanner::smoothPath(const QVector<QPointF> &path) const
+{
+    QVector<QPointF> ans;
+    if (path.isEmpty())
+        return ans;
+    ans.append(path[0]);
+    int anchor = 0;
+    for (int i = 2; i < path.size(); i++)
+    {
+        if (!world.gridLineOfSight(path[anchor], path[i]))
+        {
+            anchor = i - 1;
+            ans.append(path[anchor]);
+        }
+    }
+    if (path.size() > 1)
+        ans.append(path.back());
+    return ans;
+}
+
+QVector<QPointF> VoronoiPlanner::getPath(const QPointF &startPos, const QPointF &targetPos) const
+{
+    lastExpanded = 0;
+    lastRebuilt = false;
+    refresh();
+
+    QPoint sn = world.nodeAt(startPos), gn = world.nodeAt(targetPos);
+    if (sn.x() < 0 || sn.x() >= cellsx || sn.y() < 0 || sn.y() >= cellsy ||
+        gn.x() < 0 || gn.x() >= cellsx || gn.y() < 0 || gn.y() >= cellsy)
+    {
+        return QVector<QPointF>();
+    }
+    QVector<QPointF> path;
+    path.append(startPos);
+    if (world.gridLineOfSight(startPos, targetPos))
+    {
+        path.append(targetPos);
+        return path;
+    }
+
+    int start = sn.x() * cellsy + sn.y(), goal = gn.x() * cellsy + gn.y();
+    QVector<int> startCells, goalCells;// From the skeleton to the query ends
+    if (!walkToSkeleton(startPos, start, start, goal, &startCells) ||
+        !walkToSkeleton(targetPos, goal, start, goal, &goalCells))
+        return QVector<QPointF>();
+    QVector<Link> startLinks = linksOf(startCells.front()), goalLinks = linksOf(goalCells.front());
+
+    // Dijkstra over the junctions with two extra nodes: the start(n) and the goal(n + 1), linked along their corridors.
+    // via is the corridor an edge went along, or -2 - the index of the start/goal link, or -1 for the direct way inside one corridor.
+    int n = vertexCells.size(), startNode = n, goalNode = n + 1;
+    qreal inf = std::numeric_limits<qreal>::max();
+    ArenaScope scope;
+    ArenaVector<qreal> g(n + 2, inf);
+    ArenaVector<int> parent(n + 2, -1), via(n + 2, 0);
+    typedef QPair<qreal, int> Entry;// (g, node)
+    std::priority_queue<Entry, ArenaVector<Entry>, std::greater<Entry> > open;
+    g[startNode] = 0.0;
+    open.push(qMakePair(0.0, startNode));
+
+    Link direct = {-1, 0.0, -1, 0, 0};
+    int sc = corridorOf[startCells.front()], gc = corridorOf[goalCells.front()];
+    if (startCells.front() == goalCells.front())
+    {
+        g[goalNode] = 0.0;
+        parent[goalNode] = startNode;
+        via[goalNode] = -1;
+    }
+    else if (sc >= 0 && sc == gc)
+    {
+        int from = indexInCorridor[startCells.front()], to = indexInCorridor[goalCells.front()];
+        direct.corridor = sc;
+        direct.from = from;
+        direct.to = to;
+        g[goalNode] = qAbs(corridors[sc].prefix[to] - corridors[sc].prefix[from]);
+        parent[goalNode] = startNode;
+        via[goalNode] = -1;
+    }
+    if (g[goalNode] < inf)
+        open.push(qMakePair(g[goalNode], goalNode));
+
+    while (!open.empty())
+    {
+        qreal d = open.top().first;
+        int u = open.top().second;
+        open.pop();
+        if (d > g[u])
+            continue;
+        if (u == goalNode)
+            break;
+        if (u == startNode)
+        {
+            for (int l = 0; l < startLinks.size(); l++)
+            {
+                int v = startLinks[l].vertex;
+                if (startLinks[l].cost < g[v])
+                {
+                    g[v] = startLinks[l].cost;
+                    parent[v] = startNode;
+                    via[v] = -2 - l;
+                    open.push(qMakePair(g[v], v));
+                }
+            }
+            continue;
+        }
+        for (int e = 0; e < vertexCorridors[u].size(); e++)
+        {
+            const Corridor &c = corridors[vertexCorridors[u][e]];
+            int v = c.a == u ? c.b : c.a;
+            if (v != u && d + c.prefix.back() < g[v])
+            {
+                g[v] = d + c.prefix.back();
+                parent[v] = u;
+                via[v] = vertexCorridors[u][e];
+                open.push(qMakePair(g[v], v));
+            }
+        }
+        for (int l = 0; l < goalLinks.size(); l++)
+        {
+            if (goalLinks[l].vertex == u && d + goalLinks[l].cost < g[goalNode])
+            {
+                g[goalNode] = d + goalLinks[l].cost;
+                parent[goalNode] = u;
+                via[goalNode] = -2 - l;
+                open.push(qMakePair(g[goalNode], goalNode));
+            }
+        }
+    }
+    if (g[goalNode] == inf)
+        return QVector<QPointF>();
+
+    QVector<int> steps;// The nodes from the goal back to the start
+    for (int u = goalNode; u != startNode; u = parent[u])
+        steps.append(u);
+    std::reverse(steps.begin(), steps.end());
+
+    QVector<int> cells;
+    for (int m = startCells.size() - 1; m >= 0; m--)
+        cells.append(startCells[m]);
+    int prev = startNode;
+    for (int s = 0; s < steps.size(); s++)
+    {
+        int u = steps[s];
+        if (via[u] == -1)
+        {
+            appendCells(direct, false, &cells);
+        }
+        else if (via[u] <= -2)
+        {
+            if (prev == startNode)
+                appendCells(startLinks[-2 - via[u]], false, &cells);
+            else
+                appendCells(goalLinks[-2 - via[u]], true, &cells);
+        }
+        else
+        {
+            const Corridor &c = corridors[via[u]];
+            Link along = {u, 0.0, via[u], 0, c.cells.size() - 1};
+            appendCells(along, c.a != prev, &cells);
+        }
+        prev = u;
+    }
+    for (int m = 0; m < goalCells.size(); m++)
+    {
+        if (cells.back() != goalCells[m])
+            cells.append(goalCells[m]);
+    }
+
+    for (int i = 1; i + 1 < cells.size(); i++)
+        path.append(nodePos(cells[i]));
+    path.append(targetPos);
+    return smoothPath(path);
+}
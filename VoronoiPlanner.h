@@ -0,0 +1,74 @@
+#ifndef VORONOIPLANNER_H
+#define VORONOIPLANNER_H
+
+#include <QtGui>
+
+#include "Planner.h"
+#include "Arena.h"
+
+// A roadmap on the generalized Voronoi diagram of the known free space: the grid nodes equally far from two different
+// obstacles(the map walls and the undiscovered zone). A brushfire from the obstacles finds the nearest obstacle node of each
+// free node, the skeleton is where the nearest obstacles of the neighbours are far apart. It's thinned to one node width,
+// the short spurs are pruned, and what's left is cut into junctions and the corridors between them, so the graph is small
+// and doesn't depend on the walls' vertex count. A query walks from the start and from the target to the nearest skeleton node,
+// searches the junction graph between them and smooths the result with the grid line of sight.
+// The roadmap is rebuilt on the first query after the world has changed(see World::revision).
+class VoronoiPlanner: public Planner
+{
+public:
+    VoronoiPlanner(const World &world_);
+
+    QString name() const;
+    QVector<QPointF> getPath(const QPointF &startPos, const QPointF &targetPos) const;
+    QString lastQueryStats() const;
+
+    int vertexCount() const { refresh(); return vertexCells.size(); }
+    int corridorCount() const { refresh(); return corridors.size(); }
+
+private:
+    struct Corridor
+    {
+        int a, b;// The vertices at its ends, a == b for a loop
+        QVector<int> cells;// From a's node to b's node, both included
+        QVector<qreal> prefix;// The length from a along the cells, in pixels
+    };
+
+    // The ways a query end reaches the junction graph: along its corridor to one of the ends
+    struct Link
+    {
+        int vertex;
+        qreal cost;
+        int corridor, from, to;// The cells corridor[from..to] in that order, corridor is -1 if the end is right on the vertex
+    };
+
+    void refresh() const;
+    void brushfire(ArenaVector<int> *nearest) const;
+    void thin() const;// Removes the skeleton nodes which don't connect anything, until the skeleton is one node wide
+    void extractCorridors() const;
+    bool pruneSpurs() const;// Returns true if anything was removed
+
+    QPointF nodePos(int node) const;
+    int skeletonNeighbours(int node) const;
+    bool isPassable(int node, int start, int goal) const;// Free, or one of the query ends
+    // Dijkstra to the nearest skeleton node, cells go from it to from. The first step is checked against the walls from fromPos.
+    bool walkToSkeleton(const QPointF &fromPos, int from, int start, int goal, QVector<int> *cells) const;
+    QVector<Link> linksOf(int node) const;
+    void appendCells(const Link &link, bool reversed, QVector<int> *cells) const;
+
+    QVector<QPointF> smoothPath(const QVector<QPointF> &path) const;
+
+    int cellsx, cellsy;
+
+    mutable int builtRevision;
+    mutable QVector<float> clearance;// By node, the distance to the nearest obstacle node in pixels
+    mutable QVector<char> skeleton;
+    mutable QVector<int> vertexOf, corridorOf, indexInCorridor;// By node, -1 if it's not a vertex/inside a corridor
+    mutable QVector<int> vertexCells;
+    mutable QVector<QVector<int> > vertexCorridors;
+    mutable QVector<Corridor> corridors;
+
+    mutable int lastExpanded;
+    mutable bool lastRebuilt;
+};
+
+#endif //VORONOIPLANNER_H
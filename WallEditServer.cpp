@@ -0,0 +1,79 @@
+#include <QtGui>
+#include <QtNetwork>
+
+#include "WallEditServer.h"
+
+WallEditServer::WallEditServer(QObject *parent):
+    QObject(parent),
+    server(new QLocalServer(this))
+{
+    connect(server, SIGNAL(newConnection()), this, SLOT(acceptConnection()));
+}
+
+bool WallEditServer::listen(const QString &name)
+{
+    QLocalServer::removeServer(name);
+    return server->listen(name);
+}
+
+void WallEditServer::acceptConnection()
+{
+    while (server->hasPendingConnections())
+    {
+        QLocalSocket *socket = server->nextPendingConnection();
+        connect(socket, SIGNAL(readyRead()), this, SLOT(readCommands()));
+        connect(socket, SIGNAL(disconnected()), socket, SLOT(deleteLater()));
+    }
+}
+
+void WallEditServer::readCommands()
+{
+    QLocalSocket *socket = qobject_cast<QLocalSocket *>(sender());
+    if (socket == NULL)
+        return;
+    while (socket->canReadLine())// A part of a line waits for the rest
+    {
+        QString line = QString::fromLatin1(socket->readLine().constData()).simplified();
+        if (!line.isEmpty() && !parse(line))
+        {
+#ifdef DEBUG
+            qDebug() << "Wall edit skipped:" << line << endl;
+#endif
+        }
+    }
+}
+
+bool WallEditServer::parse(const QString &line)
+{
+    QStringList words = line.split(' ');
+    if (words.size() < 2)
+        return false;
+    bool ok = true;
+    int id = words[1].toInt(&ok);
+    QVector<qreal> numbers;
+    for (int i = 2; i < words.size() && ok; i++)
+        numbers.append(words[i].toDouble(&ok));
+    if (!ok)
+        return false;
+
+    if (words[0] == "add" && !numbers.isEmpty() && numbers.size() % 2 == 0)
+    {
+        QVector<QPointF> points;
+        for (int i = 0; i < numbers.size(); i += 2)
+            points.append(QPointF(numbers[i], numbers[i + 1]));
+        emit wallAdded(id, points);
+    }
+    else if (words[0] == "move" && numbers.size() == 2)
+    {
+        emit wallMoved(id, QPointF(numbers[0], numbers[1]));
+    }
+    else if (words[0] == "remove" && numbers.isEmpty())
+    {
+        emit wallRemoved(id);
+    }
+    else
+    {
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,38 @@
+#ifndef WALLEDITSERVER_H
+#define WALLEDITSERVER_H
+
+#include <QtGui>
+#include <QtNetwork>
+
+// Takes the wall edits from a local socket(a named pipe on Windows), so a script can move the obstacles while the exploration runs:
+//     printf 'add 1 100 100 200 100 200 200\nmove 1 5 0\nremove 1\n' | nc -U /tmp/<name>
+// One command per line, the numbers are separated by spaces:
+//     add <id> x1 y1 x2 y2 ...    a polyline, replaces the wall with the same id
+//     move <id> dx dy
+//     remove <id>
+// The ids are the script's own, see Visualisation::addWall. A line that can't be parsed is skipped, any number of scripts can be connected.
+class WallEditServer: public QObject
+{
+    Q_OBJECT
+
+public:
+    WallEditServer(QObject *parent = NULL);
+
+    bool listen(const QString &name);// Replaces a server left behind by a crashed run
+
+signals:
+    void wallAdded(int id, const QVector<QPointF> &points);
+    void wallRemoved(int id);
+    void wallMoved(int id, const QPointF &offset);
+
+private slots:
+    void acceptConnection();
+    void readCommands();
+
+private:
+    bool parse(const QString &line);// Emits the signal, returns false if the line is broken
+
+    QLocalServer *server;
+};
+
+#endif //WALLEDITSERVER_H
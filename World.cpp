@@ -0,0 +1,813 @@
+#include <QtGui>
+
+#include <algorithm>
+
+#include "World.h"
+#include "tools.h"
+#include "Geometry.h"
+#include "SquareWalker.h"
+#include "ConfigurationSpace.h"
+#include "PrecomputeCache.h"
+#include "TraceFormat.h"
+
+World::World(int width_, int height_, const QVector<QVector<QPointF> > &map_, qreal cellSize_):
+    width(width_), height(height_),
+    pivotOffset(8.0), cellSize(cellSize_), minPocketArea(256.0), robotRadius(0.0),
+    revision(0), wallsRevision(0),
+    wallsEdited(false)
+{
+    int cellsx = width / cellSize + 1;
+    int cellsy = height / cellSize + 1;
+    isDiscovered = QVector<QVector<bool> > (cellsx, QVector<bool> (cellsy, false));
+    discoveryTree.build(isDiscovered);
+    occupancy.resize(cellsx, cellsy);
+
+    initialMap = map_;
+    map = withFieldEdges(map_, width, height);
+    if (!restore(true))
+    {
+        distanceField.build(map, width, height, cellSize / 4);
+        sightSets = PotentiallyVisibleSets::shared(map, width, height);
+    }
+    setRobotRadius(0.0);// From the same cache file
+}
+
+QVector<QVector<QPointF> > World::withFieldEdges(const QVector<QVector<QPointF> > &map, int width, int height)
+{
+    QPointF p00 = QPointF(0, 0), p10 = QPointF(width - 1, 0), p01 = QPointF(0, height - 1), p11 = QPointF(width - 1, height - 1);
+    QVector<QPointF> edge;
+    edge.append(p00);
+    edge.append(p01);
+    edge.append(p11);
+    edge.append(p10);
+    edge.append(p00);
+    QVector<QVector<QPointF> > walls = map;
+    walls.append(edge);
+    return walls;
+}
+
+void World::setRobotRadius(qreal radius)
+{
+    commitWalls();// Everything below is derived from the map
+    robotRadius = radius;
+    if (!restore(false))
+    {
+        obstacles = radius > 0 ? ConfigurationSpace::inflate(map, radius) : map;
+        if (radius > 0)
+        {
+            inflatedField.build(obstacles, width, height, cellSize / 4, false);
+            inflatedSets = PotentiallyVisibleSets::shared(obstacles, width, height);
+        }
+        freeSpace.build(isDiscovered, obstacleField(), cellSize);
+        updateMapPivots(QVector<QVector<QPointF> >(), QRectF());
+        store();
+    }
+    markWallSquares();
+    revision++;
+}
+
+namespace
+{
+
+// Field by field, like the traces, the structs' padding isn't written
+QByteArray pivotBytes(const QVector<QVector<World::Pivot> > &pivots)
+{
+    using namespace TraceFormat;
+    QByteArray out;
+    writeVarint(&out, pivots.size());
+    for (int i = 0; i < pivots.size(); i++)
+    {
+        writeVarint(&out, pivots[i].size());
+        for (int k = 0; k < pivots[i].size(); k++)
+        {
+            const World::Pivot &p = pivots[i][k];
+            QPointF points[4] = {p.pos, p.prev, p.vertex, p.next};
+            for (int n = 0; n < 4; n++)
+            {
+                writeReal(&out, points[n].x());
+                writeReal(&out, points[n].y());
+            }
+            writeByte(&out, p.isCorner);
+        }
+    }
+    return out;
+}
+
+bool readPivots(const QByteArray &bytes, QVector<QVector<World::Pivot> > *pivots)
+{
+    TraceFormat::Reader r(bytes.constData(), bytes.constData() + bytes.size());
+    int count = r.varint();
+    if (!r.ok() || count > bytes.size())
+        return false;
+    pivots->resize(count);
+    for (int i = 0; i < count; i++)
+    {
+        int size = r.varint();
+        if (!r.ok() || size > bytes.size())
+            return false;
+        (*pivots)[i].resize(size);
+        for (int k = 0; k < size; k++)
+        {
+            World::Pivot &p = (*pivots)[i][k];
+            QPointF *points[4] = {&p.pos, &p.prev, &p.vertex, &p.next};
+            for (int n = 0; n < 4; n++)
+            {
+                qreal x = r.real(), y = r.real();
+                *points[n] = QPointF(x, y);
+            }
+            p.isCorner = r.byte() != 0;
+        }
+    }
+    return r.ok() && r.atEnd();
+}
+
+}
+
+QByteArray World::cacheKey() const
+{
+    return PrecomputeCache::key(map, width, height, cellSize, pivotOffset, robotRadius);
+}
+
+bool World::restore(bool withMap)
+{
+    PrecomputeCache::Reader cache;
+    if (!cache.open(cacheKey()))
+        return false;
+    if (withMap && (!distanceField.restore(cache, "field", map, width, height, cellSize / 4) || !sightSets.restore(cache, "sight", map, width, height)))
+        return false;
+    if (!cache.read("obstacles", &obstacles))
+        return false;
+    if (robotRadius > 0 && (!inflatedField.restore(cache, "inflatedField", obstacles, width, height, cellSize / 4, false) ||
+                            !inflatedSets.restore(cache, "inflatedSight", obstacles, width, height)))
+    {
+        return false;
+    }
+    QByteArray pivots;
+    if (!freeSpace.restore(cache, "freeSpace", isDiscovered) || !cache.read("pivots", &pivots) || !readPivots(pivots, &obstaclePivots) ||
+        obstaclePivots.size() != obstacles.size())
+    {
+        return false;
+    }
+    mapPivots.clear();
+    for (int i = 0; i < obstaclePivots.size(); i++)
+        mapPivots += obstaclePivots[i];
+#ifdef DEBUG
+    qDebug() << "World restored from the cache:" << mapPivots.size() << "pivots" << endl;
+#endif
+    return true;
+}
+
+void World::store() const
+{
+    if (PrecomputeCache::directory().isEmpty())
+        return;
+    PrecomputeCache::Writer cache;// Each file has the map's structures too, so any radius can be the first one
+    distanceField.store(&cache, "field");
+    sightSets.store(&cache, "sight");
+    cache.add("obstacles", obstacles);
+    if (robotRadius > 0)
+    {
+        inflatedField.store(&cache, "inflatedField");
+        inflatedSets.store(&cache, "inflatedSight");
+    }
+    freeSpace.store(&cache, "freeSpace");
+    cache.add("pivots", pivotBytes(obstaclePivots));
+    cache.save(cacheKey());
+}
+
+void World::markWallSquares()
+{
+    int cellsx = isDiscovered.size(), cellsy = isDiscovered[0].size();
+    wallSquares = QVector<QVector<bool> > (cellsx, QVector<bool> (cellsy, false));
+    for (int i = 0; i < obstacles.size(); i++)
+    {
+        for (int j = 0; j < obstacles[i].size() - 1; j++)
+        {
+            QPointF a = obstacles[i][j] / cellSize + QPointF(0.5, 0.5), b = obstacles[i][j + 1] / cellSize + QPointF(0.5, 0.5);
+            SquareWalker w(a.x(), a.y(), b.x(), b.y());
+            do
+            {
+                if (w.x() >= 0 && w.x() < cellsx && w.y() >= 0 && w.y() < cellsy)
+                    wallSquares[w.x()][w.y()] = true;
+            } while (w.next());
+        }
+    }
+    if (robotRadius > 0)// The sensor sees inside the grown walls, those nodes get discovered but mustn't be walked through
+    {
+        for (int i = 0; i < cellsx; i++)
+        {
+            for (int j = 0; j < cellsy; j++)
+            {
+                if (clearance(cellSize * QPointF(i, j)) < 0)
+                    wallSquares[i][j] = true;
+            }
+        }
+    }
+    wallsRevision++;
+}
+
+void World::updateMapPivots(const QVector<QVector<QPointF> > &before, const QRectF &changed)
+{
+    QVector<QVector<Pivot> > pivots(obstacles.size());
+    mapPivots.clear();
+    qreal reach = pivotOffset + robotRadius;// The pivots that get into the walls are dropped, so the close edits change them too
+    for (int i = 0; i < obstacles.size(); i++)
+    {
+        if (i < before.size() && obstacles[i] == before[i] &&
+            !QPolygonF(obstacles[i]).boundingRect().adjusted(-reach, -reach, reach, reach).intersects(changed))
+            pivots[i] = obstaclePivots[i];
+        else if (!obstacles[i].isEmpty())
+            getPivots(obstacles[i], true, &pivots[i]);
+        mapPivots += pivots[i];
+    }
+    obstaclePivots = pivots;
+}
+
+namespace
+{
+
+QRectF changedArea(const QVector<Segment> &before, const QVector<Segment> &after)// The bounding box of the segments only one of them has
+{
+    QVector<int> match = matchSegments(before, after);
+    QVector<bool> kept(after.size(), false);
+    QPolygonF ends;
+    for (int k = 0; k < before.size(); k++)
+    {
+        if (match[k] >= 0)
+            kept[match[k]] = true;
+        else
+            ends << before[k].a.toPointF() << before[k].b.toPointF();
+    }
+    for (int k = 0; k < after.size(); k++)
+    {
+        if (!kept[k])
+            ends << after[k].a.toPointF() << after[k].b.toPointF();
+    }
+    return ends.boundingRect();
+}
+
+}
+
+int World::addWall(const QVector<QPointF> &points)
+{
+    if (points.isEmpty())
+        return -1;
+    int index = map.size() - 1;// Before the field edges, unless a removed wall left a slot
+    for (int i = 0; i < map.size() - 1; i++)
+    {
+        if (map[i].isEmpty())
+        {
+            index = i;
+            break;
+        }
+    }
+    if (index == map.size() - 1)
+        map.insert(index, points);
+    else
+        map[index] = points;
+    wallsEdited = true;
+    return index;
+}
+
+bool World::removeWall(int index)
+{
+    if (index < 0 || index >= map.size() - 1 || map[index].isEmpty())
+        return false;
+    map[index].clear();
+    wallsEdited = true;
+    return true;
+}
+
+bool World::moveWall(int index, const QPointF &offset)
+{
+    if (index < 0 || index >= map.size() - 1 || map[index].isEmpty())
+        return false;
+    for (int j = 0; j < map[index].size(); j++)
+        map[index][j] += offset;
+    wallsEdited = true;
+    return true;
+}
+
+void World::setWalls(const QVector<QVector<QPointF> > &walls)
+{
+    map = withFieldEdges(walls, width, height);
+    wallsEdited = true;
+}
+
+void World::commitWalls()
+{
+    if (!wallsEdited)
+        return;
+    wallsEdited = false;
+    distanceField.update(map);
+    sightSets.update(map);
+    QVector<QVector<QPointF> > before = obstacles;
+    obstacles = robotRadius > 0 ? ConfigurationSpace::inflate(map, robotRadius) : map;
+    if (robotRadius > 0)
+    {
+        inflatedField.update(obstacles);
+        inflatedSets.update(obstacles);
+    }
+
+    QRectF changed = changedArea(segmentsOf(before), segmentsOf(obstacles));
+    if (!changed.isNull())
+    {
+        // A link between two nodes only changes if a changed segment crosses it
+        changed = changed.adjusted(-cellSize, -cellSize, cellSize, cellSize);
+        QRect nodes(qFloor(changed.left() / cellSize), qFloor(changed.top() / cellSize),
+                    qCeil(changed.width() / cellSize) + 1, qCeil(changed.height() / cellSize) + 1);
+        freeSpace.rebuild(isDiscovered, obstacleField(), cellSize, nodes);
+        markWallSquares();
+    }
+    updateMapPivots(before, changed);// A lone point has no segments, but has pivots
+    revision++;
+}
+
+QPointF World::pushedOut(const QPointF &p) const
+{
+    QPointF q = p;
+    for (int k = 0; k < 4 && clearance(q) < 0; k++)// The gradient may turn near the corners, a few steps are enough
+        q += ((-clearance(q) + 0.5) * distanceField.gradient(q)).toPointF();
+    return q;
+}
+
+bool World::getVertexPivot(const QPointF &a, const QPointF &b, const QPointF &c, Pivot *pivot) const
+{
+    Vec2 vb(b);
+    Vec2 med = (Vec2(a) - vb).normalized() + (Vec2(c) - vb).normalized();// Points inside the smaller angle, so the reflex side is the opposite one.
+    qreal len = med.length();
+    if (len < 0.001) // a, b and c are on one line, a path never needs to turn here
+        return false;
+
+    pivot->pos = (vb - med * (pivotOffset / len)).toPointF();
+    pivot->prev = a;
+    pivot->vertex = b;
+    pivot->next = c;
+    pivot->isCorner = true;
+    return true;
+}
+
+namespace
+{
+
+qreal signedArea(const QVector<QPointF> &v)// Shoelace formula for the enclosed polyline, the sign gives its orientation.
+{
+    qreal area = 0.0;
+    for (int i = 0; i < v.size() - 1; i++)
+        area += Vec2(v[i]).cross(v[i + 1]);
+    return area / 2.0;
+}
+
+}
+
+void World::getPivots(const QVector<QPointF> &v, bool mapPivots, QVector<Pivot> *pivots) const
+{
+    ArenaScope scope;
+    QVector<Pivot> &ans = *pivots;
+    int first = ans.size();
+    Pivot pv;
+    pv.isCorner = false;
+    if (v.size() == 1)
+    {
+        pv.pos = v.front() - QPointF(pivotOffset, 0);
+        ans.append(pv);
+        pv.pos = v.front() - QPointF(0, pivotOffset);
+        ans.append(pv);
+        pv.pos = v.front() + QPointF(pivotOffset, 0);
+        ans.append(pv);
+        pv.pos = v.front() + QPointF(0, pivotOffset);
+        ans.append(pv);
+        return;
+    }
+
+    // Only the corners which are reflex from the free space side can be on a shortest path.
+    // Map walls have no thickness, so both their sides are free and each corner has exactly one reflex side.
+    // Virtual walls enclose a zone, which is free for the discovered zone and blocked for the undiscovered ones,
+    // so the reflex side has to be checked against the polyline orientation.
+    bool enclosed = v.front() == v.back() && v.size() > 2;
+    qreal orientation = 0.0;
+    bool innerZone = false;
+    if (!mapPivots && enclosed)
+    {
+        orientation = signedArea(v);
+        innerZone = isDiscovered[v[0].x() / cellSize][v[0].y() / cellSize];
+    }
+
+    ArenaVector<QPair<int, int> > corners;// (vertex, previous vertex) pairs, the next one always follows the vertex
+    if (enclosed)
+    {
+        corners.push_back(qMakePair(0, v.size() - 2));
+    }
+    else
+    {
+        // The line is not enclosed, so we'll use two points on its extension to the first and the last vertices.
+        QLineF dir1 = QLineF(v[0], v[1]),
+               dir2 = QLineF(v[v.size() - 1], v[v.size() - 2]);
+        dir1.setLength(pivotOffset);
+        dir2.setLength(pivotOffset);
+        pv.pos = dir1.p1() - (dir1.p2() - dir1.p1());
+        ans.push_back(pv);
+        pv.pos = dir2.p1() - (dir2.p2() - dir2.p1());
+        ans.push_back(pv);
+
+        // And four on the perpendiculars to the first and the last segment(extended to both sides).
+        QLineF norm1 = QLineF(v[0], v[1]).normalVector(),
+               norm2 = QLineF(v[v.size() - 1], v[v.size() - 2]).normalVector();
+        norm1.setLength(pivotOffset);
+        norm2.setLength(pivotOffset);
+        pv.pos = norm1.p2();
+        ans.push_back(pv);
+        pv.pos = norm1.p1() - (norm1.p2() - norm1.p1());
+        ans.push_back(pv);
+        pv.pos = norm2.p2();
+        ans.push_back(pv);
+        pv.pos = norm2.p1() - (norm2.p2() - norm2.p1());
+        ans.push_back(pv);
+    }
+    for (int i = 1; i < v.size() - 1; i++)
+        corners.push_back(qMakePair(i, i - 1));
+
+    for (int i = 0; i < int(corners.size()); i++)
+    {
+        const QPointF &a = v[corners[i].second], &b = v[corners[i].first], &c = v[corners[i].first + 1];
+        if (!getVertexPivot(a, b, c, &pv))
+            continue;
+        qreal turn = Vec2(b - a).cross(c - b);
+        if (qAbs(turn) > 0.001 && qAbs(orientation) > 0.001 && ((turn * orientation > 0) == innerZone))
+            continue;// the reflex side is blocked
+        ans.append(pv);
+    }
+
+    QRectF field(0, 0, width, height);
+    for (int i = ans.size() - 1; i >= first; i--)
+    {
+        if (!field.contains(ans[i].pos) || clearance(ans[i].pos) < 0)// Can't get inside the enclosed walls anyway
+            ans.remove(i);
+    }
+}
+
+bool World::isTangent(const Pivot &p, const QPointF &q) const
+{
+    if (!p.isCorner)
+        return true;
+    // The pivot is offset from the vertex, so the line is tested against the corner itself: the vertex and
+    // the points on its arms at the same offset must all be on one side. The arms' directions alone reject
+    // the lines running along an arm from pivot to pivot, they are slightly tilted.
+    Vec2 dir = Vec2(q) - p.pos;
+    Vec2 v = Vec2(p.vertex) - p.pos;
+    qreal sv = dir.cross(v);
+    qreal sa = dir.cross(v + (Vec2(p.prev) - p.vertex).normalized() * pivotOffset);
+    qreal sc = dir.cross(v + (Vec2(p.next) - p.vertex).normalized() * pivotOffset);
+    return (sv >= 0 && sa >= 0 && sc >= 0) || (sv <= 0 && sa <= 0 && sc <= 0);
+}
+
+void World::setDiscovered(int i, int j)
+{
+    if (isDiscovered[i][j])
+        return;
+    isDiscovered[i][j] = true;
+    discoveryTree.set(i, j, true);
+    freeSpace.add(i, j);
+}
+
+void World::syncDiscoveryTree()
+{
+    discoveryTree.build(isDiscovered);
+    freeSpace.relabel(isDiscovered);
+}
+
+int World::freeSpaceAt(const QPointF &p) const
+{
+    int ci = qFloor(p.x() / cellSize), cj = qFloor(p.y() / cellSize);
+    for (int i = ci; i <= ci + 1; i++)
+    {
+        for (int j = cj; j <= cj + 1; j++)
+        {
+            if (i >= 0 && i < isDiscovered.size() && j >= 0 && j < isDiscovered[0].size() &&
+                isDiscovered[i][j] && !wallOnPath(p, cellSize * QPointF(i, j)))
+            {
+                return freeSpace.label(i, j);
+            }
+        }
+    }
+    return -1;
+}
+
+namespace
+{
+
+int findRoot(ArenaVector<int> &parent, int k)
+{
+    while (parent[k] != k)
+    {
+        parent[k] = parent[parent[k]];
+        k = parent[k];
+    }
+    return k;
+}
+
+bool isBefore(const QPoint &a, const QPoint &b)// In the order of the grid scan, i first
+{
+    return a.x() < b.x() || (a.x() == b.x() && a.y() < b.y());
+}
+
+bool isFirstBefore(const QPair<QPoint, int> &a, const QPair<QPoint, int> &b)
+{
+    return isBefore(a.first, b.first);
+}
+
+}
+
+void World::determineConnComp(ArenaVector<int> *comp) const
+{
+    int cellsx = isDiscovered.size(), cellsy = isDiscovered[0].size();
+    ArenaVector<DiscoveryTree::Leaf> leaves;
+    discoveryTree.getLeaves(QRect(0, 0, cellsx, cellsy), &leaves);
+
+    ArenaVector<int> &isVisited = *comp;// Holds the leaf of each cell first, then its component
+    isVisited.resize(cellsx * cellsy);
+    for (int k = 0; k < int(leaves.size()); k++)
+    {
+        const QRect &r = leaves[k].cells;
+        for (int i = r.left(); i <= r.right(); i++)
+            std::fill(isVisited.begin() + i * cellsy + r.top(), isVisited.begin() + i * cellsy + r.bottom() + 1, k);
+    }
+
+    // The unknown leaves touching each other(diagonally too) are joined. Each leaf looks at the column to its right
+    // and the row below it, the other sides are seen by the neighbours there.
+    ArenaVector<int> parent(leaves.size());
+    for (int k = 0; k < int(leaves.size()); k++)
+        parent[k] = k;
+    for (int k = 0; k < int(leaves.size()); k++)
+    {
+        if (leaves[k].discovered)
+            continue;
+        const QRect &r = leaves[k].cells;
+        for (int j = qMax(r.top() - 1, 0); j <= qMin(r.bottom() + 1, cellsy - 1) && r.right() + 1 < cellsx; )
+        {
+            int other = isVisited[(r.right() + 1) * cellsy + j];
+            if (!leaves[other].discovered)
+                parent[findRoot(parent, other)] = findRoot(parent, k);
+            j = leaves[other].cells.bottom() + 1;// The rest of its side is the same leaf
+        }
+        for (int i = qMax(r.left() - 1, 0); i <= r.right() && r.bottom() + 1 < cellsy; )
+        {
+            int other = isVisited[i * cellsy + r.bottom() + 1];
+            if (!leaves[other].discovered)
+                parent[findRoot(parent, other)] = findRoot(parent, k);
+            i = leaves[other].cells.right() + 1;
+        }
+    }
+
+    // The discovered zone is 1, the components are numbered from 2 in the order of their first cells, i first
+    ArenaVector<QPair<QPoint, int> > firstCells;// (the first cell, root)
+    ArenaVector<int> firstOf(leaves.size(), -1);
+    for (int k = 0; k < int(leaves.size()); k++)
+    {
+        if (leaves[k].discovered)
+            continue;
+        int root = findRoot(parent, k);
+        QPoint corner = leaves[k].cells.topLeft();
+        if (firstOf[root] < 0)
+        {
+            firstOf[root] = firstCells.size();
+            firstCells.push_back(qMakePair(corner, root));
+        }
+        if (isBefore(corner, firstCells[firstOf[root]].first))
+            firstCells[firstOf[root]].first = corner;
+    }
+    std::sort(firstCells.begin(), firstCells.end(), isFirstBefore);
+    ArenaVector<int> compOf(leaves.size(), 1);
+    for (size_t c = 0; c < firstCells.size(); c++)
+        compOf[firstCells[c].second] = c + 2;
+
+    for (int k = 0; k < int(leaves.size()); k++)
+    {
+        int id = leaves[k].discovered ? 1 : compOf[findRoot(parent, k)];
+        const QRect &r = leaves[k].cells;
+        for (int i = r.left(); i <= r.right(); i++)
+            std::fill(isVisited.begin() + i * cellsy + r.top(), isVisited.begin() + i * cellsy + r.bottom() + 1, id);
+    }
+#ifdef DEBUG
+    dbgCompNumber = QVector<QVector<int> >(cellsx, QVector<int>(cellsy));
+    for (int i = 0; i < cellsx; i++)
+        for (int j = 0; j < cellsy; j++)
+            dbgCompNumber[i][j] = isVisited[i * cellsy + j];
+#endif
+}
+
+namespace
+{
+
+QVector<QPointF> optimizeWall(const ArenaVector<QPointF> &w)// Optimising walls is merging some its consequent segments into one. For example:
+                                                            // {..(20, 100),(20, 200),(20, 300)..} might be merged into {..(20, 100); (20, 300)..}
+                                                            // {..(20, 100),(20, 200),(21, 300)..} can't be merged because the second segment is not on the first segment's line.
+{
+    ArenaVector<QPointF> ans;// Only the result is allocated on the heap, it's kept in World::virtualWalls
+    if (w.size() >= 2)
+    {
+        ans.push_back(w[0]);
+        ans.push_back(w[1]);
+    }
+    else
+    {
+        ans = w;
+    }
+    qreal eps = 0.001;
+    for (size_t i = 2; i < w.size(); i++)
+    {
+        Vec2 l1 = Vec2(ans[ans.size() - 1]) - ans[ans.size() - 2];
+        Vec2 l2 = Vec2(w[i]) - ans[ans.size() - 1];
+        if (qAbs(l1.cross(l2)) < eps * l1.length() * l2.length() && l1.dot(l2) > 0)// the same direction
+        {
+            ans.pop_back();
+        }
+        ans.push_back(w[i]);
+    }
+    QVector<QPointF> wall(ans.size());
+    std::copy(ans.begin(), ans.end(), wall.begin());
+    return wall;
+}
+
+}
+
+void World::updateVirtualWalls()
+{
+    virtualWalls.clear();
+    virtualPivots.clear();
+    revision++;
+
+    ArenaScope scope;
+    int cellsx = isDiscovered.size(), cellsy = isDiscovered[0].size();
+    ArenaVector<int> connComp;
+    determineConnComp(&connComp);
+
+    // One pass for the components' sizes and their leftmost topmost points.
+    ArenaVector<int> compSize;
+    ArenaVector<QPair<int, int> > compStart;
+    for (int j = 0; j < cellsy; j++)
+    {
+        for (int i = 0; i < cellsx; i++)
+        {
+            int comp = connComp[i * cellsy + j];
+            if (comp >= int(compSize.size()))
+            {
+                compSize.resize(comp + 1);
+                compStart.resize(comp + 1);
+            }
+            if (compSize[comp] == 0)
+                compStart[comp] = qMakePair(i, j);
+            compSize[comp]++;
+        }
+    }
+
+    // The planners go through the pockets without the virtual walls, so the free space does too. They only get
+    // smaller as the exploration goes on, so the nodes stay joined until the walls change(freeSpace is relabeled then).
+    for (int i = 0; i < cellsx; i++)
+    {
+        for (int j = 0; j < cellsy; j++)
+        {
+            int comp = connComp[i * cellsy + j];
+            if (comp != 1 && compSize[comp] * cellSize * cellSize < minPocketArea)
+                freeSpace.add(i, j);
+        }
+    }
+
+    for (int curComp = 1; curComp < int(compSize.size()); curComp++)
+    {
+        if (compSize[curComp] == 0)
+            continue;
+        if (curComp != 1 && compSize[curComp] * cellSize * cellSize < minPocketArea)// The first component is the discovered zone itself
+            continue;
+
+        ArenaVector<QPointF> result;
+        int startx = compStart[curComp].first, starty = compStart[curComp].second;
+        int curx = startx, cury = starty;
+
+        int dx[] = {-1, -1, 0, 1, 1,  1,  0, -1};
+        int dy[] = {0 ,  1, 1, 1, 0, -1, -1, -1};
+        int curDir = 4;
+
+        bool startVisited = false;
+        while (!(startVisited && curx == startx && cury == starty))
+        {
+            if (curx == startx && cury == starty)
+                startVisited = true;
+            if (result.size() > 400)
+            {
+//                qDebug() << "oops";
+            }
+            result.push_back(cellSize * QPointF(curx, cury));
+
+            int c = (curDir + 4) % 8;
+            bool foundNew = false;
+            for (int i = c + 1; i < 8 && !foundNew; i++)
+            {
+                int nx = curx + dx[i];
+                int ny = cury + dy[i];
+                if (nx >= 0 && nx < cellsx &&
+                    ny >= 0 && ny < cellsy &&
+                    (connComp[nx * cellsy + ny] == curComp))
+                {
+                    curx = nx;
+                    cury = ny;
+                    foundNew = true;
+                    curDir = i;
+                }
+            }
+            for (int i = 0; i <= c && !foundNew; i++)
+            {
+                int nx = curx + dx[i];
+                int ny = cury + dy[i];
+
+                if (nx >= 0 && nx < cellsx &&
+                    ny >= 0 && ny < cellsy &&
+                    (connComp[nx * cellsy + ny] == curComp))
+                {
+                    curx = nx;
+                    cury = ny;
+                    foundNew = true;
+                    curDir = i;
+                }
+            }
+            if (!foundNew)
+            {
+                break;
+            }
+        }
+        if (result.size() >= 2)
+        {
+            result.push_back(result.front());
+        }
+
+        QVector<QPointF> optResult = optimizeWall(result);
+#ifdef DEBUG
+//        qDebug() << "Result was " << result.size() << " optimized to " << optResult.size() << endl;
+#endif
+        virtualWalls.append(optResult);
+        getPivots(optResult, false, &virtualPivots);
+    }
+}
+
+bool World::wallOnPath(const QPointF &a, const QPointF &b) const
+{
+    return obstacleField().hit(a, b);
+}
+
+bool World::wallInSight(const QPointF &a, const QPointF &b) const
+{
+    return sightSets.hit(a, b);
+}
+
+QPoint World::nodeAt(const QPointF &p) const
+{
+    return QPoint(qFloor(p.x() / cellSize + 0.5), qFloor(p.y() / cellSize + 0.5));
+}
+
+bool World::isFreeNode(int i, int j) const
+{
+    return i >= 0 && i < wallSquares.size() && j >= 0 && j < wallSquares[0].size() &&
+           !wallSquares[i][j] && isDiscovered[i][j];
+}
+
+bool World::gridLineOfSight(const QPointF &a, const QPointF &b) const
+{
+    QPointF sa = a / cellSize + QPointF(0.5, 0.5), sb = b / cellSize + QPointF(0.5, 0.5);
+    SquareWalker w(sa.x(), sa.y(), sb.x(), sb.y());
+    int squares = 0;// Visited, without the side squares of the corners
+    bool sideBlocked = false, sideWall = false, checkedPrecisely = false;
+    do
+    {
+        bool inside = w.x() >= 0 && w.x() < wallSquares.size() && w.y() >= 0 && w.y() < wallSquares[0].size();
+        if (w.isCornerSide() && !w.isLast())
+        {
+            // Exactly through a corner: a blocked side square blocks the sight, a wall may go diagonally through that corner.
+            // Only the corners of the end squares are let through, like the end squares themselves.
+            if (!isFreeNode(w.x(), w.y()))
+            {
+                sideBlocked = true;
+                sideWall = sideWall || !inside || wallSquares[w.x()][w.y()];
+            }
+            continue;
+        }
+        bool end = squares == 0 || w.isLast();
+        if (sideBlocked && squares > 1 && !w.isLast())
+            return false;
+        if (!isFreeNode(w.x(), w.y()))
+        {
+            if (!end || !inside)
+                return false;
+            sideWall = sideWall || wallSquares[w.x()][w.y()];// The ends may be undiscovered, but mustn't cross the walls
+        }
+        if (sideWall && !checkedPrecisely)
+        {
+            if (wallOnPath(a, b))
+                return false;
+            checkedPrecisely = true;
+        }
+        sideBlocked = false;
+        sideWall = false;
+        squares++;
+    } while (w.next());
+    return true;
+}
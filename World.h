@@ -0,0 +1,112 @@
+#ifndef WORLD_H
+#define WORLD_H
+
+#include <QtGui>
+
+#include "Arena.h"
+#include "DistanceField.h"
+#include "DiscoveryTree.h"
+#include "FreeSpaceLabels.h"
+#include "PotentiallyVisibleSets.h"
+#include "OccupancyGrid.h"
+
+// Everything the planners need to know about the field: the walls, the discovered zone and what is derived from them.
+// Owned by the Visualisation, the planners only read it.
+class World
+{
+public:
+    World(int width_, int height_, const QVector<QVector<QPointF> > &map_, qreal cellSize_ = 8.0);
+
+    static QVector<QVector<QPointF> > withFieldEdges(const QVector<QVector<QPointF> > &map, int width, int height);// The walls World::map has for the map
+
+    struct Pivot
+    {
+        QPointF pos;
+        QPointF prev, vertex, next;// The corner the pivot was generated for. Only used if isCorner is set.
+        bool isCorner;// Start/target points and polylines' open ends can be left in any direction, corners only along their tangents.
+    };
+
+    bool getVertexPivot(const QPointF &a, const QPointF &b, const QPointF &c, Pivot *pivot) const;// Calculates the pivot for line [a, b][b, c] on its reflex(> 180 degrees) side. Returns false if there's no corner at b.
+    void getPivots(const QVector<QPointF> &, bool mapPivots, QVector<Pivot> *pivots) const;// Appends the pivots for the polyline(might be enclosed). mapPivots is for correct handling of map pivots generating.
+    bool isTangent(const Pivot &p, const QPointF &q) const;// Returns true if the line from p to q doesn't go inside p's corner. Only such(bitangent) edges can be on a shortest path.
+
+    void setDiscovered(int i, int j);// Use it instead of writing isDiscovered, it keeps discoveryTree and freeSpace in sync
+    void syncDiscoveryTree();// Rebuilds discoveryTree and freeSpace after isDiscovered was written directly(the trace keyframes, the benchmarks)
+    int freeSpaceAt(const QPointF &p) const;// The freeSpace label of a discovered node around p seen from it, -1 if there's none
+
+    void determineConnComp(ArenaVector<int> *comp) const;// A helper function for updateVirtualWalls. The node (i, j) is comp[i * cellsy + j].
+    void updateVirtualWalls();// Also updates virtualPivots
+
+    // The robot is a disc of robotRadius, the planning and the collisions work with its center against the obstacles(see ConfigurationSpace).
+    // The sensor still sees the real map. Rebuilds everything derived from the obstacles, the planners notice it by the revision.
+    void setRobotRadius(qreal radius);
+    QPointF pushedOut(const QPointF &p) const;// The closest point to p the robot's center can be at, p itself if it's already free
+
+    // The walls can be edited while the exploration goes on. An edit only changes map, commitWalls() brings everything derived
+    // from it up to date at once and only where the walls changed, so the many edits between two ticks cost one small update.
+    // A wall keeps its number in map, a removed one leaves an empty polyline behind. The field edges(the last polyline) can't be edited.
+    int addWall(const QVector<QPointF> &points);// Returns its number, -1 for no points
+    bool removeWall(int index);// False if there's no such wall
+    bool moveWall(int index, const QPointF &offset);
+    void setWalls(const QVector<QVector<QPointF> > &walls);// All of them at once(without the field edges), the unchanged ones cost nothing
+    bool hasEditedWalls() const { return wallsEdited; }
+    void commitWalls();
+
+    bool wallOnPath(const QPointF &a, const QPointF &b) const;// Returns true if the line from a to b crosses an obstacle
+    bool wallInSight(const QPointF &a, const QPointF &b) const;// Returns true if there's a real map wall on the line from a to b
+    qreal clearance(const QPointF &p) const { return distanceField.distance(p) - robotRadius; }// To the nearest obstacle, negative inside. Exact for any radius.
+    const DistanceField &obstacleField() const { return robotRadius > 0 ? inflatedField : distanceField; }// The obstacles' outlines, unsigned for a robot with radius
+    const PotentiallyVisibleSets &obstacleSets() const { return robotRadius > 0 ? inflatedSets : sightSets; }// Numbered like the obstacles' segments
+
+    // Each grid node owns a cellSize x cellSize square around it, a square is blocked if a map wall goes through it or the node is undiscovered.
+    QPoint nodeAt(const QPointF &p) const;// The node whose square contains p
+    bool isFreeNode(int i, int j) const;// False outside the grid too
+    bool gridLineOfSight(const QPointF &a, const QPointF &b) const;// Walks the squares under the segment. The squares containing a and b(and the side squares of their corners) are checked precisely against the walls, so the path may start and end close to them.
+
+    int width, height;
+    qreal pivotOffset; // A parameter for conflicts exclusion. Path should be binded not to polygonal chains' vertices, but to the nearby located point, soThis parameter sets there points' offset from the vertices.
+    qreal cellSize;// The discovered zones edges are being drawn as circles, so this parameter affects "smoothing". Also, it significantly affects the perfomance.
+    qreal minPocketArea;// Undiscovered components smaller than this(in square pixels) don't produce virtual walls, they are not worth the pivots.
+    qreal robotRadius;// 0 for a point robot, use setRobotRadius to change it
+
+    QVector<QVector<QPointF > > map;// Contains just the map and the screen edges added in the constructor. Only changed through addWall and the like.
+    QVector<QVector<QPointF> > initialMap;// The map the world was made for, without the edits and the field edges. The snapshots keep the walls relative to it.
+    DistanceField distanceField;// Of the map, built once in the constructor(or read from the PrecomputeCache)
+    PotentiallyVisibleSets sightSets;// Of the map, shared by all the worlds with the same map(see PotentiallyVisibleSets::shared)
+    QVector<QVector<QPointF> > obstacles;// The map grown by robotRadius, the same as the map for a point robot
+    DistanceField inflatedField;// Of the obstacles, only built for a robot with radius
+    PotentiallyVisibleSets inflatedSets;// The same
+    QVector<Pivot> mapPivots;// Of the obstacles, initialized at the startup and by setRobotRadius, for the better perfomance.
+    QVector<QVector<Pivot> > obstaclePivots;// mapPivots by obstacle, so commitWalls only recomputes the ones near the edits
+    QVector<QVector<bool> > isDiscovered;// The Visualisation field is a grid, so some points of this grid are already discovered, some not
+                                         // To convert grid nodes into real coordinates, you'll just multiply it by cellSize.
+    OccupancyGrid occupancy;// The same nodes, only filled by the engines mapping with the lidar(see MappingLidarSensor), which discover
+                            // the nodes it's sure about, so everything working on isDiscovered uses its thresholded view
+    DiscoveryTree discoveryTree;// The same as a quadtree, the grid algorithms work on its leaves to skip the uniform zones
+    FreeSpaceLabels freeSpace;// The components of the discovered zone split by the map walls, a target in another one can't be reached
+    QVector<QVector<QPointF> > virtualWalls;// These walls are formed by the edges of the undiscovered zone.
+                                            // They are "virtual" because they don't physically exist(unlike the walls formed by the "map" variable, their purpose is limitation for the path search algorithm
+    QVector<Pivot> virtualPivots;// The pivots of all virtualWalls, they only change with the walls
+    int revision;// Incremented by each updateVirtualWalls, so the planners know when their caches are outdated
+    QVector<QVector<bool> > wallSquares;// The squares an obstacle goes through or covers. Rasterized for each radius and after the edits.
+    int wallsRevision;// Incremented each time wallSquares are rasterized, the grid planners compare them then
+#ifdef DEBUG
+    mutable QVector<QVector<int> > dbgCompNumber;
+#endif
+
+private:
+    World(const World &);// discoveryTree reads isDiscovered by its address
+    World &operator=(const World &);
+
+    void updateMapPivots(const QVector<QVector<QPointF> > &before, const QRectF &changed);// Reuses the pivots of the obstacles away from changed
+    void markWallSquares();
+    // The structures for the map and robotRadius from the PrecomputeCache, the map's own ones(distanceField, sightSets) only withMap.
+    // False if they aren't there, then some of them may be overwritten.
+    bool restore(bool withMap);
+    void store() const;
+    QByteArray cacheKey() const;
+
+    bool wallsEdited;
+};
+
+#endif //WORLD_H
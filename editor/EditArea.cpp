@@ -27,6 +27,7 @@ void EditArea::mouseReleaseEvent(QMouseEvent *)
         QVector<QVector<QPointF> > newdata;
         QVector<QPointF> st;
         QPointF trash;
+        bool cut = false;
         for (int i = 0; i < map.size(); i++)
         {
             if (map[i].size() >= 1)
@@ -36,7 +37,7 @@ void EditArea::mouseReleaseEvent(QMouseEvent *)
                 QLineF tmpline(map[i][j], map[i][j + 1]);
                 if (line.intersect(tmpline, &trash) == QLineF::BoundedIntersection)
                 {
-                    emit mapChanged();
+                    cut = true;
                     if (st.size() >= 2)
                         newdata.push_back(st);
                     st.clear();
@@ -48,6 +49,8 @@ void EditArea::mouseReleaseEvent(QMouseEvent *)
             st.clear();
         }
         map = newdata;
+        if (cut)
+            emit mapChanged();// After the change, so the map can be read
     }
     mode = noMode;
     update();
@@ -107,8 +110,8 @@ void EditArea::setSnapRadius(int r)
 
 void EditArea::setMap(const QVector<QVector<QPointF> > &m)
 {
-    emit mapChanged();
     map = m;
+    emit mapChanged();
     update();
 }
 
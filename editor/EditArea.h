@@ -18,7 +18,7 @@ public slots:
     void setSnapRadius(int);
 
 signals:
-    void mapChanged();
+    void mapChanged();// The map is already changed then
 
 private:
     void paintEvent(QPaintEvent *);
@@ -1,21 +1,7 @@
 #include "MapEditor.h"
 #include "EditArea.h"
-
-namespace
-{
-
-QVector<QVector<QPointF> > getMapFromFile(const QString &fileName)// assuming the map exist
-{
-    QFile file(fileName);
-    file.open(QIODevice::ReadOnly);
-    QDataStream in(&file);
-    QVector<QVector<QPointF> > m;
-    in >> m;
-    file.close();
-    return m;
-}
-
-}
+#include "tools.h"
+#include "MapCompiler.h"
 
 MapEditor::MapEditor(int mapwidth, int mapheight, const QString &fileName, QWidget *parent):
     QWidget(parent),
@@ -25,7 +11,10 @@ MapEditor::MapEditor(int mapwidth, int mapheight, const QString &fileName, QWidg
     saveBtn(new QPushButton("Save...")),
     randomBtn(new QPushButton("Random")),
     editArea(new EditArea(this)),
-    snapRadiusSlider(new QSlider(Qt::Horizontal))
+    snapRadiusSlider(new QSlider(Qt::Horizontal)),
+    liveBox(new QCheckBox("Live: apply to the exploration")),
+    compileLabel(new QLabel()),
+    random(QDateTime::currentMSecsSinceEpoch())
 {
     connect(newBtn, SIGNAL(clicked()), this, SLOT(createNewMap()));
     connect(loadBtn, SIGNAL(clicked()), this, SLOT(loadFromFile()));
@@ -62,6 +51,11 @@ MapEditor::MapEditor(int mapwidth, int mapheight, const QString &fileName, QWidg
     QLabel *lbl = new QLabel("Snap precision:");
     snapLayout->addWidget(lbl);
     snapLayout->addWidget(snapRadiusSlider);
+    compileLabel->setWordWrap(true);
+    compileLabel->setMaximumWidth(200);
+    snapLayout->addWidget(compileLabel);
+    connect(liveBox, SIGNAL(toggled(bool)), this, SLOT(toggleLive(bool)));
+    snapLayout->addWidget(liveBox);
     snapLayout->addStretch(1);
 
     QGridLayout *mainLayout = new QGridLayout();
@@ -86,15 +80,15 @@ void MapEditor::generateRandom()
     for (int i = 0; i < 15; i++)
     {
         QVector<QPointF> l;
-        int w = qMax(qrand() % 400, 10);
-        int h = qMax(qrand() % 300, 10);
-        int px = qrand() % (editArea->width() - w);
-        int py = qrand() % (editArea->height() - h);
+        int w = qMax(random.bounded(400), 10);
+        int h = qMax(random.bounded(300), 10);
+        int px = random.bounded(editArea->width() - w);
+        int py = random.bounded(editArea->height() - h);
         for (int j = 0; j < 5; j++)
         {
-            l.append(QPointF(px + qrand() % w, py + qrand() % h));
+            l.append(QPointF(px + random.bounded(w), py + random.bounded(h)));
         }
-        if (qrand() % 5 == 0)
+        if (random.bounded(5) == 0)
             l.append(l.front());
         m.append(l);
     }
@@ -131,12 +125,18 @@ void MapEditor::saveToFile()
         return;
     else
     {
-        setWindowTitle(name + " - " + fileName);
         QFile file(fileName);
         file.open(QIODevice::WriteOnly);
+        // The cleaned up map is saved and shown, so the file has what the exploration is going to get
+        MapCompiler compiler;
+        QVector<QVector<QPointF> > compiled = compiler.compile(editArea->getMap());
+        compiler.countPivots(editArea->getMap(), compiled, editArea->width(), editArea->height());
+        compileLabel->setText(compiler.reportText());
         QDataStream out(&file);
-        out << editArea->getMap();
+        out << compiled;
         file.close();
+        editArea->setMap(compiled);// Marks the map unsaved, so the title goes after it
+        setWindowTitle(name + " - " + fileName);
         fileSaved = true;
     }
 }
@@ -145,6 +145,14 @@ void MapEditor::mapChanged()
 {
     setWindowTitle(name + "(unsaved)");
     fileSaved = false;
+    if (liveBox->isChecked())
+        emit mapEdited(editArea->getMap());
+}
+
+void MapEditor::toggleLive(bool live)
+{
+    if (live)// The exploration catches up with the edits made before
+        emit mapEdited(editArea->getMap());
 }
 
 void MapEditor::createNewMap()
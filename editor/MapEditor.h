@@ -3,6 +3,7 @@
 
 #include <QtGui>
 #include "EditArea.h"
+#include "Random.h"
 
 class MapEditor: public QWidget
 {
@@ -13,6 +14,7 @@ public:
 
 signals:
     void gonnaDie();
+    void mapEdited(const QVector<QVector<QPointF> > &);// Each change while "Live" is checked, for the running exploration
 
 private slots:
     void createNewMap();
@@ -20,6 +22,7 @@ private slots:
     void loadFromFile();
     void generateRandom();// The generated map looks lame, should be improved.
     void mapChanged(); // To add (unsaved) to the title.
+    void toggleLive(bool);
 
 private:
     void closeEvent(QCloseEvent *);
@@ -28,8 +31,11 @@ private:
     QPushButton *newBtn, *loadBtn, *saveBtn, *randomBtn;
     EditArea *editArea; //NOTE: might be easier to delete the old widget and create new.
     QSlider *snapRadiusSlider;
+    QCheckBox *liveBox;
+    QLabel *compileLabel;// The MapCompiler report of the last save
 
     bool fileSaved;
+    Random random;// Seeded with the time, so every "Random" press gives a new map
 };
 
 #endif
@@ -1,11 +1,61 @@
 #include <QtGui>
 #include "MapExploration.h"
+#include "Benchmark.h"
+#include "BatchRunner.h"
+#include "Visualisation.h"
+#include "MapCompiler.h"
+#include "PrecomputeCache.h"
+#include "SelfCheck.h"
+
+namespace
+{
+
+// The modes without a window, they run under a QCoreApplication and need no display
+bool isHeadless(const QString &mode)
+{
+    return mode.startsWith("--bench-") || mode == "--self-check" || mode == "--batch" || mode == "--compile-map" || mode == "--capture";
+}
+
+int runHeadless(const QStringList &args)
+{
+    if (args[1] == "--bench-planners")
+        return runPlannerBenchmark(args.mid(2));
+    if (args[1] == "--bench-geometry")
+        return runGeometryBenchmark();
+    if (args[1] == "--bench-alloc")
+        return runAllocationBenchmark(args.mid(2));
+    if (args[1] == "--bench-engines")
+        return runEngineBenchmark(args.mid(2));
+    if (args[1] == "--self-check")
+        return runSelfCheck(args.mid(2));
+    PrecomputeCache::setDirectory(PrecomputeCache::defaultDirectory());// Not for the benchmarks above, they measure the builds too
+    if (args[1] == "--batch")
+        return runBatch(args.mid(2));
+    if (args[1] == "--compile-map")
+        return runMapCompiler(args.mid(2));
+    if (args[1] == "--capture")
+        return runCapture(args.mid(2));
+    QTextStream(stdout) << "Unknown mode " << args[1] << endl;
+    return 1;
+}
+
+}
 
 int main(int argc, char* argv[])
 {
+    if (argc > 1 && isHeadless(QString::fromLocal8Bit(argv[1])))
+    {
+        QCoreApplication app(argc, argv);
+        return runHeadless(app.arguments());
+    }
+
     QApplication app(argc, argv);
-   
+    PrecomputeCache::setDirectory(PrecomputeCache::defaultDirectory());
+
+    QStringList args = app.arguments();
     MapExploration *p = new MapExploration(900, 600);
+    if (args.size() > 2 && args[1] == "--wall-pipe" && !p->listenForWallEdits(args[2]))
+        QTextStream(stdout) << "Can't listen for the wall edits on " << args[2] << endl;
     p->show();
 
     return app.exec();
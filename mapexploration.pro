@@ -3,6 +3,7 @@
 ######################################################################
 
 CONFIG += qt debug_and_release
+QT += network
 
 TEMPLATE = app
 
@@ -15,17 +16,76 @@ CONFIG(debug, debug|release) {
      TARGET = mapexploration
  }
 
+QMAKE_CXXFLAGS += -std=c++11
 QMAKE_CXXFLAGS_DEBUG += -g -DDEBUG
+# -O2 alone vectorizes only the loops that need no runtime checks(and older gcc none), the batched ones like RangeSensor::scan do
+QMAKE_CXXFLAGS_RELEASE += -ftree-vectorize -fvect-cost-model=dynamic
+# "qmake CONFIG+=count_heap" wraps malloc to count the heap allocations for --bench-alloc(see Arena.h), not for the normal build
+count_heap: DEFINES += COUNT_HEAP_ALLOCATIONS
 
 # Input
 HEADERS += Visualisation.h editor/MapEditor.h \
     tools.h \
+    Geometry.h \
     editor/EditArea.h \
-    MapExploration.h
+    MapExploration.h \
+    World.h \
+    ExplorationEngine.h \
+    TraceFormat.h \
+    SnapshotFormat.h \
+    TraceRecorder.h \
+    TraceReplay.h \
+    Planner.h \
+    VisibilityGraphPlanner.h \
+    ThetaStarPlanner.h \
+    HierarchicalPlanner.h \
+    VoronoiPlanner.h \
+    SquareWalker.h \
+    DistanceField.h \
+    DiscoveryTree.h \
+    Benchmark.h \
+    SelfCheck.h \
+    Random.h \
+    Arena.h \
+    BatchRunner.h \
+    FrameCapture.h \
+    MapCompiler.h \
+    EnginePolicies.h \
+    FreeSpaceLabels.h \
+    ConfigurationSpace.h \
+    PotentiallyVisibleSets.h \
+    WallEditServer.h \
+    PrecomputeCache.h \
+    RangeSensor.h \
+    OccupancyGrid.h
 SOURCES += main.cpp Visualisation.cpp editor/MapEditor.cpp \
     tools.cpp \
     editor/EditArea.cpp \
-    MapExploration.cpp
+    MapExploration.cpp \
+    World.cpp \
+    ExplorationEngine.cpp \
+    TraceRecorder.cpp \
+    TraceReplay.cpp \
+    VisibilityGraphPlanner.cpp \
+    ThetaStarPlanner.cpp \
+    HierarchicalPlanner.cpp \
+    VoronoiPlanner.cpp \
+    DistanceField.cpp \
+    DiscoveryTree.cpp \
+    Benchmark.cpp \
+    SelfCheck.cpp \
+    Arena.cpp \
+    BatchRunner.cpp \
+    FrameCapture.cpp \
+    MapCompiler.cpp \
+    EnginePolicies.cpp \
+    FreeSpaceLabels.cpp \
+    ConfigurationSpace.cpp \
+    PotentiallyVisibleSets.cpp \
+    WallEditServer.cpp \
+    PrecomputeCache.cpp \
+    RangeSensor.cpp \
+    OccupancyGrid.cpp
 
 OTHER_FILES += \
     README \
@@ -2,30 +2,88 @@
 
 #include <QPair>
 #include <QHash>
+#include <QFile>
+#include <QDataStream>
 #include <QtCore/qmath.h>
 
+#include "TraceFormat.h"
+
 uint qHash(const QPointF &p)
 {
     return qHash(QPair<qint64, qint64>(p.x(), p.y()));
 }
 
+uint qHash(const Segment &s)
+{
+    return qHash(s.a.toPointF()) ^ (qHash(s.b.toPointF()) * 31);
+}
+
 qreal distance(const QPointF &a, const QPointF &b)
 {
     QPointF c = b - a;
     return qSqrt(c.x() * c.x() + c.y() * c.y());
 }
 
-qreal PI()
+QVector<QVector<QPointF> > getMapFromFile(const QString &fileName)
+{
+    QFile file(fileName);
+    file.open(QIODevice::ReadOnly);
+    QDataStream in(&file);
+    QVector<QVector<QPointF> > m;
+    in >> m;
+    file.close();
+    return m;
+}
+
+quint64 mapHash(const QVector<QVector<QPointF> > &map)
 {
-    return 4 * qAtan(1);
+    quint64 hash = Q_UINT64_C(14695981039346656037);
+    QByteArray bytes;
+    for (int i = 0; i < map.size(); i++)
+    {
+        TraceFormat::writeVarint(&bytes, map[i].size());
+        for (int j = 0; j < map[i].size(); j++)
+        {
+            TraceFormat::writeReal(&bytes, map[i][j].x());
+            TraceFormat::writeReal(&bytes, map[i][j].y());
+        }
+    }
+    for (int i = 0; i < bytes.size(); i++)
+    {
+        hash ^= quint8(bytes[i]);
+        hash *= Q_UINT64_C(1099511628211);
+    }
+    return hash;
 }
 
-qreal rad2degr(qreal rad)
+QVector<Segment> segmentsOf(const QVector<QVector<QPointF> > &walls)
 {
-    return rad / PI() * 180;
+    QVector<Segment> segments;
+    for (int i = 0; i < walls.size(); i++)
+    {
+        for (int j = 0; j < walls[i].size() - 1; j++)
+            segments.append(Segment(walls[i][j], walls[i][j + 1]));
+    }
+    return segments;
 }
 
-qreal degr2rad(qreal degr)
+QVector<int> matchSegments(const QVector<Segment> &before, const QVector<Segment> &after)
 {
-    return degr / 180 * PI();
+    QHash<Segment, int> first;// The first unmatched segment of after equal to the key, the others follow it in next
+    QVector<int> next(after.size(), -1);
+    for (int k = after.size() - 1; k >= 0; k--)
+    {
+        next[k] = first.value(after[k], -1);
+        first[after[k]] = k;
+    }
+    QVector<int> match(before.size(), -1);
+    for (int k = 0; k < before.size(); k++)
+    {
+        int found = first.value(before[k], -1);
+        if (found < 0)
+            continue;
+        match[k] = found;
+        first[before[k]] = next[found];
+    }
+    return match;
 }
@@ -3,14 +3,24 @@
 
 #include <QtGlobal>
 #include <QPointF>
+#include <QVector>
+#include <QString>
+
+#include "Geometry.h"
 
 uint qHash(const QPointF &p);
+uint qHash(const Segment &s);
 
 qreal distance(const QPointF &a, const QPointF &b);
 
-qreal PI();
+QVector<QVector<QPointF> > getMapFromFile(const QString &fileName);// assuming the map exist
+quint64 mapHash(const QVector<QVector<QPointF> > &map);// FNV-1a of the coordinates, to tell the maps apart
+
+QVector<Segment> segmentsOf(const QVector<QVector<QPointF> > &walls);// Polyline by polyline, the way the walls' segments are numbered everywhere
+// For each segment of before, its number in after, -1 if it isn't there any more. Equal segments are matched in order.
+QVector<int> matchSegments(const QVector<Segment> &before, const QVector<Segment> &after);
 
-qreal rad2degr(qreal);
-qreal degr2rad(qreal);
+constexpr qreal rad2degr(qreal rad) { return rad / PI() * 180; }
+constexpr qreal degr2rad(qreal degr) { return degr / 180 * PI(); }
 
 #endif // TOOLS_H